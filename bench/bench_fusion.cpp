@@ -0,0 +1,127 @@
+// bench_fusion.cpp - fused vs unfused row-local operations
+//
+//   ./bench_fusion [rows]   (default 1000000)
+//
+// The unfused runs call the standalone ops, once on plain columns and once
+// on the dictionary-encoded columns every loaded sheet has (where
+// run_operations does not fuse).
+#include <iostream>
+#include <chrono>
+#include "operations.hpp"
+
+static NitroSheet make_bench_sheet(size_t rows)
+{
+    static const char *codes[]  = { "BN", "GH", "VG", "TS" };
+    static const char *sizes[]  = { "xs", "s", "m", "l", "xl" };
+    static const char *colors[] = { "purple", "red", "blue", "brown", "white" };
+
+    NitroSheet s;
+    s.cols.resize(4);
+    s.cols[0].header = "No";
+    s.cols[1].header = "Product-Size-Color";
+    std::vector<std::string> &no = s.cols[0].vals_mut();
+    std::vector<std::string> &psc = s.cols[1].vals_mut();
+    no.resize(rows);
+    psc.resize(rows);
+
+    for (size_t r = 0; r < rows; ++r)
+    {
+        no[r] = std::to_string(r + 1);
+        psc[r] = std::string(codes[r % 4]) + "-" + sizes[r % 5] + "-" + colors[(r / 7) % 5];
+    }
+    s.num_rows = static_cast<uint32_t>(rows);
+    return s;
+}
+
+static std::vector<RowStage> bench_stages()
+{
+    RowStage split;
+    split.kind = RowStage::Kind::Split;
+    split.col_index = 1;
+    split.delimiter = '-';
+    split.target_col_indices = { 4, 5, 6 };
+    split.new_headers = { "Code", "Size", "Color" };
+
+    RowStage upper;
+    upper.kind = RowStage::Kind::Uppercase;
+    upper.col_index = 6;
+
+    RowStage replace;
+    replace.kind = RowStage::Kind::Replace;
+    replace.col_index = 6;
+    replace.find = "R";
+    replace.repl = "r";
+
+    return { split, upper, replace };
+}
+
+template <typename F>
+static double time_ms(F f)
+{
+    auto start = std::chrono::high_resolution_clock::now();
+    f();
+    auto end = std::chrono::high_resolution_clock::now();
+    return std::chrono::duration<double, std::milli>(end - start).count();
+}
+
+// the standalone op each stage stands for
+static void run_standalone(NitroSheet &sheet, const std::vector<RowStage> &stages)
+{
+    for (const RowStage &st : stages)
+    {
+        switch (st.kind)
+        {
+        case RowStage::Kind::Split:
+            split_column_nitro(sheet, 1, st.first_data_row, st.col_index, st.delimiter, st.target_col_indices, st.new_headers, st.proper_positions);
+            break;
+        case RowStage::Kind::Uppercase:
+            uppercase_column_nitro(sheet, st.first_data_row, st.col_index);
+            break;
+        case RowStage::Kind::Replace:
+            replace_in_column_nitro(sheet, st.first_data_row, st.col_index, st.find, st.repl);
+            break;
+        }
+    }
+}
+
+// cells past the end of a short column count as blank
+static bool same_cells(const NitroSheet &a, const NitroSheet &b)
+{
+    static const std::string blank;
+    bool same = a.cols.size() == b.cols.size();
+    for (size_t c = 0; same && c < a.cols.size(); ++c)
+    {
+        const Column &x = a.cols[c], &y = b.cols[c];
+        same = x.header == y.header;
+        for (size_t r = 0; same && r < a.num_rows; ++r)
+            same = (r < x.size() ? x.at(r) : blank) == (r < y.size() ? y.at(r) : blank);
+    }
+    return same;
+}
+
+int main(int argc, char **argv)
+{
+    size_t rows = argc > 1 ? std::stoul(argv[1]) : 1000000;
+    auto stages = bench_stages();
+
+    NitroSheet plain = make_bench_sheet(rows);
+    NitroSheet encoded = make_bench_sheet(rows);
+    dict_encode_columns(encoded);
+    NitroSheet fused = make_bench_sheet(rows);
+
+    double plain_ms = time_ms([&] { run_standalone(plain, stages); });
+    double encoded_ms = time_ms([&] { run_standalone(encoded, stages); });
+    double fused_ms = time_ms([&] { run_row_stages_nitro(fused, stages); });
+
+    const bool same = same_cells(fused, plain) && same_cells(fused, encoded);
+
+    std::cout << "rows:                  " << rows << "\n";
+    std::cout << "standalone (plain):    " << plain_ms << " ms\n";
+    std::cout << "standalone (dict):     " << encoded_ms << " ms\n";
+    std::cout << "fused (plain):         " << fused_ms << " ms\n";
+    std::cout << "speedup over plain:    " << plain_ms / fused_ms << "x\n";
+    std::cout << "dict over fused:       " << fused_ms / encoded_ms << "x\n";
+    std::cout << "results " << (same ? "match" : "DIFFER") << "\n";
+
+    return same ? 0 : 1;
+}
@@ -0,0 +1,89 @@
+// bench_lookup.cpp - lookup-column hash join
+//
+//   ./bench_lookup [rows] [ref_rows]   (default 1000000 x 100000)
+#include <iostream>
+#include <chrono>
+#include "operations.hpp"
+
+static NitroSheet make_main_sheet(size_t rows, size_t ref_rows)
+{
+    NitroSheet s;
+    s.cols.resize(2);
+    s.cols[0].header = "No";
+    s.cols[1].header = "Product";
+    std::vector<std::string> &no = s.cols[0].vals_mut();
+    std::vector<std::string> &product = s.cols[1].vals_mut();
+    no.resize(rows);
+    product.resize(rows);
+
+    for (size_t r = 0; r < rows; ++r)
+    {
+        no[r] = std::to_string(r + 1);
+        product[r] = "P" + std::to_string((r * 7919) % (ref_rows + ref_rows / 10)); // ~10% misses
+    }
+    s.num_rows = static_cast<uint32_t>(rows);
+    return s;
+}
+
+static NitroSheet make_ref_sheet(size_t ref_rows)
+{
+    static const char *groups[] = { "Bags", "Shirts", "Jewelry", "Kits" };
+
+    NitroSheet s;
+    s.cols.resize(3);
+    s.cols[0].header = "Product";
+    s.cols[1].header = "Category";
+    s.cols[2].header = "Group";
+    std::vector<std::string> &key = s.cols[0].vals_mut();
+    std::vector<std::string> &category = s.cols[1].vals_mut();
+    std::vector<std::string> &group = s.cols[2].vals_mut();
+    key.resize(ref_rows);
+    category.resize(ref_rows);
+    group.resize(ref_rows);
+
+    for (size_t r = 0; r < ref_rows; ++r)
+    {
+        key[r] = "P" + std::to_string(r);
+        category[r] = "Category " + std::to_string(r);
+        group[r] = groups[r % 4];
+    }
+    s.num_rows = static_cast<uint32_t>(ref_rows);
+    s.cols[2].dict_encode();
+    return s;
+}
+
+int main(int argc, char **argv)
+{
+    size_t rows = argc > 1 ? std::stoul(argv[1]) : 1000000;
+    size_t ref_rows = argc > 2 ? std::stoul(argv[2]) : 100000;
+
+    NitroSheet sheet = make_main_sheet(rows, ref_rows);
+    NitroSheet ref = make_ref_sheet(ref_rows);
+
+    auto start = std::chrono::high_resolution_clock::now();
+    lookup_column_nitro(sheet, ref, 1, 0, { 1, 2 }, { 2, 3 }, {}, OnDuplicate::First, "n/a");
+    auto end = std::chrono::high_resolution_clock::now();
+    double ms = std::chrono::duration<double, std::milli>(end - start).count();
+
+    size_t misses = 0;
+    bool ok = true;
+    for (size_t r = 0; r < rows; ++r)
+    {
+        const std::string &key = sheet.cols[1].at(r);
+        const size_t k = std::stoul(key.substr(1));
+        if (k >= ref_rows)
+        {
+            misses++;
+            ok = ok && sheet.cols[2].at(r) == "n/a" && sheet.cols[3].at(r) == "n/a";
+        }
+        else
+            ok = ok && sheet.cols[2].at(r) == ref.cols[1].at(k) && sheet.cols[3].at(r) == ref.cols[2].at(k);
+    }
+
+    std::cout << "rows:     " << rows << " x " << ref_rows << " reference rows\n";
+    std::cout << "lookup:   " << ms << " ms\n";
+    std::cout << "misses:   " << misses << "\n";
+    std::cout << "results " << (ok ? "match" : "DIFFER") << "\n";
+
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,14 @@
+#pragma once
+
+// ANSI color macros
+#define RESET   "\033[0m"
+#define BOLD    "\033[1m"
+
+#define RED     "\033[31m"
+#define GREEN   "\033[32m"
+#define YELLOW  "\033[33m"
+#define BLUE    "\033[34m"
+#define PURPLE  "\033[35m"
+#define CYAN    "\033[36m"
+#define WHITE   "\033[37m"
+#define MAGENTA "\033[95m"
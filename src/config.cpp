@@ -1,10 +1,19 @@
 #include "config.hpp"
+#include <stdexcept>
+#include "utils/utils.hpp"
 
 Config load_script(const std::string &path)
 {
-    YAML::Node root = YAML::LoadFile(path);
+    YAML::Node root;
+    try { root = YAML::LoadFile(path); }
+    catch (const YAML::Exception &e) { throw std::runtime_error("Invalid script " + path + ": " + e.what()); }
+
+    for (const char *key : { "input", "output" })
+        if (!root[key]) throw std::runtime_error("Invalid script " + path + ": missing `" + std::string(key) + "`");
+
     Config cfg;
 
+    cfg.script_file = path;
     cfg.input_file = root["input"].as<std::string>();
     cfg.output_file = root["output"].as<std::string>();
     cfg.export_csv = root["export-csv"].as<bool>(false);
@@ -12,13 +21,34 @@ Config load_script(const std::string &path)
     cfg.header_row = root["header-row"].as<std::uint32_t>(1);
     cfg.first_data_row = root["first-data-row"].as<std::uint32_t>(2);
 
+    if (root["seed"])
+        cfg.seed = root["seed"].as<std::uint64_t>();
+    if (root["now"])
+    {
+        const std::string now = root["now"].as<std::string>();
+        int64_t epoch = 0;
+        if (!parse_datetime_epoch(now, epoch))
+            throw std::runtime_error("Invalid now: " + now + " (expected an ISO date/time)");
+        cfg.now = epoch;
+    }
+
+    // compile every operation, collecting all errors so one run reports them together
+    std::string errors;
+    std::size_t n = 0;
     for (const auto &op : root["operations"])
     {
-        Operation o;
-        o.type = op["type"].as<std::string>();
-        o.node = YAML::Clone(op);
-        cfg.operations.push_back(o);
+        ++n;
+        try
+        {
+            cfg.operations.push_back(compile_operation(op));
+        }
+        catch (const std::exception &e)
+        {
+            errors += "\n  operation " + std::to_string(n) + ": " + e.what();
+        }
     }
+    if (!errors.empty())
+        throw std::runtime_error("Invalid script " + path + ":" + errors);
 
     return cfg;
 }
\ No newline at end of file
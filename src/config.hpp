@@ -1,23 +1,23 @@
 #pragma once
+#include <cstdint>
+#include <optional>
 #include <string>
 #include <vector>
-#include <yaml-cpp/yaml.h>
-
-struct Operation
-{
-    std::string type;
-    YAML::Node node;
-};
+#include "plan.hpp"
 
 struct Config
 {
+    std::string script_file; // the script this was loaded from ("" if built in code)
     std::string input_file;
     std::string output_file;
     bool export_csv = false;
     bool export_xlsx = false;
     std::uint32_t header_row = 1;
     std::uint32_t first_data_row = 2;
-    std::vector<Operation> operations;
+    std::optional<std::uint64_t> seed; // random timestamp seed (reproducible runs)
+    std::optional<std::int64_t> now;   // fixed "now" for random timestamps, epoch seconds
+    std::vector<OperationPtr> operations; // compiled and validated, see plan.hpp
 };
 
-Config load_script(const std::string &path);
\ No newline at end of file
+// parse and compile a script; throws std::runtime_error listing every invalid operation
+Config load_script(const std::string &path);
@@ -1,31 +1,22 @@
 #pragma once
 #include <string>
+#include <string_view>
 #include <fstream>
 #include <stdexcept>
 #include <vector>
+#include "thread_pool.hpp"
 
-// RFC-4180 CSV escape
-inline std::string csv_escape(const std::string &s)
+// RFC-4180 CSV escape, appended to out
+inline void append_csv_escaped(std::string &out, std::string_view s)
 {
-    bool needs_quotes = false;
-
-    for (char c : s)
+    if (s.find_first_of("\",\n\r") == std::string_view::npos)
     {
-        if (c == '"' || c == ',' || c == '\n' || c == '\r')
-        {
-            needs_quotes = true;
-            break;
-        }
+        out += s;
+        return;
     }
 
-    if (!needs_quotes)
-        return s;
-
     // Escape double quotes
-    std::string out;
-    out.reserve(s.size() + 8);
     out.push_back('"');
-
     for (char c : s)
     {
         if (c == '"')
@@ -33,21 +24,26 @@ inline std::string csv_escape(const std::string &s)
         else
             out.push_back(c);
     }
-
     out.push_back('"');
+}
+
+inline std::string csv_escape(const std::string &s)
+{
+    std::string out;
+    append_csv_escaped(out, s);
     return out;
 }
 
 inline void save_csv_nitro(
     const NitroSheet &sheet,
     const std::string &path,
-    size_t flush_threshold = 1 << 20
+    size_t /*flush_threshold*/ = 1 << 20 // kept for API compatibility; rows are written per rendered block
 )
 {
     if (sheet.cols.empty())
         throw std::runtime_error("CSV export failed: sheet has no columns.");
 
-    const size_t rows = sheet.num_rows;
+    const size_t rows = sheet.num_rows; // physical rows
     const size_t cols = sheet.cols.size();
 
     // Validate column structures
@@ -58,7 +54,7 @@ inline void save_csv_nitro(
                                      std::to_string(c) +
                                      " has an empty header.");
 
-        if (sheet.cols[c].vals.size() < rows)
+        if (sheet.cols[c].size() < rows)
             throw std::runtime_error("CSV export: column " +
                                      std::to_string(c) +
                                      " vals smaller than sheet.num_rows.");
@@ -79,6 +75,15 @@ inline void save_csv_nitro(
         if (force) out.flush();
     };
 
+    // dictionary columns: escape each distinct value once
+    std::vector<std::vector<std::string>> dict_csv(cols);
+    for (size_t c = 0; c < cols; ++c)
+    {
+        if (!sheet.cols[c].is_dict()) continue;
+        for (const auto &entry : sheet.cols[c].dict())
+            dict_csv[c].push_back(csv_escape(to_clean_number(entry)));
+    }
+
     // --------------------------
     // Write header row
     // --------------------------
@@ -93,25 +98,54 @@ inline void save_csv_nitro(
     // --------------------------
     // Write data rows
     // --------------------------
-    for (size_t r = 0; r < rows; ++r)
-    {
-        bool empty = true;
-        for (size_t c = 0; c < cols; ++c)
-            if (!sheet.cols[c].vals[r].empty())
-                empty = false;
-
-        if (empty) continue;
+    const std::vector<uint64_t> nonempty = sheet.nonempty_row_mask();
 
-        for (size_t c = 0; c < cols; ++c)
+    // lines of logical rows [begin, end)
+    auto render = [&](size_t begin, size_t end, std::string &part)
+    {
+        std::string rendered; // list/timestamp cells are rendered here on demand
+        for (size_t i = begin; i < end; ++i)
         {
-            std::string cleaned = to_clean_number(sheet.cols[c].vals[r]);
-            buf += csv_escape(cleaned);
-            if (c + 1 < cols) buf += ",";
+            const size_t r = sheet.row_at(i);
+
+            if (!((nonempty[r >> 6] >> (r & 63)) & 1)) continue; // fully empty row
+
+            for (size_t c = 0; c < cols; ++c)
+            {
+                const Column &col = sheet.cols[c];
+                if (col.is_dict())
+                    part += dict_csv[c][col.codes()[r]];
+                else if (col.is_list() || col.is_timestamp())
+                {
+                    rendered.clear();
+                    col.append_cell_text(r, rendered);
+                    append_csv_escaped(part, rendered);
+                }
+                else
+                    append_csv_escaped(part, clean_number_view(col.at(r)));
+                if (c + 1 < cols) part += ",";
+            }
+            part += "\n";
         }
-        buf += "\n";
+    };
 
-        if (buf.size() >= flush_threshold)
-            flush_buf();
+    // Rows are rendered in blocks on the thread pool and written in logical (selection) order
+    const size_t logical = sheet.row_count();
+    const size_t block = 1 << 14;
+    std::vector<std::string> parts(global_pool().threads() * 4);
+    for (size_t base = 0; base < logical; base += block * parts.size())
+    {
+        const size_t n = std::min(parts.size(), (logical - base + block - 1) / block);
+        parallel_for_chunks(n, [&](size_t begin, size_t end) {
+            for (size_t k = begin; k < end; ++k)
+            {
+                parts[k].clear();
+                render(base + k * block, std::min(logical, base + (k + 1) * block), parts[k]);
+            }
+        }, 1);
+
+        for (size_t k = 0; k < n; ++k)
+            out.write(parts[k].data(), (std::streamsize)parts[k].size());
     }
 
     flush_buf(true);
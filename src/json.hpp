@@ -1,12 +1,15 @@
 #pragma once
 #include <string>
+#include <string_view>
 #include <vector>
 #include <fstream>
 #include <algorithm>
 #include <cctype>
 #include <stdexcept>
+#include "utils/utils.hpp"
+#include "thread_pool.hpp"
 
-// Assumes Column { std::string header; std::vector<std::string> vals; bool dirty; }
+// Assumes Column { std::string header; size(); at(r); is_dict(); codes(); dict(); }
 // and NitroSheet { std::vector<Column> cols; uint32_t first_row; uint32_t data_row_start; uint32_t num_rows; }
 
 // trim helper
@@ -17,60 +20,55 @@ inline std::string trim_copy(const std::string &s) {
     return s.substr(b, e - b);
 }
 
-// json escape helper (same as before)
+// json escape helper
 inline std::string json_escape(const std::string &s)
 {
     std::string out;
     out.reserve(s.size() + 16);
-    for (unsigned char c : s)
-    {
-        switch (c)
-        {
-        case '\"': out += "\\\""; break;
-        case '\\': out += "\\\\"; break;
-        case '\b': out += "\\b"; break;
-        case '\f': out += "\\f"; break;
-        case '\n': out += "\\n"; break;
-        case '\r': out += "\\r"; break;
-        case '\t': out += "\\t"; break;
-        default:
-            if (c < 0x20)
-            {
-                char buf[7];
-                std::snprintf(buf, sizeof(buf), "\\u%04x", c);
-                out += buf;
-            }
-            else out += (char)c;
-        }
-    }
+    append_json_escaped(out, s);
     return out;
 }
 
-inline bool looks_like_obj(const std::string &trimmed)
+inline std::string_view trim_view(std::string_view s)
+{
+    size_t b = 0, e = s.size();
+    while (b < e && std::isspace((unsigned char)s[b])) ++b;
+    while (e > b && std::isspace((unsigned char)s[e-1])) --e;
+    return s.substr(b, e - b);
+}
+
+inline bool looks_like_obj(std::string_view trimmed)
 {
     if (trimmed.size() < 2) return false;
     return (trimmed.front() == '{' || trimmed.back() == '}');
 }
 
-inline bool looks_like_array(const std::string &trimmed)
+inline bool looks_like_array(std::string_view trimmed)
 {
     if (trimmed.size() < 2) return false;
     return (trimmed.front() == '[' && trimmed.back() == ']');
 }
 
-inline bool is_valid_number(const std::string& trimmed)
+// append one cell as a JSON value: objects/arrays raw, numbers/bools/null bare, strings quoted
+inline void append_json_value(std::string &buf, const std::string &raw)
 {
-    if (trimmed.size() < 1) return false;
+    const std::string_view trimmed = trim_view(raw);
 
-    // Fast check: reject trailing dot
-    if (trimmed.back() == '.') 
-        return false;
-
-    char* end = nullptr;
-    std::strtod(trimmed.c_str(), &end);
-
-    // true only if full string parsed as number
-    return end == trimmed.c_str() + trimmed.size();
+    if (looks_like_obj(trimmed) || looks_like_array(trimmed))
+    {
+        buf += trimmed;
+    }
+    else if (trimmed == "null" || trimmed == "true" || trimmed == "false" || is_json_number(trimmed))
+    {
+        // raw number, bool, or null
+        buf += clean_number_view(trimmed);
+    }
+    else
+    {
+        buf += '"';
+        append_json_escaped(buf, raw);
+        buf += '"';
+    }
 }
 
 
@@ -81,7 +79,7 @@ inline void save_json_nitro(
     uint32_t first_data_row,    // kept for API compatibility
     const std::string &path,
     bool pretty = true,
-    size_t flush_threshold = 1 << 20
+    size_t /*flush_threshold*/ = 1 << 20 // kept for API compatibility; rows are written per rendered block
 )
 {
     // print_nitro_sheet(sheet); // uncomment this for debugging
@@ -91,7 +89,7 @@ inline void save_json_nitro(
         throw std::runtime_error("Cannot export JSON: sheet has no columns.");
 
     const size_t data_rows = sheet.num_rows; // number of data rows in each column (vals.size())
-    if (data_rows == 0)
+    if (sheet.row_count() == 0)
         throw std::runtime_error("Sheet has 0 data rows.");
 
     const size_t cols = sheet.cols.size();
@@ -111,9 +109,9 @@ inline void save_json_nitro(
         // const_cast because function receives const NitroSheet; if you want to mutate, accept non-const.
         // Better: require non-const NitroSheet or ensure loader already resized. Here we'll require non-const from caller.
         // To keep signature const, we will check only — but to avoid segfaults the loader MUST ensure sizing.
-        if (sheet.cols[c].vals.size() < data_rows)
+        if (sheet.cols[c].size() < data_rows)
             throw std::runtime_error("Column " + std::to_string(c) + " vals size (" +
-                                     std::to_string(sheet.cols[c].vals.size()) +
+                                     std::to_string(sheet.cols[c].size()) +
                                      ") is smaller than sheet.num_rows (" + std::to_string(data_rows) + ").");
     }
 
@@ -132,60 +130,96 @@ inline void save_json_nitro(
         if (force) out.flush();
     };
 
+    // dictionary columns: render each distinct value once
+    std::vector<std::vector<std::string>> dict_json(cols);
+    for (size_t c = 0; c < cols; ++c)
+    {
+        if (!sheet.cols[c].is_dict()) continue;
+        for (const auto &entry : sheet.cols[c].dict())
+        {
+            dict_json[c].emplace_back();
+            append_json_value(dict_json[c].back(), entry);
+        }
+    }
+
     const std::string nl      = pretty ? "\n" : "";
     const std::string ind1    = pretty ? "  " : "";
     const std::string ind2    = pretty ? "    " : "";
 
-    buf += "[" + nl;
-    bool first_obj = true;
+    const std::vector<uint64_t> nonempty = sheet.nonempty_row_mask();
+
+    // "    \"header\": " of every column, built once
+    std::vector<std::string> keys(cols);
+    for (size_t c = 0; c < cols; ++c)
+        keys[c] = ind2 + "\"" + json_escape(sheet.cols[c].header) + "\": ";
+
+    const std::string sep = "," + nl;
 
-    // Iterate data rows: Nitro stores only data rows in vals[0..data_rows-1]
-    for (size_t r = 0; r < data_rows; ++r)
+    // objects of logical rows [begin, end), each preceded by sep
+    auto render = [&](size_t begin, size_t end, std::string &part)
     {
-        // skip fully empty row
-        bool empty = true;
-        for (size_t c = 0; c < cols; ++c)
+        for (size_t i = begin; i < end; ++i)
         {
-            if (!sheet.cols[c].vals[r].empty()) { empty = false; break; }
-        }
-        if (empty) continue;
+            const size_t r = sheet.row_at(i);
 
-        if (!first_obj) buf += "," + nl;
-        first_obj = false;
+            // skip fully empty row
+            if (!((nonempty[r >> 6] >> (r & 63)) & 1)) continue;
 
-        buf += ind1 + "{" + nl;
+            part += sep;
+            part += ind1;
+            part += '{';
+            part += nl;
 
-        for (size_t c = 0; c < cols; ++c)
-        {
-            const std::string &key = sheet.cols[c].header;
-            const std::string &raw = sheet.cols[c].vals[r];
-            std::string trimmed = trim_copy(raw);
+            for (size_t c = 0; c < cols; ++c)
+            {
+                const Column &col = sheet.cols[c];
 
-            buf += ind2 + "\"" + json_escape(key) + "\": ";
+                part += keys[c];
 
-            if (!trimmed.empty() && (looks_like_obj(trimmed) || looks_like_array(trimmed)))
-            {
-                buf += trimmed;
-            }
-            else if (!trimmed.empty() && (trimmed == "null" || trimmed == "true" || trimmed == "false"
-                     || is_valid_number(trimmed)))
-            {
-                // raw number, bool, or null
-                buf += to_clean_number(trimmed);
+                if (col.is_dict())
+                    part += dict_json[c][col.codes()[r]];
+                else if (col.is_list())
+                    col.append_list_json(r, part);
+                else if (col.is_timestamp())
+                    append_firestore_timestamp(part, col.timestamps()[r]);
+                else
+                    append_json_value(part, col.at(r));
+
+                if (c + 1 < cols) part += ',';
+                part += nl;
             }
-            else
+
+            part += ind1;
+            part += '}';
+        }
+    };
+
+    buf += "[" + nl;
+    flush_buf();
+    bool first_obj = true;
+
+    // Rows are rendered in blocks on the thread pool and written in logical (selection) order
+    const size_t rows = sheet.row_count();
+    const size_t block = 1 << 14;
+    std::vector<std::string> parts(global_pool().threads() * 4);
+    for (size_t base = 0; base < rows; base += block * parts.size())
+    {
+        const size_t n = std::min(parts.size(), (rows - base + block - 1) / block);
+        parallel_for_chunks(n, [&](size_t begin, size_t end) {
+            for (size_t k = begin; k < end; ++k)
             {
-                buf += "\"" + json_escape(raw) + "\"";
+                parts[k].clear();
+                render(base + k * block, std::min(rows, base + (k + 1) * block), parts[k]);
             }
+        }, 1);
 
-            if (c + 1 < cols) buf += ",";
-            buf += nl;
-
-            if (buf.size() >= flush_threshold) flush_buf();
+        for (size_t k = 0; k < n; ++k)
+        {
+            if (parts[k].empty()) continue;
+            const size_t skip = first_obj ? sep.size() : 0; // no separator before the first object
+            first_obj = false;
+            out.write(parts[k].data() + skip, static_cast<std::streamsize>(parts[k].size() - skip));
         }
-
-        buf += ind1 + "}";
-        if (buf.size() >= flush_threshold) flush_buf();
     }
 
     buf += nl + "]" + nl;
@@ -1,363 +1,308 @@
 #include <iostream>
 #include <chrono>
-#include <OpenXLSX.hpp>
+#include <filesystem>
+#include <optional>
+#include <thread>
 #include <CLI/CLI.hpp>
 #include "config.hpp"
-#include "operations.hpp"
-#include "csv.hpp"
-#include "json.hpp"
-#include "nitro_sheet.hpp"
-#include "progress.hpp"
+#include "runner.hpp"
+#include "server.hpp"
+#include "colors.hpp"
+#include "thread_pool.hpp"
 
 #define FMT_HEADER_ONLY
 #include "fmt/core.h"
 
-// color macros
-#define RESET   "\033[0m"
-#define BOLD    "\033[1m"
 
-#define RED     "\033[31m"
-#define GREEN   "\033[32m"
-#define YELLOW  "\033[33m"
-#define BLUE    "\033[34m"
-#define PURPLE  "\033[35m"
-#define CYAN    "\033[36m"
-#define WHITE   "\033[37m"
-#define MAGENTA "\033[95m"
+namespace fs = std::filesystem;
 
-
-int main(int argc, char **argv)
+static void print_config(const Config &cfg)
 {
-    CLI::App app { BOLD CYAN "XLSX JSON Seed - A tool to process XLSX files using YAML scripts, primarily for Firestore and other databases seeding" RESET };
-
-    std::string script_path;
-
-    app.add_option("-s, --script", script_path, "Path to YAML script")
-        ->required()
-        ->check(CLI::ExistingFile);
-
-    CLI11_PARSE(app, argc, argv);
-
-
-    std::cout << BOLD PURPLE                      
-    R"(
-██  ██ ██     ▄█████ ██  ██      ██ ▄█████ ▄████▄ ███  ██   ▄█████ ██████ ██████ ████▄  
- ████  ██     ▀▀▀▄▄▄  ████       ██ ▀▀▀▄▄▄ ██  ██ ██ ▀▄██   ▀▀▀▄▄▄ ██▄▄   ██▄▄   ██  ██ 
-██  ██ ██████ █████▀ ██  ██   ████▀ █████▀ ▀████▀ ██   ██   █████▀ ██▄▄▄▄ ██▄▄▄▄ ████▀  
-    )" "\n" RESET;
-    std::cout << BOLD           "by " RESET;
-    std::cout << BOLD PURPLE    "shayyz-code\n\n" RESET << std::flush;
-
-    Config cfg = load_script(script_path);
-
     std::cout << BOLD WHITE "- Input File: " RESET << GREEN << cfg.input_file << RESET << "\n";
     std::cout << BOLD WHITE "- Output File: " RESET << GREEN << cfg.output_file << RESET << "\n";
     std::cout << BOLD WHITE "- Header Row: " RESET << GREEN << cfg.header_row << RESET << "\n";
-    std::cout << BOLD WHITE "- First Data Row: " RESET << GREEN << cfg.first_data_row << RESET << "\n\n";
+    std::cout << BOLD WHITE "- First Data Row: " RESET << GREEN << cfg.first_data_row << RESET << "\n";
+    std::cout << BOLD WHITE "- Threads: " RESET << GREEN << global_pool().threads() << RESET << "\n\n";
     std::cout << BOLD WHITE "- Export CSV: " RESET << GREEN << (cfg.export_csv ? "yes" : "No") << RESET << "\n";
     std::cout << BOLD WHITE "- Export XLSX (Excel): " RESET << GREEN << (cfg.export_xlsx ? "yes" : "No") << RESET << "\n\n";
-    
-
-    // Open with OpenXLSX
-    ox::XLDocument wb = open_workbook(cfg.input_file);
-    auto ws = worksheet_active(wb);
-
-    auto sheet = load_sheet_vectorized_from_openxlsx(ws, cfg.header_row, cfg.first_data_row);
-    std::cout << "# Loaded: cols=" << sheet.cols.size() << " rows=" << sheet.num_rows << "\n\n" << std::flush;
-
-    std::cout << BOLD WHITE "#  Running operations..." RESET << "\n\n" << std::flush;
-
-    std::vector<std::string> logs;
-
-
-
-    std::size_t total_ops = cfg.operations.size();
-
-    logs.reserve(total_ops);
-
-    std::size_t op_idx = 0;
+}
 
-    // initial 0%
-    progress_bar(0, total_ops);
+static void print_logs(const RunReport &report)
+{
+    // ======================================================
+    //  PRINT ALL LOGS AFTER PROCESSING
+    // ======================================================
+    std::cout << "\n";
+    for (auto &s : report.logs)
+        std::cout << s << "\n";
+    std::cout << std::flush;
+}
 
-    auto start = std::chrono::high_resolution_clock::now(); // to measure operation time
+// modification time, or nullopt while the file is missing (e.g. mid-save)
+static std::optional<fs::file_time_type> mtime_of(const std::string &path)
+{
+    std::error_code ec;
+    auto t = fs::last_write_time(path, ec);
+    if (ec) return std::nullopt;
+    return t;
+}
 
-    for (auto &op : cfg.operations)
+// --watch: load the input once, then re-run the script on every save of it;
+// a change to the input file (or to the script's input/rows) reloads it
+static int watch_script(const std::string &script_path, const std::string &cache_dir)
+{
+    std::optional<fs::file_time_type> seen_script, seen_input;
+    std::string base_for; // input path and rows the base was loaded for
+    NitroSheet base;      // never modified: every run works on a copy-on-write view
+    bool base_ok = false;
+    Config cfg;
+    bool cfg_ok = false;
+
+    for (bool first = true;; first = false)
     {
-        std::string msg; // message to log
+        if (!first) std::this_thread::sleep_for(std::chrono::milliseconds(200));
 
-        if (op.type == "fill-column")
+        const auto script_t = mtime_of(script_path);
+        if (!script_t) continue;
+        const bool script_changed = script_t != seen_script;
+        if (script_changed)
         {
-            auto column = op.node["column"].as<std::string>();
-            auto fill_with = op.node["fill-with"].as<std::string>();
-            auto new_header = op.node["new-header"].as<std::string>("");
-
-            auto col_index = col_to_index(column);
-             
-            fill_column_nitro(sheet, cfg.header_row, cfg.first_data_row, col_index, fill_with, new_header);
-
-            msg = fmt::format(
-                GREEN "✔ " RESET YELLOW "fill-column" RESET
-                " (" CYAN "{}" RESET ") with "
-                MAGENTA "\"{}\"" RESET
-                " → by header "
-                GREEN "\"{}\"" RESET,
-                column, fill_with, new_header
-            );
+            seen_script = script_t;
+            try
+            {
+                cfg = load_script(script_path);
+                cfg_ok = true;
+            }
+            catch (const std::exception &e)
+            {
+                std::cerr << RED "✘ " << e.what() << RESET "\n" << std::flush;
+                cfg_ok = false;
+            }
         }
-        else if (op.type == "add-column")
-        {
-            auto at = op.node["at"].as<std::string>();
-            auto fill_with = op.node["fill-with"].as<std::string>();
-            auto new_header = op.node["new-header"].as<std::string>("");
-
-            add_column_nitro(sheet, cfg.header_row, cfg.first_data_row, at, fill_with, new_header);
-
-            msg = fmt::format(
-                GREEN "✔ " RESET YELLOW "add-column" RESET
-                " (" CYAN "{}" RESET ") with "
-                MAGENTA "\"{}\"" RESET
-                " → by header "
-                GREEN "\"{}\"" RESET,
-                at, fill_with, new_header
-            );
-        }
-        else if (op.type == "split-column")
-        {
-            auto column = op.node["column"].as<std::string>();
-            auto delim = op.node["delimiter"].as<std::string>();
-            auto targetNodes = op.node["split-to"];
-            auto newHeaderNodes = op.node["new-headers"];
-            auto properPositionNodes = op.node["proper-positions"];
+        if (!cfg_ok) continue;
 
+        const auto input_t = mtime_of(cfg.input_file);
+        const std::string input_key = cfg.input_file + ":" + std::to_string(cfg.header_row) + ":" + std::to_string(cfg.first_data_row);
+        const bool input_changed = input_key != base_for || input_t != seen_input;
+        if (!script_changed && !input_changed) continue;
 
-            std::vector<std::size_t> targets;
-
-            for (const auto &t : targetNodes)
-                targets.push_back(col_to_index(t.as<std::string>()));
-
-            std::vector<std::string> newHeaders;
-
-            for (const auto &h : newHeaderNodes)
-                newHeaders.push_back(h.as<std::string>());
-
-            std::vector<std::uint32_t> properPositions;
-
-            for (const auto &p : properPositionNodes)
-                properPositions.push_back(p.as<std::uint32_t>());
-
-            split_column_nitro(sheet, cfg.header_row, cfg.first_data_row, col_to_index(column), delim[0], targets, newHeaders, properPositions);
+        if (input_changed)
+        {
+            base_for = input_key;
+            seen_input = input_t;
+            const auto t0 = std::chrono::steady_clock::now();
+            try
+            {
+                base = load_input_sheet(cfg.input_file, cfg.header_row, cfg.first_data_row);
+                base_ok = true;
+                std::cout << "# Loaded " << cfg.input_file << ": cols=" << base.cols.size() << " rows=" << base.num_rows << " in "
+                          << std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count() << " ms\n" << std::flush;
+            }
+            catch (const std::exception &e)
+            {
+                std::cerr << RED "✘ Cannot load " << cfg.input_file << ": " << e.what() << RESET "\n" << std::flush;
+                base = NitroSheet();
+                base_ok = false;
+            }
+        }
+        if (!base_ok) continue;
 
-            msg = fmt::format(
-                GREEN "✔ " RESET YELLOW "split-column" RESET
-                " (" CYAN "{}" RESET ")",
-                column
-            );
+        try
+        {
+            const RunReport report = run_script(cfg, RunOptions{ &base, cache_dir, false });
+            print_logs(report);
+            std::cout << BOLD GREEN "\n✔ " RESET << cfg.operations.size() << " operations in " << report.ops_ms
+                      << " ms, export in " << report.export_ms << " ms: cols=" << report.cols << " rows=" << report.rows << "\n";
         }
-        else if (op.type == "uppercase-column")
+        catch (const std::exception &e)
         {
-            auto column = op.node["column"].as<std::string>();
+            std::cerr << RED "\n✘ " << e.what() << RESET "\n";
+        }
+        std::cout << BOLD WHITE "# Watching " RESET << script_path << " and " << cfg.input_file << " (Ctrl+C to stop)\n\n" << std::flush;
+    }
+}
 
-            uppercase_column_nitro(sheet, cfg.first_data_row, col_to_index(column));
+static void print_pool_stats()
+{
+    // per-worker time in tasks: shows how evenly the pool was used
+    if (global_pool().threads() > 1)
+    {
+        std::cout << "\n# Thread pool:\n";
+        const auto stats = global_pool().stats();
+        for (std::size_t w = 0; w < stats.size(); ++w)
+            std::cout << fmt::format("  {:<8} {:>10.1f} ms busy, {} tasks, {} stolen\n",
+                                     w + 1 < stats.size() ? "worker " + std::to_string(w) : "caller",
+                                     stats[w].busy_ns / 1e6, stats[w].tasks, stats[w].steals);
+    }
+}
 
-            msg = fmt::format(
-                GREEN "✔ " RESET YELLOW "uppercase-column" RESET
-                " (" CYAN "{}" RESET ")",
-                column
-            );
-        }
-        else if (op.type == "replace-in-column")
+// several --script: validate them all, load each input once, run them concurrently
+static int run_script_set(const std::vector<std::string> &paths, const std::string &cache_dir)
+{
+    std::vector<Config> cfgs;
+    bool invalid = false;
+    for (const std::string &path : paths)
+    {
+        try
         {
-            auto column = op.node["column"].as<std::string>();
-            auto f = op.node["find"].as<std::string>();
-            auto r = op.node["replace"].as<std::string>();
-
-            replace_in_column_nitro(sheet, cfg.first_data_row, col_to_index(column), f, r);
-
-            msg = fmt::format(
-                GREEN "✔ " RESET YELLOW "replace-in-column" RESET
-                " (" CYAN "{}" RESET ") "
-                MAGENTA "\"{}\"" RESET
-                " → "
-                GREEN "\"{}\"" RESET,
-                column, f, r
-            );
+            cfgs.push_back(load_script(path));
         }
-        else if (op.type == "transform-row")
+        catch (const std::exception &e)
         {
-            auto row = op.node["row"].as<std::uint32_t>();
-            auto to = op.node["to"].as<std::string>();
-            auto delim = op.node["delimiter"].as<std::string>("");
-
-            auto row_index = row - 1; // convert to 0-based
-
-            if (!delim.empty())
-                transform_row_nitro(sheet, row_index, to, delim[0]);
-            else
-                transform_row_nitro(sheet, row_index, to);
-
-            msg = fmt::format(
-                GREEN "✔ " RESET YELLOW "transform-row" RESET
-                " (" CYAN "{}" RESET ") → {}{}",
-                row, to,
-                delim.empty() ? "" : (" (delim=" + delim + ")")
-            );
+            std::cerr << RED "✘ " << e.what() << RESET "\n";
+            invalid = true;
         }
-        else if (op.type == "transform-header")
+    }
+    if (invalid) return 1;
+
+    for (std::size_t i = 0; i < cfgs.size(); ++i)
+        for (std::size_t k = 0; k < i; ++k)
+            if (cfgs[i].output_file == cfgs[k].output_file)
+            {
+                std::cerr << RED "✘ " << paths[k] << " and " << paths[i] << " both write " << cfgs[i].output_file << RESET "\n";
+                return 1;
+            }
+
+    for (std::size_t i = 0; i < cfgs.size(); ++i)
+        std::cout << BOLD WHITE "- " RESET << paths[i] << ": " GREEN << cfgs[i].input_file << RESET " -> " GREEN
+                  << cfgs[i].output_file << RESET << " (" << cfgs[i].operations.size() << " operations)\n";
+    std::cout << BOLD WHITE "- Threads: " RESET << GREEN << global_pool().threads() << RESET << "\n\n";
+    std::cout << BOLD WHITE "#  Running " << cfgs.size() << " scripts..." RESET << "\n" << std::flush;
+
+    const auto start = std::chrono::steady_clock::now();
+    const std::vector<ScriptResult> results = run_scripts(cfgs, cache_dir);
+    const double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+    int failed = 0;
+    for (std::size_t i = 0; i < results.size(); ++i)
+    {
+        const RunReport &report = results[i].report;
+        std::cout << "\n" << BOLD WHITE "# " << paths[i] << RESET "\n";
+        if (!results[i].error.empty())
         {
-            auto to = op.node["to"].as<std::string>();
-            auto delim = op.node["delimiter"].as<std::string>("");
+            std::cerr << RED "✘ " << results[i].error << RESET "\n" << std::flush;
+            ++failed;
+            continue;
+        }
+        print_logs(report);
+        std::cout << fmt::format("# load {:.1f} ms (shared), {} operations {:.1f} ms, export {:.1f} ms: cols={} rows={}\n",
+                                 report.load_ms, cfgs[i].operations.size(), report.ops_ms, report.export_ms, report.cols, report.rows);
+    }
+    std::cout << "\n# Ran " << results.size() << " scripts in " << ms << " ms\n";
 
+    print_pool_stats();
 
-            if (!delim.empty())
-                transform_header_nitro(sheet, to, delim[0]);
-            else
-                transform_header_nitro(sheet, to);
+    if (failed)
+    {
+        std::cerr << "\n" << RED "✘ " << failed << " of " << results.size() << " scripts failed" RESET "\n";
+        return 1;
+    }
+    std::cout << "\n" << BOLD GREEN "✨ Finished seeding!" RESET "\n" << std::flush;
+    return 0;
+}
 
-            msg = fmt::format(
-                GREEN "✔ " RESET YELLOW "transform-header" RESET
-                " → {}{}",
-                to,
-                delim.empty() ? "" : (" (delim=" + delim + ")")
-            );
-        }
-        else if (op.type == "rename-header")
-        {
-            auto column = op.node["column"].as<std::string>();
-            auto new_name = op.node["new-name"].as<std::string>("");
 
-            rename_header_nitro(sheet, col_to_index(column), new_name);
+int main(int argc, char **argv)
+{
+    CLI::App app { BOLD CYAN "XLSX JSON Seed - A tool to process XLSX files using YAML scripts, primarily for Firestore and other databases seeding" RESET };
 
-            msg = fmt::format(
-                GREEN "✔ " RESET YELLOW "rename-header" RESET
-                " (" CYAN "{}" RESET ") → {}",
-                column, new_name
-            );
-        }
-        else if (op.type == "sort-rows-by-column")
-        {
-            auto column = op.node["column"].as<std::string>();
-            auto ascending = op.node["ascending"].as<bool>(true);
+    std::vector<std::string> script_paths;
 
-            sort_rows_by_column_nitro(sheet, col_to_index(column), ascending);
+    app.add_option("-s, --script", script_paths, "Path to YAML script; several share one load of their input (required unless --serve)")
+        ->check(CLI::ExistingFile);
 
-            msg = fmt::format(
-                GREEN "✔ " RESET YELLOW "sort-rows-by-column" RESET
-                " (" CYAN "{}" RESET ") → {}",
-                column, ascending ? "ascending" : "descending"
-            );
-        }
-        else if (op.type == "group-collect")
-        {
-            auto group_by_column = op.node["group-by"].as<std::string>();
-            auto collect_columns = op.node["to-array-columns"];
-            auto output_columns = op.node["to-array-output-columns"];
-            auto marked_unique = op.node["mark-unique-items"].as<bool>(false);
-            auto do_maths_columns = op.node["do-maths-columns"];
-            auto do_maths_operations = op.node["do-maths-operations"];
+    std::size_t threads = 0;
+    app.add_option("-t, --threads", threads, "Worker threads (0 = all cores, 1 = single-threaded)");
 
-            std::vector<std::size_t> collect_columns_indices;
+    std::string cache_dir;
+    app.add_option("-c, --cache", cache_dir, "Checkpoint directory: re-runs resume after the longest unchanged prefix of operations");
 
-            for (const auto &t : collect_columns)
-                collect_columns_indices.push_back(col_to_index(t.as<std::string>()));
+    bool watch = false;
+    app.add_flag("-w, --watch", watch, "Stay running: re-run on every save of the script, reloading the input when it changes");
 
-            std::vector<std::size_t> output_columns_indices;
+    std::string socket_path;
+    app.add_option("--serve", socket_path, "Run as a server on this Unix domain socket (see README)");
 
-            for (const auto &t : output_columns)
-                output_columns_indices.push_back(col_to_index(t.as<std::string>()));
+    std::size_t serve_cache = 8;
+    app.add_option("--serve-cache", serve_cache, "Scripts and input sheets the server keeps loaded (each)");
 
-            std::vector<std::size_t> do_maths_columns_indices;
+    CLI11_PARSE(app, argc, argv);
 
-            for (const auto &t : do_maths_columns)
-                do_maths_columns_indices.push_back(col_to_index(t.as<std::string>()));
+    if (script_paths.empty() && socket_path.empty())
+    {
+        std::cerr << RED "✘ --script is required" RESET "\n";
+        return 1;
+    }
+    if (watch && script_paths.size() != 1)
+    {
+        std::cerr << RED "✘ --watch takes exactly one script" RESET "\n";
+        return 1;
+    }
 
-            std::vector<std::string> do_maths_ops;
+    set_thread_count(threads);
 
-            for (const auto &t : do_maths_operations)
-                do_maths_ops.push_back(t.as<std::string>());
 
-            group_collect_nitro(sheet, col_to_index(group_by_column), collect_columns_indices, output_columns_indices, marked_unique, do_maths_columns_indices, do_maths_ops);
+    std::cout << BOLD PURPLE                      
+    R"(
+██  ██ ██     ▄█████ ██  ██      ██ ▄█████ ▄████▄ ███  ██   ▄█████ ██████ ██████ ████▄  
+ ████  ██     ▀▀▀▄▄▄  ████       ██ ▀▀▀▄▄▄ ██  ██ ██ ▀▄██   ▀▀▀▄▄▄ ██▄▄   ██▄▄   ██  ██ 
+██  ██ ██████ █████▀ ██  ██   ████▀ █████▀ ▀████▀ ██   ██   █████▀ ██▄▄▄▄ ██▄▄▄▄ ████▀  
+    )" "\n" RESET;
+    std::cout << BOLD           "by " RESET;
+    std::cout << BOLD PURPLE    "shayyz-code\n\n" RESET << std::flush;
 
-            msg = fmt::format(
-                GREEN "✔ " RESET YELLOW "group-collect-to" RESET
-                " (group=" CYAN "{}" RESET ")",
-                group_by_column
-            );
-        }
-        else if (op.type == "reassign-numbering")
+    if (!socket_path.empty())
+    {
+        std::cout << BOLD WHITE "- Threads: " RESET << GREEN << global_pool().threads() << RESET << "\n";
+        std::cout << BOLD WHITE "- Cached scripts/inputs: " RESET << GREEN << serve_cache << RESET << "\n\n";
+        try
         {
-            auto column = op.node["column"].as<std::string>();
-            auto prefix = op.node["prefix"].as<std::string>();
-            auto suffix = op.node["suffix"].as<std::string>();
-            auto start_from = op.node["start-from"].as<std::uint32_t>(1);
-            auto step = op.node["step"].as<std::uint32_t>(1);
-
-            reassign_numbering_nitro(sheet, col_to_index(column), prefix, suffix, start_from, step );
-
-            msg = fmt::format(
-                GREEN "✔ " RESET YELLOW "reassign-numbering" RESET
-                " (" CYAN "{}" RESET ")",
-                column
-            );
+            SeedServer(serve_cache, cache_dir).listen(socket_path);
         }
-        else if (op.type == "remove-column")
+        catch (const std::exception &e)
         {
-            auto column = op.node["column"].as<std::string>();
-
-            remove_column_nitro(sheet, col_to_index(column));
-
-            msg = fmt::format(
-                GREEN "✔ " RESET YELLOW "remove-column" RESET
-                " (" CYAN "{}" RESET ")",
-                column
-            );
+            std::cerr << RED "✘ " << e.what() << RESET "\n";
+            return 1;
         }
-        else {
-            op_idx--; // negate the upcoming increment
-            
-            msg = fmt::format(
-                RED "✘ Unknown operation type: {}" RESET,
-                op.type
-            );
-        }
-
-        // ---- refresh the progress bar once ----
-        op_idx++;
-
-        // Store the formatted message
-        logs.push_back(msg);
-
-        progress_bar(op_idx, total_ops);
+        return 0;
     }
 
-    auto end = std::chrono::high_resolution_clock::now(); // to measure operation time
-    auto ms = std::chrono::duration<double, std::milli>(end - start).count();
-
-    std::cout << "\n# Computed " << total_ops << " operations in " << ms << " ms\n" << std::flush;
+    if (watch)
+        return watch_script(script_paths[0], cache_dir);
 
-    // ======================================================
-    //  PRINT ALL LOGS AFTER PROCESSING
-    // ======================================================
-    std::cout << "\n";
-    for (auto &s : logs)
-        std::cout << s << "\n";
-    std::cout << std::flush;
-    
+    if (script_paths.size() > 1)
+        return run_script_set(script_paths, cache_dir);
 
+    // compile and validate the whole script before the (slow) workbook load
+    Config cfg;
+    try
+    {
+        cfg = load_script(script_paths[0]);
+    }
+    catch (const std::exception &e)
+    {
+        std::cerr << RED "✘ " << e.what() << RESET "\n";
+        return 1;
+    }
 
-    save_json_nitro(sheet, cfg.header_row, cfg.first_data_row, cfg.output_file + ".json");
+    print_config(cfg);
 
-    if (cfg.export_csv)
+    RunReport report;
+    try
     {
-        save_csv_nitro(sheet, cfg.output_file + ".csv");
+        report = run_script(cfg, RunOptions{ nullptr, cache_dir });
     }
-    if (cfg.export_xlsx)
+    catch (const std::exception &e)
     {
-        save_as_xlsx(sheet, cfg.header_row, cfg.first_data_row, cfg.output_file + ".xlsx");
+        std::cerr << RED "\n✘ " << e.what() << RESET "\n";
+        return 1;
     }
 
-    close_workbook(wb);
-    
+    std::cout << "\n# Computed " << cfg.operations.size() << " operations in " << report.ops_ms << " ms\n" << std::flush;
+    print_logs(report);
+
+    print_pool_stats();
+
     std::cout << "\n" << BOLD GREEN "✨ Finished seeding!" RESET "\n";
     std::cout << std::flush;
 
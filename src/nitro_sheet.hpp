@@ -3,8 +3,11 @@
 #include "openxlsx_adapter.hpp"
 #include <string>
 #include <vector>
-#include <thread>
-#include <future>
+#include <memory>
+#include <string_view>
+#include <unordered_map>
+#include <mutex>
+#include <atomic>
 #include <random>
 #include <optional>
 #include <functional>
@@ -15,29 +18,404 @@
 #include <fstream>
 #include <stdexcept>
 #include "utils/utils.hpp"
+#include "thread_pool.hpp"
 #include <iostream>
 #include <iomanip>
 
+// text of list and timestamp cells, rendered on first string access
+struct CellText {
+    std::once_flag once;
+    std::vector<std::string> cells;
+};
+
+// Validity bitmap of a column (bit r set when cell r is non-empty), built on
+// first use and dropped by every write. Copies start out empty.
+struct ValidityCache {
+    std::mutex m;
+    std::atomic<bool> ready{ false };
+    std::vector<uint64_t> words;
+
+    ValidityCache() = default;
+    ValidityCache(const ValidityCache &) {}
+    ValidityCache &operator=(const ValidityCache &) { reset(); return *this; }
+
+    void reset() {
+        if (!ready.load(std::memory_order_relaxed)) return;
+        words = {};
+        ready.store(false, std::memory_order_relaxed);
+    }
+};
+
+// Cell storage of a column. Shared between Column handles until one of them writes.
+struct ColumnData {
+    std::vector<std::string> vals;     // plain cells
+
+    // dictionary encoding for low-cardinality columns: cell r is dict[codes[r]],
+    // dict entries are unique
+    std::vector<uint32_t> codes;
+    std::vector<std::string> dict;
+    bool is_dict = false;
+
+    // list cells: cell r holds items[offsets[r] .. offsets[r + 1])
+    std::vector<uint32_t> offsets;
+    std::vector<std::string> items;
+    bool is_list = false;
+
+    // timestamp cells: epoch seconds, kFirestoreNow for "now"
+    std::vector<int64_t> ts;
+    bool is_timestamp = false;
+
+    std::shared_ptr<CellText> text; // list / timestamp cells as strings
+
+    ValidityCache valid;
+};
+
+// columns with at most this many distinct values (and few per row) get dictionary-encoded
+constexpr size_t kDictMaxEntries = 4096;
+constexpr size_t kDictMinRowsPerEntry = 8;
+
 // Column + NitroSheet
+//
+// A Column is a small handle (header + reference-counted data), so
+// NitroSheet::cols is an indirection table: inserting, removing or
+// reordering columns only moves handles, never cell data. Copying a
+// Column (or a whole NitroSheet) shares the data copy-on-write.
 struct Column {
     std::string header;
-    std::vector<std::string> vals;
     bool dirty = false;
+
+    Column() = default;
+    Column(std::string h, std::vector<std::string> v)
+        : header(std::move(h)), data_(std::make_shared<ColumnData>()) { data_->vals = std::move(v); }
+
+    // ---- read access, never copies ----
+    size_t size() const {
+        if (!data_) return 0;
+        if (data_->is_list) return data_->offsets.empty() ? 0 : data_->offsets.size() - 1;
+        if (data_->is_timestamp) return data_->ts.size();
+        return data_->is_dict ? data_->codes.size() : data_->vals.size();
+    }
+
+    // cell r (physical row); r < size(). List cells read as their JSON array
+    // text, timestamp cells as their Firestore object (or __fire_ts_now__).
+    const std::string &at(size_t r) const {
+        if (data_->is_dict) return data_->dict[data_->codes[r]];
+        if (data_->is_list || data_->is_timestamp) return cell_text()[r];
+        return data_->vals[r];
+    }
+
+    // bit r set when cell r is non-empty (list and timestamp cells always are).
+    // Computed once per version of the cells without touching string data for
+    // dictionary, list and timestamp columns; valid until the next write access.
+    const std::vector<uint64_t> &validity() const {
+        static const std::vector<uint64_t> none;
+        if (!data_) return none;
+        ValidityCache &v = data_->valid;
+        if (!v.ready.load(std::memory_order_acquire)) {
+            std::lock_guard<std::mutex> lock(v.m);
+            if (!v.ready.load(std::memory_order_relaxed)) {
+                v.words = compute_validity();
+                v.ready.store(true, std::memory_order_release);
+            }
+        }
+        return v.words;
+    }
+
+    bool has_value(size_t r) const { return (validity()[r >> 6] >> (r & 63)) & 1; }
+
+    bool is_dict() const { return data_ && data_->is_dict; }
+    const std::vector<uint32_t> &codes() const { return data_->codes; }
+    const std::vector<std::string> &dict() const { return data_->dict; }
+
+    bool is_list() const { return data_ && data_->is_list; }
+    const std::vector<uint32_t> &offsets() const { return data_->offsets; }
+    const std::vector<std::string> &items() const { return data_->items; }
+
+    bool is_timestamp() const { return data_ && data_->is_timestamp; }
+    const std::vector<int64_t> &timestamps() const { return data_->ts; }
+
+    // append list cell r as a JSON array (see append_json_list)
+    void append_list_json(size_t r, std::string &out) const {
+        const std::string *items = data_->items.data();
+        append_json_list(out, items + data_->offsets[r], items + data_->offsets[r + 1]);
+    }
+
+    // append list or timestamp cell r as the string at() returns, without
+    // building the whole column's text
+    void append_cell_text(size_t r, std::string &out) const {
+        if (data_->is_list) append_list_json(r, out);
+        else if (data_->ts[r] == kFirestoreNow) out += "__fire_ts_now__";
+        else append_firestore_timestamp(out, data_->ts[r]);
+    }
+
+    // ---- write access; detaches from other handles first (hoist out of row loops) ----
+
+    // plain cells; decodes a dictionary column, renders list and timestamp cells as text
+    std::vector<std::string> &vals_mut() {
+        ColumnData &d = detach();
+        if (d.is_list || d.is_timestamp) {
+            d.vals.assign(size(), std::string());
+            for (size_t r = 0; r < d.vals.size(); ++r) append_cell_text(r, d.vals[r]);
+            d.offsets = {};
+            d.items = {};
+            d.ts = {};
+            d.text.reset();
+            d.is_list = d.is_timestamp = false;
+        }
+        else if (d.is_dict) {
+            d.vals.resize(d.codes.size());
+            for (size_t r = 0; r < d.codes.size(); ++r)
+                d.vals[r] = d.dict[d.codes[r]];
+            d.codes = {};
+            d.dict = {};
+            d.is_dict = false;
+        }
+        return d.vals;
+    }
+
+    // apply f(std::string &) once per dictionary entry, then merge entries that became equal
+    template <typename F>
+    void transform_dict(F f) {
+        ColumnData &d = detach();
+        for (auto &e : d.dict) f(e);
+
+        std::unordered_map<std::string, uint32_t> seen;
+        std::vector<uint32_t> remap(d.dict.size());
+        std::vector<std::string> merged;
+        for (size_t i = 0; i < d.dict.size(); ++i) {
+            auto it = seen.emplace(d.dict[i], static_cast<uint32_t>(merged.size())).first;
+            if (it->second == merged.size()) merged.push_back(std::move(d.dict[i]));
+            remap[i] = it->second;
+        }
+        if (merged.size() != d.dict.size())
+            for (auto &code : d.codes) code = remap[code];
+        d.dict = std::move(merged);
+    }
+
+    // encode as dictionary if the column has few distinct values; true if encoded
+    bool dict_encode(size_t max_entries = kDictMaxEntries) {
+        if (!data_ || data_->is_dict) return is_dict();
+        if (data_->is_list || data_->is_timestamp) return false;
+        const std::vector<std::string> &vals = data_->vals;
+        const size_t limit = std::min(max_entries, vals.size() / kDictMinRowsPerEntry);
+        if (limit == 0) return false;
+
+        std::unordered_map<std::string_view, uint32_t> index;
+        std::vector<uint32_t> codes(vals.size());
+        std::vector<std::string> dict;
+        for (size_t r = 0; r < vals.size(); ++r) {
+            auto it = index.find(vals[r]);
+            if (it == index.end()) {
+                if (dict.size() == limit) return false; // too many distinct values
+                it = index.emplace(vals[r], static_cast<uint32_t>(dict.size())).first;
+                dict.push_back(vals[r]);
+            }
+            codes[r] = it->second;
+        }
+
+        assign_dict(std::move(codes), std::move(dict)); // fresh data: other handles keep the plain cells
+        return true;
+    }
+
+    // replace the cells with an already-built dictionary encoding (dict entries unique)
+    void assign_dict(std::vector<uint32_t> codes, std::vector<std::string> dict) {
+        auto encoded = std::make_shared<ColumnData>();
+        encoded->codes = std::move(codes);
+        encoded->dict = std::move(dict);
+        encoded->is_dict = true;
+        data_ = std::move(encoded);
+        dirty = true;
+    }
+
+    // replace the cells with lists: cell r holds items[offsets[r] .. offsets[r + 1])
+    void assign_list(std::vector<uint32_t> offsets, std::vector<std::string> items) {
+        auto list = std::make_shared<ColumnData>();
+        list->offsets = std::move(offsets);
+        list->items = std::move(items);
+        list->is_list = true;
+        list->text = std::make_shared<CellText>();
+        data_ = std::move(list);
+        dirty = true;
+    }
+
+    // replace the cells with timestamps (epoch seconds or kFirestoreNow)
+    void assign_timestamps(std::vector<int64_t> ts) {
+        auto stamps = std::make_shared<ColumnData>();
+        stamps->ts = std::move(ts);
+        stamps->is_timestamp = true;
+        stamps->text = std::make_shared<CellText>();
+        data_ = std::move(stamps);
+        dirty = true;
+    }
+
+    // replace the cells with plain values
+    void assign(std::vector<std::string> vals) {
+        auto plain = std::make_shared<ColumnData>();
+        plain->vals = std::move(vals);
+        data_ = std::move(plain);
+        dirty = true;
+    }
+
+    // set one cell (dictionary columns look the value up, appending a new entry if needed)
+    void set(size_t r, const std::string &value) {
+        if (is_list() || is_timestamp()) vals_mut();
+        ColumnData &d = detach();
+        if (!d.is_dict) { d.vals[r] = value; return; }
+
+        auto it = std::find(d.dict.begin(), d.dict.end(), value);
+        d.codes[r] = static_cast<uint32_t>(it - d.dict.begin());
+        if (it == d.dict.end()) d.dict.push_back(value);
+    }
+
+    // every cell = value, stored as a one-entry dictionary
+    void assign_constant(size_t rows, std::string value) {
+        assign_dict(std::vector<uint32_t>(rows, 0), { std::move(value) });
+    }
+
+    // keep only the given physical rows, in that order
+    void select_rows(const std::vector<uint32_t> &rows) {
+        ColumnData &d = detach();
+        if (d.is_dict) {
+            std::vector<uint32_t> picked(rows.size());
+            for (size_t i = 0; i < rows.size(); ++i) picked[i] = d.codes[rows[i]];
+            d.codes = std::move(picked);
+        } else if (d.is_list) {
+            std::vector<uint32_t> offsets(1, 0);
+            std::vector<std::string> items;
+            offsets.reserve(rows.size() + 1);
+            for (uint32_t r : rows) {
+                for (uint32_t k = d.offsets[r]; k < d.offsets[r + 1]; ++k) items.push_back(d.items[k]);
+                offsets.push_back(static_cast<uint32_t>(items.size()));
+            }
+            d.offsets = std::move(offsets);
+            d.items = std::move(items);
+            d.text = std::make_shared<CellText>();
+        } else if (d.is_timestamp) {
+            std::vector<int64_t> picked(rows.size());
+            for (size_t i = 0; i < rows.size(); ++i) picked[i] = d.ts[rows[i]];
+            d.ts = std::move(picked);
+            d.text = std::make_shared<CellText>();
+        } else {
+            std::vector<std::string> picked(rows.size());
+            for (size_t i = 0; i < rows.size(); ++i) picked[i] = std::move(d.vals[rows[i]]);
+            d.vals = std::move(picked);
+        }
+    }
+
+    // share src's cells (header is kept); costs nothing until one side writes
+    void alias(const Column &src) { data_ = src.data_; }
+
+    bool shares_data_with(const Column &other) const { return data_ && data_ == other.data_; }
+
+private:
+    std::vector<uint64_t> compute_validity() const {
+        const size_t n = size();
+        std::vector<uint64_t> words((n + 63) / 64, 0);
+        const ColumnData &d = *data_;
+
+        if (d.is_list || d.is_timestamp) {
+            std::fill(words.begin(), words.end(), ~uint64_t(0));
+        } else if (d.is_dict) {
+            std::vector<uint8_t> entry(d.dict.size());
+            for (size_t e = 0; e < entry.size(); ++e) entry[e] = !d.dict[e].empty();
+            if (std::find(entry.begin(), entry.end(), 0) == entry.end()) {
+                std::fill(words.begin(), words.end(), ~uint64_t(0));
+            } else {
+                for (size_t r = 0; r < n; ++r)
+                    words[r >> 6] |= uint64_t(entry[d.codes[r]]) << (r & 63);
+            }
+        } else {
+            for (size_t r = 0; r < n; ++r)
+                words[r >> 6] |= uint64_t(!d.vals[r].empty()) << (r & 63);
+        }
+
+        if (n & 63) words.back() &= (uint64_t(1) << (n & 63)) - 1;
+        return words;
+    }
+
+    const std::vector<std::string> &cell_text() const {
+        CellText &t = *data_->text;
+        std::call_once(t.once, [&] {
+            t.cells.resize(size());
+            for (size_t r = 0; r < t.cells.size(); ++r) append_cell_text(r, t.cells[r]);
+        });
+        return t.cells;
+    }
+
+    ColumnData &detach() {
+        if (!data_)
+            data_ = std::make_shared<ColumnData>();
+        else if (data_.use_count() > 1)
+            data_ = std::make_shared<ColumnData>(*data_);
+        else // sole owner: see other handles' reads of the shared data finish first (concurrent ops)
+            std::atomic_thread_fence(std::memory_order_acquire);
+        data_->valid.reset();
+        dirty = true;
+        return *data_;
+    }
+
+    std::shared_ptr<ColumnData> data_;
 };
 
 struct NitroSheet {
-    std::vector<Column> cols;
+    std::vector<Column> cols; // column handles (see Column)
     uint32_t first_row = 1;
     uint32_t data_row_start = 2;
-    uint32_t num_rows = 0;
+    uint32_t num_rows = 0;    // physical rows stored in every column
+
+    // Selection vector: when has_sel is set, logical row i lives in physical
+    // row sel[i]. Row-reordering/dropping ops (sort, group, ...) only rewrite
+    // this; cells are moved by materialize_selection() when really needed.
+    std::vector<uint32_t> sel;
+    bool has_sel = false;
+
+    size_t row_count() const { return has_sel ? sel.size() : num_rows; }          // logical rows
+    size_t row_at(size_t i) const { return has_sel ? sel[i] : i; }                // logical -> physical
+
+    // bit r (physical row) set when any column has a non-empty cell in row r;
+    // the OR of the columns' validity bitmaps
+    std::vector<uint64_t> nonempty_row_mask() const {
+        std::vector<uint64_t> mask((static_cast<size_t>(num_rows) + 63) / 64, 0);
+        for (const auto &col : cols) {
+            const std::vector<uint64_t> &valid = col.validity();
+            const size_t n = std::min(mask.size(), valid.size());
+            for (size_t w = 0; w < n; ++w) mask[w] |= valid[w];
+        }
+        if (num_rows & 63) mask.back() &= (uint64_t(1) << (num_rows & 63)) - 1;
+        return mask;
+    }
 };
 
-// helper functions (to_snake_single, split_to_parts, random_past_utc_date_within_n_years_opt)
-// copy them from the previous nitro implementation exactly (kept concise here)
+// Replace the logical row order; `physical_rows` lists physical row indices
+// in their new logical order (rows not listed are dropped).
+inline void set_row_selection(NitroSheet &sheet, std::vector<uint32_t> physical_rows)
+{
+    sheet.sel = std::move(physical_rows);
+    sheet.has_sel = true;
+}
 
-// For brevity in this message: copy implementations from the previous nitro_sheet.hpp (to_snake_single, split_to_parts, random_past..., apply_unary_to_column, split_column_into_targets, export_csv_buffered, write_back_to_xlsx) but **use the adapter** for write_back_to_xlsx below:
+// Physically reorder/compact every column to follow the selection, then drop it.
+inline void materialize_selection(NitroSheet &sheet)
+{
+    if (!sheet.has_sel) return;
 
-inline NitroSheet load_sheet_vectorized_from_openxlsx(ox::XLWorksheet &ws, uint32_t header_row, uint32_t first_data_row) {
+    const size_t rows = sheet.sel.size();
+    for (auto &col : sheet.cols)
+    {
+        if (col.size() < sheet.num_rows) continue; // ragged column: nothing to follow
+        col.select_rows(sheet.sel);
+    }
+
+    sheet.num_rows = static_cast<uint32_t>(rows);
+    sheet.sel.clear();
+    sheet.has_sel = false;
+}
+
+// string and date helpers (to_snake, parse_datetime_epoch, random_past_epoch, ...)
+// live in utils/utils.hpp; the OpenXLSX reads and writes go through the adapter
+
+// read every cell as a plain string on the calling thread (no pool work)
+inline NitroSheet read_sheet_from_openxlsx(ox::XLWorksheet &ws, uint32_t header_row, uint32_t first_data_row) {
     NitroSheet s;
     SheetDimensions dims = sheet_dimensions(ws);
     uint32_t first_row = dims.first_row;
@@ -55,17 +433,28 @@ inline NitroSheet load_sheet_vectorized_from_openxlsx(ox::XLWorksheet &ws, uint3
     s.cols.reserve(last_col - first_col + 1);
 
     for (uint32_t col = first_col; col <= last_col; ++col) {
-        Column c;
-        c.header = sheet_cell_get(ws, col, header_row);
-        c.vals.resize(s.num_rows);
+        std::vector<std::string> vals(s.num_rows);
         for (uint32_t r = 0; r < s.num_rows; ++r) {
-            c.vals[r] = sheet_cell_get(ws, col, first_data_row + r);
+            vals[r] = sheet_cell_get(ws, col, first_data_row + r);
         }
-        s.cols.emplace_back(std::move(c));
+        s.cols.emplace_back(sheet_cell_get(ws, col, header_row), std::move(vals));
     }
     return s;
 }
 
+// encoding is per column and runs on the pool
+inline void dict_encode_columns(NitroSheet &s) {
+    parallel_for_chunks(s.cols.size(), [&](size_t begin, size_t end) {
+        for (size_t c = begin; c < end; ++c) s.cols[c].dict_encode();
+    }, 1);
+}
+
+inline NitroSheet load_sheet_vectorized_from_openxlsx(ox::XLWorksheet &ws, uint32_t header_row, uint32_t first_data_row) {
+    NitroSheet s = read_sheet_from_openxlsx(ws, header_row, first_data_row);
+    dict_encode_columns(s);
+    return s;
+}
+
 // write_back_to_xlsx uses adapter sheet_cell_set
 inline void write_back_to_xlsx(
     const NitroSheet &sheet,
@@ -76,7 +465,7 @@ inline void write_back_to_xlsx(
     const size_t num_cols = sheet.cols.size();
     if (num_cols == 0) return;
 
-    const size_t num_rows = sheet.num_rows;
+    const size_t num_rows = sheet.row_count();
 
     // ---- Write headers ----
     for (size_t c = 0; c < num_cols; ++c)
@@ -87,15 +476,23 @@ inline void write_back_to_xlsx(
     }
 
     // ---- Write all cell values ----
+    std::string rendered; // list/timestamp cells are rendered here on demand
     for (size_t r = 0; r < num_rows; ++r)
     {
         uint32_t excel_row = first_data_row + r;
 
         for (size_t c = 0; c < num_cols; ++c)
         {
-            const std::string &val = sheet.cols[c].vals[r];
+            const Column &col = sheet.cols[c];
             std::string cell_ref = index_to_col(c) + std::to_string(excel_row);
-            ws.cell(cell_ref).value() = val;
+            if (col.is_list() || col.is_timestamp())
+            {
+                rendered.clear();
+                col.append_cell_text(sheet.row_at(r), rendered);
+                ws.cell(cell_ref).value() = rendered;
+            }
+            else
+                ws.cell(cell_ref).value() = col.at(sheet.row_at(r));
         }
     }
 }
@@ -131,7 +528,8 @@ inline void print_nitro_sheet(const NitroSheet &sheet, std::ostream &os = std::c
     os << "NitroSheet Debug Dump\n";
     os << "----------------------------------------\n";
     os << "Columns: " << sheet.cols.size() << "\n";
-    os << "Data rows (sheet.num_rows): " << sheet.num_rows << "\n\n";
+    os << "Data rows (sheet.num_rows): " << sheet.num_rows << "\n";
+    os << "Selected rows: " << (sheet.has_sel ? std::to_string(sheet.sel.size()) : "all") << "\n\n";
 
     if (sheet.cols.empty()) {
         os << "(empty sheet)\n";
@@ -148,8 +546,10 @@ inline void print_nitro_sheet(const NitroSheet &sheet, std::ostream &os = std::c
     // Print column sizes
     os << "Column sizes:\n";
     for (size_t c = 0; c < sheet.cols.size(); ++c) {
-        os << "  col " << c << ": vals.size() = " << sheet.cols[c].vals.size();
-        if (sheet.cols[c].vals.size() != sheet.num_rows)
+        os << "  col " << c << ": size() = " << sheet.cols[c].size();
+        if (sheet.cols[c].is_dict())
+            os << " (dict, " << sheet.cols[c].dict().size() << " entries)";
+        if (sheet.cols[c].size() != sheet.num_rows)
             os << "  <-- MISMATCH!";
         os << "\n";
     }
@@ -158,11 +558,12 @@ inline void print_nitro_sheet(const NitroSheet &sheet, std::ostream &os = std::c
     // Print row data
     os << "Data:\n";
 
-    for (size_t r = 0; r < sheet.num_rows; ++r) {
-        os << "Row " << std::setw(4) << r << ": ";
+    for (size_t i = 0; i < sheet.row_count(); ++i) {
+        size_t r = sheet.row_at(i);
+        os << "Row " << std::setw(4) << i << ": ";
         for (size_t c = 0; c < sheet.cols.size(); ++c) {
-            if (r < sheet.cols[c].vals.size())
-                os << "\"" << sheet.cols[c].vals[r] << "\"";
+            if (r < sheet.cols[c].size())
+                os << "\"" << sheet.cols[c].at(r) << "\"";
             else
                 os << "(OOB!)";
 
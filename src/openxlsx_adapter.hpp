@@ -31,6 +31,11 @@ inline ox::XLWorksheet worksheet_active(ox::XLDocument &doc) {
     return doc.workbook().worksheet(1); // workbook().worksheet(1) is the first sheet in many versions
 }
 
+// get a worksheet by its tab name
+inline ox::XLWorksheet worksheet_named(ox::XLDocument &doc, const std::string &name) {
+    return doc.workbook().worksheet(name);
+}
+
 // safe get value from cell (col = 1-based index, row = 1-based index)
 // returns empty string if no value / blank cell
 inline std::string sheet_cell_get(ox::XLWorksheet &ws, uint32_t col, uint32_t row) {
@@ -1,10 +1,268 @@
 #include <algorithm>
+#include <limits>
 #include <sstream>
+#include <string_view>
+#include <unordered_map>
 #include "operations.hpp"
+#include "thread_pool.hpp"
 #include "utils/dynamic_placeholder.hpp"
+#include "utils/linear_regex.hpp"
 
 // ops
 
+// ----------------------
+// Fill templates: ifcol conditions are evaluated a column at a time into
+// bitmasks (bit r = physical row r), then the rows are assembled
+// ----------------------
+namespace {
+
+using RowMask = std::vector<uint64_t>;
+
+inline size_t mask_words(size_t rows) { return (rows + 63) / 64; }
+inline bool mask_test(const RowMask &m, size_t r) { return (m[r >> 6] >> (r & 63)) & 1u; }
+
+inline bool compare_numbers(double lhs, CmpOp op, double rhs)
+{
+    switch (op)
+    {
+        case CmpOp::Eq: return lhs == rhs;
+        case CmpOp::Ne: return lhs != rhs;
+        case CmpOp::Gt: return lhs > rhs;
+        case CmpOp::Lt: return lhs < rhs;
+        case CmpOp::Ge: return lhs >= rhs;
+        case CmpOp::Le: return lhs <= rhs;
+        default: return false;
+    }
+}
+
+// numeric comparison if both sides are numbers, otherwise only == and != (as strings)
+bool compare_cell(const std::string &cell, const Comparison &c)
+{
+    double lhs = 0.0;
+    if (c.value_is_number && parse_number(cell, lhs)) return compare_numbers(lhs, c.op, c.value_num);
+    if (c.op == CmpOp::Eq) return cell == c.value;
+    if (c.op == CmpOp::Ne) return cell != c.value;
+    return false;
+}
+
+// a plain column parsed to doubles once, shared by every comparison against it
+struct NumericColumn {
+    std::vector<double> v;
+    RowMask is_num;
+};
+
+const NumericColumn &numeric_column(const Column &col, size_t col_index, size_t rows,
+                                    std::unordered_map<size_t, NumericColumn> &cache)
+{
+    auto it = cache.find(col_index);
+    if (it != cache.end()) return it->second;
+
+    NumericColumn nc;
+    nc.v.assign(rows, 0.0);
+    nc.is_num.assign(mask_words(rows), 0);
+    for (size_t r = 0; r < rows; ++r)
+        if (parse_number(col.at(r), nc.v[r])) nc.is_num[r >> 6] |= uint64_t(1) << (r & 63);
+        else nc.v[r] = 0.0;
+    return cache.emplace(col_index, std::move(nc)).first->second;
+}
+
+// branch-free compare of 64 rows per word; non-numeric cells are cleared by is_num
+template <CmpOp Op>
+void compare_numeric_words(const NumericColumn &nc, double rhs, size_t rows, RowMask &out)
+{
+    for (size_t w = 0; w < mask_words(rows); ++w)
+    {
+        const size_t base = w * 64;
+        const size_t n = std::min<size_t>(64, rows - base);
+        const double *x = nc.v.data() + base;
+        uint64_t bits = 0;
+        for (size_t j = 0; j < n; ++j)
+            bits |= uint64_t(compare_numbers(x[j], Op, rhs)) << j;
+        out[w] = bits & nc.is_num[w];
+    }
+}
+
+// test(cell) over rows [0, min(rows, column size)), once per entry for dictionary columns
+template <typename Test>
+RowMask eval_cell_test(const Column &col, size_t rows, Test test)
+{
+    RowMask out(mask_words(rows), 0);
+    const size_t n = std::min(rows, col.size());
+    if (col.is_dict())
+    {
+        const auto &dict = col.dict();
+        std::vector<uint8_t> hit(dict.size());
+        for (size_t e = 0; e < dict.size(); ++e) hit[e] = test(dict[e]);
+        const auto &codes = col.codes();
+        for (size_t r = 0; r < n; ++r)
+            out[r >> 6] |= uint64_t(hit[codes[r]]) << (r & 63);
+    }
+    else
+    {
+        for (size_t r = 0; r < n; ++r)
+            out[r >> 6] |= uint64_t(test(col.at(r))) << (r & 63);
+    }
+    return out;
+}
+
+// one comparison over rows [0, min(rows, column size)); later bits stay clear
+RowMask eval_comparison(const NitroSheet &sheet, const Comparison &c, size_t rows,
+                        std::unordered_map<size_t, NumericColumn> &numeric)
+{
+    RowMask out(mask_words(rows), 0);
+    if (c.col >= sheet.cols.size()) return out;
+    const Column &col = sheet.cols[c.col];
+    const size_t n = std::min(rows, col.size());
+
+    if (col.is_dict() || !c.value_is_number) // per entry, or string == / != only
+        return eval_cell_test(col, rows, [&](const std::string &cell) { return compare_cell(cell, c); });
+
+    const NumericColumn &nc = numeric_column(col, c.col, n, numeric);
+    switch (c.op)
+    {
+        case CmpOp::Eq: compare_numeric_words<CmpOp::Eq>(nc, c.value_num, n, out); break;
+        case CmpOp::Gt: compare_numeric_words<CmpOp::Gt>(nc, c.value_num, n, out); break;
+        case CmpOp::Lt: compare_numeric_words<CmpOp::Lt>(nc, c.value_num, n, out); break;
+        case CmpOp::Ge: compare_numeric_words<CmpOp::Ge>(nc, c.value_num, n, out); break;
+        case CmpOp::Le: compare_numeric_words<CmpOp::Le>(nc, c.value_num, n, out); break;
+        case CmpOp::Ne:
+            // a cell that is not a number never equals a numeric literal as a string
+            compare_numeric_words<CmpOp::Ne>(nc, c.value_num, n, out);
+            for (size_t w = 0; w < nc.is_num.size(); ++w) out[w] |= ~nc.is_num[w];
+            break;
+        default: break;
+    }
+    if (n % 64) out[n >> 6] &= (uint64_t(1) << (n % 64)) - 1; // clear rows past the column
+    if (n < rows) std::fill(out.begin() + mask_words(n), out.end(), 0);
+    return out;
+}
+
+// '||' of '&&' groups, word by word
+RowMask eval_condition(const NitroSheet &sheet, const FillSegment &seg, size_t rows,
+                       std::unordered_map<size_t, NumericColumn> &numeric)
+{
+    RowMask any(mask_words(rows), 0);
+    for (const auto &group : seg.any_of_all)
+    {
+        RowMask all = eval_comparison(sheet, group[0], rows, numeric);
+        for (size_t k = 1; k < group.size(); ++k)
+        {
+            RowMask next = eval_comparison(sheet, group[k], rows, numeric);
+            for (size_t w = 0; w < all.size(); ++w) all[w] &= next[w];
+        }
+        for (size_t w = 0; w < any.size(); ++w) any[w] |= all[w];
+    }
+    return any;
+}
+
+// rows below this have every column the condition reads; past it the
+// placeholder is left as written
+size_t condition_rows(const NitroSheet &sheet, const FillSegment &seg, size_t rows)
+{
+    for (const auto &group : seg.any_of_all)
+        for (const auto &c : group)
+            rows = std::min(rows, c.col < sheet.cols.size() ? sheet.cols[c.col].size() : size_t(0));
+    return rows;
+}
+
+void append_operand(std::string &out, const NitroSheet &sheet, const FillOperand &o, size_t r)
+{
+    if (!o.is_col) { out += o.text; return; }
+    if (o.col < sheet.cols.size() && r < sheet.cols[o.col].size()) out += sheet.cols[o.col].at(r);
+}
+
+constexpr size_t kMaxBulkConditions = 8; // up to 2^8 distinct rendered values
+
+void fill_from_template(NitroSheet &sheet, Column &col, const std::vector<FillSegment> &segs)
+{
+    const size_t rows = sheet.num_rows;
+    std::unordered_map<size_t, NumericColumn> numeric;
+    std::vector<RowMask> masks(segs.size());
+    std::vector<size_t> valid(segs.size(), rows);
+    std::vector<size_t> conds; // indices of ifcol segments
+    bool literal_branches = true;
+
+    for (size_t i = 0; i < segs.size(); ++i)
+    {
+        const FillSegment &seg = segs[i];
+        if (seg.kind == FillSegment::Kind::Col) literal_branches = false;
+        if (seg.kind != FillSegment::Kind::IfCol) continue;
+        masks[i] = eval_condition(sheet, seg, rows, numeric);
+        valid[i] = condition_rows(sheet, seg, rows);
+        if (seg.if_true.is_col || seg.if_false.is_col || valid[i] < rows) literal_branches = false;
+        conds.push_back(i);
+    }
+
+    // only literal text and literal branches: every row is one of 2^k strings,
+    // so fill the true/false branches in bulk as a dictionary column
+    if (literal_branches && !conds.empty() && conds.size() <= kMaxBulkConditions)
+    {
+        std::vector<uint32_t> codes(rows, 0);
+        for (size_t k = 0; k < conds.size(); ++k)
+        {
+            const RowMask &m = masks[conds[k]];
+            for (size_t r = 0; r < rows; ++r)
+                codes[r] |= uint32_t(mask_test(m, r)) << k;
+        }
+
+        std::unordered_map<std::string, uint32_t> seen;
+        std::vector<uint32_t> remap(size_t(1) << conds.size());
+        std::vector<std::string> dict;
+        for (size_t combo = 0; combo < remap.size(); ++combo)
+        {
+            std::string s;
+            for (size_t i = 0, k = 0; i < segs.size(); ++i)
+            {
+                if (segs[i].kind == FillSegment::Kind::Literal) { s += segs[i].text; continue; }
+                s += ((combo >> k++) & 1) ? segs[i].if_true.text : segs[i].if_false.text;
+            }
+            auto it = seen.emplace(s, static_cast<uint32_t>(dict.size())).first;
+            if (it->second == dict.size()) dict.push_back(std::move(s));
+            remap[combo] = it->second;
+        }
+        for (auto &code : codes) code = remap[code];
+        col.assign_dict(std::move(codes), std::move(dict));
+        return;
+    }
+
+    // general case: assemble each selected row (rows outside the selection are dead)
+    std::vector<std::string> out(rows);
+    const size_t logical_rows = sheet.row_count();
+    for (size_t li = 0; li < logical_rows; ++li)
+    {
+        const size_t r = sheet.row_at(li);
+        std::string &cell = out[r];
+        for (size_t i = 0; i < segs.size(); ++i)
+        {
+            const FillSegment &seg = segs[i];
+            switch (seg.kind)
+            {
+                case FillSegment::Kind::Literal:
+                    cell += seg.text;
+                    break;
+                case FillSegment::Kind::Col:
+                    if (seg.col < sheet.cols.size() && r < sheet.cols[seg.col].size())
+                        cell += sheet.cols[seg.col].at(r);
+                    break;
+                case FillSegment::Kind::IfCol:
+                    if (r >= valid[i]) cell += seg.text;
+                    else append_operand(cell, sheet, mask_test(masks[i], r) ? seg.if_true : seg.if_false, r);
+                    break;
+            }
+        }
+    }
+    col.assign(std::move(out));
+}
+
+} // namespace
+
+static inline uint64_t mix64(uint64_t x) // splitmix64 finalizer
+{
+    x ^= x >> 30; x *= 0xbf58476d1ce4e5b9ULL;
+    x ^= x >> 27; x *= 0x94d049bb133111ebULL;
+    return x ^ (x >> 31);
+}
+
 // ----------------------
 // Fill a NitroSheet column
 // ----------------------
@@ -14,7 +272,8 @@ void fill_column_nitro(
     const std::uint32_t first_data_row,    // 1-based first row of data
     const size_t col_index,           // 0-based column index in sheet.cols
     const std::string &fill_with,
-    const std::string &new_header = ""
+    const std::string &new_header,
+    const FillClock &clock
 )
 {
     if (col_index >= sheet.cols.size())
@@ -29,163 +288,60 @@ void fill_column_nitro(
     if (data_start >= total_rows) return;
 
     Column &col = sheet.cols[col_index];
-    // Ensure column has enough rows
-    if (col.vals.size() < sheet.num_rows)
-        col.vals.resize(sheet.num_rows);
 
     const std::string prefix = "firestore-random-past-date-n-year-";
 
-    for (size_t r = 0; r < total_rows; ++r)
+    if (fill_with == "firestore-now")
     {
-        if (fill_with == "firestore-now") // now
-        {
-            col.vals[r] = "__fire_ts_now__";
-        }
-        else if (fill_with.compare(0, prefix.size(), prefix) == 0) // random past date
-        {
-            std::string years_part = fill_with.substr(prefix.size());
-            std::optional<uint32_t> n_years;
-
-            try {
-                n_years = std::stoul(years_part);
-            }
-            catch (...) {
-                std::cerr << "WARNING: Could not parse N years: " << fill_with << "\n";
-            }
-
-            std::string ts = random_past_utc_date_within_n_years(n_years);
-            col.vals[r] = "{ \"__fire_ts_from_date__\": \"" + ts + "\" }";
-        }
-        else if (str_contains_at_least_one_placeholder(fill_with))
-        {
-            auto placeholders = scan_placeholders(fill_with);
-
-            // start with the base string
-            col.vals[r] = fill_with;
-
-            for (auto &p : placeholders)
-            {
-                std::string replacement;
-
-                if (p.key.rfind("col ", 0) == 0) // key starts with "col "
-                {
-                    // simple column reference
-                    std::string col_letters = p.key.substr(4);
-                    size_t ref_col_index = col_to_index(col_letters);
-
-                    if (ref_col_index < sheet.cols.size() && r < sheet.cols[ref_col_index].vals.size())
-                        replacement = sheet.cols[ref_col_index].vals[r];
-                }
-                else if (p.key.rfind("ifcol ", 0) == 0)
-                {
-                    std::string expr = p.key.substr(6); // remove "ifcol "
-
-                    auto trim = [](std::string s) -> std::string {
-                        size_t start = s.find_first_not_of(" \t");
-                        size_t end = s.find_last_not_of(" \t");
-                        if (start == std::string::npos) return "";
-                        return s.substr(start, end - start + 1);
-                    };
-
-                    auto extract_quoted = [&](const std::string &s) -> std::string {
-                        std::string t = trim(s);
-                        if ((t.front() == '\'' && t.back() == '\'') || (t.front() == '"' && t.back() == '"'))
-                            return t.substr(1, t.size() - 2);
-                        return t;
-                    };
-
-                    // find ? and :
-                    size_t qmark_pos = expr.find("?");
-                    size_t colon_pos = expr.find(":");
-                    if (qmark_pos == std::string::npos || colon_pos == std::string::npos) continue;
-
-                    std::string cond_part = trim(expr.substr(0, qmark_pos));
-                    std::string true_result  = extract_quoted(expr.substr(qmark_pos + 1, colon_pos - (qmark_pos + 1)));
-                    std::string false_result = extract_quoted(expr.substr(colon_pos + 1));
-
-                    // parse condition: <col_letters> <op> <value>
-                    std::string col_letters, op, value;
-                    {
-                        std::istringstream iss(cond_part);
-                        if (!(iss >> col_letters >> op)) continue;
-                        std::getline(iss, value);
-                        value = trim(value);
-                        value = extract_quoted(value);
-                    }
-
-                    size_t ref_col_index = col_to_index(col_letters);
-                    if (ref_col_index >= sheet.cols.size() || r >= sheet.cols[ref_col_index].vals.size()) continue;
-                    const std::string &cell_val = sheet.cols[ref_col_index].vals[r];
-
-                    // comparison
-                    bool condition = false;
-
-                    auto is_number = [](const std::string &s) -> bool {
-                        if (s.empty()) return false;
-                        char* endptr = nullptr;
-                        strtod(s.c_str(), &endptr);
-                        return (*endptr == 0);
-                    };
-
-                    // numeric comparison if both sides are numbers
-                    if (is_number(cell_val) && is_number(value))
-                    {
-                        double lhs = std::stod(cell_val);
-                        double rhs = std::stod(value);
-
-                        if (op == "==") condition = lhs == rhs;
-                        else if (op == "!=") condition = lhs != rhs;
-                        else if (op == ">")  condition = lhs > rhs;
-                        else if (op == "<")  condition = lhs < rhs;
-                        else if (op == ">=") condition = lhs >= rhs;
-                        else if (op == "<=") condition = lhs <= rhs;
-                    }
-                    else
-                    {
-                        // string comparison only supports == and !=
-                        if (op == "==") condition = cell_val == value;
-                        else if (op == "!=") condition = cell_val != value;
-                    }
-
-                    // resolve true_result / false_result if they reference columns
-                    auto resolve_result = [&](const std::string &res) -> std::string {
-                        std::string s = trim(res);
-                        if (s.rfind("col ", 0) == 0)
-                        {
-                            size_t tcol_index = col_to_index(s.substr(4));
-                            if (tcol_index < sheet.cols.size() && r < sheet.cols[tcol_index].vals.size())
-                                return sheet.cols[tcol_index].vals[r];
-                            else
-                                return "";
-                        }
-                        return s;
-                    };
-
-                    replacement = condition ? resolve_result(true_result) : resolve_result(false_result);
-                }
-
+        col.assign_timestamps(std::vector<int64_t>(total_rows, kFirestoreNow));
+        if (!new_header.empty() && hdr < total_rows) col.header = new_header;
+        return;
+    }
 
+    // constant fill: a one-entry dictionary column, no per-row strings
+    if (fill_with.compare(0, prefix.size(), prefix) != 0 && !str_contains_at_least_one_placeholder(fill_with))
+    {
+        col.assign_constant(total_rows, fill_with);
+        if (!new_header.empty() && hdr < total_rows) col.header = new_header;
+        return;
+    }
 
-                // replace placeholder in current cell
-                std::string full = "${" + p.key + "}";
-                size_t pos = 0;
-                while ((pos = col.vals[r].find(full, pos)) != std::string::npos)
-                {
-                    col.vals[r].replace(pos, full.size(), replacement);
-                    pos += replacement.size();
-                }
-            }
+    if (fill_with.compare(0, prefix.size(), prefix) != 0) // placeholders
+    {
+        const std::vector<FillSegment> segs = compile_fill_template(fill_with);
 
-        }
+        // pure copy of another column ("${col H}"): share its cells copy-on-write
+        if (segs.size() == 1 && segs[0].kind == FillSegment::Kind::Col &&
+            segs[0].col < sheet.cols.size() && sheet.cols[segs[0].col].size() == total_rows)
+            col.alias(sheet.cols[segs[0].col]);
         else
-        {
-            col.vals[r] = fill_with;
-        }
+            fill_from_template(sheet, col, segs);
+
+        if (!new_header.empty() && hdr < total_rows) col.header = new_header;
+        return;
     }
 
-    
+    // random past date: a timestamp column, formatted only at export
+    std::string years_part = fill_with.substr(prefix.size());
+    uint32_t n_years = 1;
+    int64_t parsed = 0;
+    if (parse_plain_integer(years_part, parsed) && parsed >= 0 && parsed <= 10000)
+        n_years = static_cast<uint32_t>(parsed);
+    else
+        std::cerr << "WARNING: Could not parse N years: " << fill_with << "\n";
+
+    // logical row i draws counter i of this column's stream, so a seeded run
+    // gives the same dates however the rows are split across threads
+    const uint64_t stream = mix64(clock.seed ^ mix64(col_index + 1));
+    std::vector<int64_t> ts(total_rows, clock.now);
+    parallel_for_chunks(sheet.row_count(), [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i)
+            ts[sheet.row_at(i)] = random_past_epoch(stream, i, n_years, clock.now);
+    });
+    col.assign_timestamps(std::move(ts));
+
     // Update header
-    if (!new_header.empty() && hdr < col.vals.size())
+    if (!new_header.empty() && hdr < total_rows)
     {
         col.header = new_header;
     }
@@ -200,7 +356,8 @@ void add_column_nitro(
     const uint32_t first_data_row,
     const std::string &at,          // "end", "beginning"/"start", or column letters
     const std::string &fill_with,
-    const std::string &new_header
+    const std::string &new_header,
+    const FillClock &clock
 )
 {
     const size_t total_rows = sheet.num_rows;
@@ -219,8 +376,7 @@ void add_column_nitro(
     // ----------------------
     // Insert a new column at insert_at
     // ----------------------
-    Column new_col;
-    new_col.vals.resize(total_rows, ""); // empty column
+    Column new_col("", std::vector<std::string>(total_rows)); // empty column
 
     if (insert_at >= sheet.cols.size())
     {
@@ -237,7 +393,7 @@ void add_column_nitro(
     // ----------------------
     // Fill the new column
     // ----------------------
-    fill_column_nitro(sheet, header_row, first_data_row, insert_at, fill_with, new_header);
+    fill_column_nitro(sheet, header_row, first_data_row, insert_at, fill_with, new_header, clock);
 }
 
 // ----------------------
@@ -272,94 +428,228 @@ void split_simple(const std::string &s, char delim, std::vector<std::string> &ou
     out_parts.emplace_back(s.substr(start));
 }
 
-// Robust Nitro splitter
-// Universal Nitro splitter with per-row normalization
-void split_column_nitro(
-    NitroSheet &sheet,
-    const std::uint32_t /*header_row*/,
-    const std::uint32_t /*first_data_row*/,
-    const std::size_t col_index,
-    const char delimiter,
-    const std::vector<size_t> &target_col_indices,
-    const std::vector<std::string> &new_headers = {},
-    const std::vector<std::uint32_t> &proper_positions = {}
-)
+// ----------------------
+// Row kernels shared by the standalone ops and the fused row pipeline
+// ----------------------
+
+// scratch reused across rows so splitting doesn't allocate per row
+struct SplitScratch {
+    std::vector<std::string> parts;
+    std::vector<std::string> normalized;
+};
+
+// ensure all target columns exist with storage for every row. Only the
+// targets are written: the source may be read concurrently by another step,
+// so a short source is read as blank past its end instead of padded.
+static bool split_prepare(NitroSheet &sheet, size_t col_index, const std::vector<size_t> &target_col_indices)
 {
-    if (sheet.num_rows == 0 || col_index >= sheet.cols.size()) return;
+    if (sheet.num_rows == 0 || col_index >= sheet.cols.size() || target_col_indices.empty()) return false;
 
-    // ensure all target columns exist
-    size_t max_target = col_index;
-    for (size_t idx : target_col_indices)
-        if (idx > max_target) max_target = idx;
+    const size_t max_target = *std::max_element(target_col_indices.begin(), target_col_indices.end());
     if (max_target >= sheet.cols.size()) sheet.cols.resize(max_target + 1);
-    for (size_t t = 0; t <= max_target; ++t)
-        if (sheet.cols[t].vals.size() < sheet.num_rows)
-            sheet.cols[t].vals.resize(sheet.num_rows);
+    for (size_t idx : target_col_indices)
+        if (sheet.cols[idx].size() < sheet.num_rows)
+            sheet.cols[idx].vals_mut().resize(sheet.num_rows);
+    return true;
+}
 
-    Column &src = sheet.cols[col_index];
-    if (src.vals.size() < sheet.num_rows)
-        src.vals.resize(sheet.num_rows);
+// split one value into scratch.normalized (one slot per target, before proper_positions)
+static void split_value(const std::string &cell_value, char delimiter, size_t T, SplitScratch &scratch)
+{
+    std::vector<std::string> &normalized = scratch.normalized;
+    normalized.assign(T, std::string());
+    if (cell_value.empty()) return;
 
-    std::vector<std::string> parts;
-    parts.reserve(8);
+    // split the value
+    std::vector<std::string> &parts = scratch.parts;
+    split_simple(cell_value, delimiter, parts);
+    size_t N = parts.size();
 
-    const size_t T = target_col_indices.size();
+    // ---- universal per-row normalization ----
+    if (N >= 1) normalized[0] = parts[0];             // first column = first part
+    if (N >= 2) normalized[T-1] = parts[N-1];         // last column = last part
 
-    for (size_t r = 0; r < sheet.num_rows; ++r)
+    // fill middle columns (1..T-2), missing middle parts stay empty
+    for (size_t i = 1; i + 1 < T; ++i)
     {
-        const std::string &cell_value = src.vals[r];
+        if (i < N-1)
+            normalized[i] = parts[i];
+    }
+    // ----------------------------------------
+}
 
-        if (cell_value.empty())
-        {
-            for (size_t tcol : target_col_indices)
-                sheet.cols[tcol].vals[r] = "";
-            continue;
-        }
+// value for target i, using proper_positions if provided
+static const std::string &split_output(size_t i, const std::vector<std::uint32_t> &proper_positions, const SplitScratch &scratch)
+{
+    static const std::string none;
+    size_t pos = (!proper_positions.empty()) ? proper_positions[i] : (i + 1);
+    return (pos > 0 && pos <= scratch.normalized.size()) ? scratch.normalized[pos - 1] : none;
+}
 
-        // split the value
-        split_simple(cell_value, delimiter, parts);
-        size_t N = parts.size();
+// cell storage of every split target, detached once before the row loop
+static std::vector<std::vector<std::string> *> split_targets(NitroSheet &sheet, const std::vector<size_t> &target_col_indices)
+{
+    std::vector<std::vector<std::string> *> targets;
+    targets.reserve(target_col_indices.size());
+    for (size_t idx : target_col_indices)
+        targets.push_back(&sheet.cols[idx].vals_mut());
+    return targets;
+}
 
-        // ---- universal per-row normalization ----
-        std::vector<std::string> normalized(T, "");
+static void split_row(
+    const NitroSheet &sheet,
+    size_t r,
+    size_t col_index,
+    char delimiter,
+    const std::vector<std::vector<std::string> *> &targets,
+    const std::vector<std::uint32_t> &proper_positions,
+    SplitScratch &scratch
+)
+{
+    static const std::string blank;
+    const Column &src = sheet.cols[col_index];
+    const size_t T = targets.size();
+    split_value(r < src.size() ? src.at(r) : blank, delimiter, T, scratch);
+
+    // assign values to target columns
+    for (size_t i = 0; i < T; ++i)
+        (*targets[i])[r] = split_output(i, proper_positions, scratch);
+}
 
-        if (N >= 1) normalized[0] = parts[0];             // first column = first part
-        if (N >= 2) normalized[T-1] = parts[N-1];         // last column = last part
+// Dictionary source: split each distinct value once and write the targets as
+// dictionary columns (codes mapped through a per-entry table).
+static void split_dict_column(
+    NitroSheet &sheet,
+    size_t col_index,
+    char delimiter,
+    const std::vector<size_t> &target_col_indices,
+    const std::vector<std::uint32_t> &proper_positions
+)
+{
+    const Column &src = sheet.cols[col_index];
+    const std::vector<std::string> &src_dict = src.dict();
+    const size_t T = target_col_indices.size();
 
-        // fill middle columns (1..T-2)
-        for (size_t i = 1; i < T-1; ++i)
-        {
-            if (i < N-1)
-                normalized[i] = parts[i];
-            else
-                normalized[i] = ""; // pad missing middle parts
-        }
-        // ----------------------------------------
+    // target_code[i][e] = code in target i's dictionary for source entry e
+    std::vector<std::vector<uint32_t>> target_code(T, std::vector<uint32_t>(src_dict.size()));
+    std::vector<std::vector<std::string>> target_dict(T);
+    std::vector<std::unordered_map<std::string, uint32_t>> target_index(T);
 
-        // assign values to target columns using proper_positions if provided
+    SplitScratch scratch;
+    for (size_t e = 0; e < src_dict.size(); ++e)
+    {
+        split_value(src_dict[e], delimiter, T, scratch);
         for (size_t i = 0; i < T; ++i)
         {
-            size_t pos = (!proper_positions.empty()) ? proper_positions[i] : (i + 1);
+            const std::string &out = split_output(i, proper_positions, scratch);
+            auto it = target_index[i].emplace(out, static_cast<uint32_t>(target_dict[i].size())).first;
+            if (it->second == target_dict[i].size()) target_dict[i].push_back(out);
+            target_code[i][e] = it->second;
+        }
+    }
 
-            std::string out_value = "";
+    // copy the source codes before any target (possibly the source itself) is replaced
+    const std::vector<uint32_t> src_codes = src.codes();
 
-            if (pos > 0 && pos <= normalized.size())
-                out_value = normalized[pos - 1];
+    for (size_t i = 0; i < T; ++i)
+    {
+        std::vector<uint32_t> codes(src_codes.size());
+        for (size_t r = 0; r < src_codes.size(); ++r)
+            codes[r] = target_code[i][src_codes[r]];
+        sheet.cols[target_col_indices[i]].assign_dict(std::move(codes), std::move(target_dict[i]));
+    }
+}
 
-            sheet.cols[target_col_indices[i]].vals[r] = out_value;
-        }
+static void split_set_headers(
+    NitroSheet &sheet,
+    const std::vector<size_t> &target_col_indices,
+    const std::vector<std::string> &new_headers
+)
+{
+    if (new_headers.empty()) return;
+
+    for (size_t i = 0; i < target_col_indices.size(); ++i)
+    {
+        size_t tcol = target_col_indices[i];
+        if (tcol >= sheet.cols.size()) continue;
+        sheet.cols[tcol].header = (i < new_headers.size()) ? new_headers[i] : "";
     }
+}
 
-    // set headers if provided
-    if (!new_headers.empty())
+static inline void uppercase_cell(std::string &val)
+{
+    if (!val.empty())
+        std::transform(val.begin(), val.end(), val.begin(), ::toupper);
+}
+
+// helper trim function
+static inline void trim_inplace(std::string &s)
+{
+    auto not_space = [](unsigned char c){ return !std::isspace(c); };
+
+    // trim left
+    s.erase(s.begin(), std::find_if(s.begin(), s.end(), not_space));
+
+    // trim right
+    s.erase(std::find_if(s.rbegin(), s.rend(), not_space).base(), s.end());
+}
+
+static inline void replace_cell(std::string &val, const std::string &find, const std::string &repl)
+{
+    if (val.empty()) return;
+
+    // 🧹 trim before replace
+    trim_inplace(val);
+    if (val.empty()) return;
+
+    size_t pos = 0;
+    while ((pos = val.find(find, pos)) != std::string::npos)
     {
-        for (size_t i = 0; i < T; ++i)
-        {
-            size_t tcol = target_col_indices[i];
-            if (tcol >= sheet.cols.size()) continue;
-            sheet.cols[tcol].header = (i < new_headers.size()) ? new_headers[i] : "";
-        }
+        val.replace(pos, find.size(), repl);
+        pos += repl.size();
+    }
+}
+
+// Robust Nitro splitter
+// Universal Nitro splitter with per-row normalization
+void split_column_nitro(
+    NitroSheet &sheet,
+    const std::uint32_t /*header_row*/,
+    const std::uint32_t /*first_data_row*/,
+    const std::size_t col_index,
+    const char delimiter,
+    const std::vector<size_t> &target_col_indices,
+    const std::vector<std::string> &new_headers = {},
+    const std::vector<std::uint32_t> &proper_positions = {}
+)
+{
+    if (sheet.num_rows == 0 || col_index >= sheet.cols.size() || target_col_indices.empty()) return;
+
+    if (sheet.cols[col_index].is_dict() && sheet.cols[col_index].size() == sheet.num_rows)
+    {
+        size_t max_target = *std::max_element(target_col_indices.begin(), target_col_indices.end());
+        if (max_target >= sheet.cols.size()) sheet.cols.resize(max_target + 1);
+
+        split_dict_column(sheet, col_index, delimiter, target_col_indices, proper_positions);
+    }
+    else
+    {
+        if (!split_prepare(sheet, col_index, target_col_indices)) return;
+
+        const auto targets = split_targets(sheet, target_col_indices);
+        SplitScratch scratch;
+        scratch.parts.reserve(8);
+
+        for (size_t i = 0; i < sheet.row_count(); ++i)
+            split_row(sheet, sheet.row_at(i), col_index, delimiter, targets, proper_positions, scratch);
+
+        // split parts (codes, sizes, colors...) are usually low-cardinality
+        for (size_t tcol : target_col_indices)
+            sheet.cols[tcol].dict_encode();
     }
+
+    // set headers if provided
+    split_set_headers(sheet, target_col_indices, new_headers);
 }
 
 
@@ -373,28 +663,19 @@ void uppercase_column_nitro(
     if (total_rows == 0 || col_index >= sheet.cols.size())
         return;
 
-    size_t data_start = (first_data_row > 0 ? first_data_row - 1 : 1);
-
     Column &col = sheet.cols[col_index];
 
-    for (size_t r = 0; r < total_rows; ++r)
+    // dictionary column: once per distinct value
+    if (col.is_dict())
     {
-        std::string &val = col.vals[r];
-        if (!val.empty())
-            std::transform(val.begin(), val.end(), val.begin(), ::toupper);
+        col.transform_dict(uppercase_cell);
+        return;
     }
-}
 
-// helper trim function
-static inline void trim_inplace(std::string &s)
-{
-    auto not_space = [](unsigned char c){ return !std::isspace(c); };
+    std::vector<std::string> &vals = col.vals_mut();
 
-    // trim left
-    s.erase(s.begin(), std::find_if(s.begin(), s.end(), not_space));
-
-    // trim right
-    s.erase(std::find_if(s.rbegin(), s.rend(), not_space).base(), s.end());
+    for (size_t i = 0; i < sheet.row_count(); ++i)
+        uppercase_cell(vals[sheet.row_at(i)]);
 }
 
 // ----------------------
@@ -416,126 +697,260 @@ void replace_in_column_nitro(
 
     Column &col = sheet.cols[col_index];
 
-    for (size_t r = data_start; r < total_rows; ++r)
+    // dictionary column: once per distinct value; rows before data_start keep their value
+    if (col.is_dict())
     {
-        std::string &val = col.vals[r];
-        if (val.empty()) continue;
+        std::vector<std::pair<size_t, std::string>> kept;
+        for (size_t i = 0; i < data_start && i < sheet.row_count(); ++i)
+            kept.emplace_back(sheet.row_at(i), col.at(sheet.row_at(i)));
 
-        // 🧹 trim before replace
-        trim_inplace(val);
-        if (val.empty()) continue;
+        col.transform_dict([&](std::string &val) { replace_cell(val, find, repl); });
 
-        size_t pos = 0;
-        while ((pos = val.find(find, pos)) != std::string::npos)
-        {
-            val.replace(pos, find.size(), repl);
-            pos += repl.size();
-        }
+        for (auto &k : kept)
+            col.set(k.first, k.second);
+        return;
     }
+
+    std::vector<std::string> &vals = col.vals_mut();
+
+    for (size_t i = data_start; i < sheet.row_count(); ++i)
+        replace_cell(vals[sheet.row_at(i)], find, repl);
 }
 
 // ----------------------
-// Apply transformations to a NitroSheet row
+// Regex replace: the pattern is compiled once; cells without the pattern's
+// required literal are skipped before the matcher runs
 // ----------------------
-void transform_row_nitro(
+void regex_replace_in_column_nitro(
     NitroSheet &sheet,
-    const std::size_t row_index,
-    const std::string &to,
-    std::optional<char> delim
+    const std::uint32_t first_data_row,
+    const std::size_t col_index,
+    const std::string &pattern,
+    const std::string &repl
+)
+{
+    // throws on bad syntax before touching the sheet
+    regex_replace_in_column_nitro(sheet, first_data_row, col_index, LinearRegex(pattern), repl);
+}
+
+void regex_replace_in_column_nitro(
+    NitroSheet &sheet,
+    const std::uint32_t first_data_row,
+    const std::size_t col_index,
+    const LinearRegex &re,
+    const std::string &repl
 )
 {
-    if (sheet.cols.empty() || row_index >= sheet.num_rows)
+    const size_t total_rows = sheet.num_rows;
+    if (total_rows == 0 || col_index >= sheet.cols.size())
         return;
 
-    for (size_t col = 0; col < sheet.cols.size(); ++col)
+    size_t data_start = (first_data_row > 0 ? first_data_row - 1 : 1);
+
+    Column &col = sheet.cols[col_index];
+
+    // dictionary column: once per distinct value; rows before data_start keep their value
+    if (col.is_dict())
     {
-        Column &column = sheet.cols[col];
+        std::vector<std::pair<size_t, std::string>> kept;
+        for (size_t i = 0; i < data_start && i < sheet.row_count(); ++i)
+            kept.emplace_back(sheet.row_at(i), col.at(sheet.row_at(i)));
+
+        RegexScratch scratch;
+        std::string out;
+        col.transform_dict([&](std::string &val) {
+            if (re.replace_all(val, repl, out, scratch)) val.swap(out);
+        });
 
-        // Ensure this column has storage for all rows
-        if (column.vals.size() < sheet.num_rows)
-            column.vals.resize(sheet.num_rows);
+        for (auto &k : kept)
+            col.set(k.first, k.second);
+        return;
+    }
 
-        // Now it's safe
-        std::string &val = column.vals[row_index];
-        if (val.empty()) continue;
+    std::vector<std::string> &vals = col.vals_mut();
+    const size_t logical_rows = sheet.row_count();
+    if (data_start >= logical_rows)
+        return;
 
-        if (to == "camelCase")
-        {
-            if (!delim) continue;
-            val = to_camel(val, *delim);
-        }
-        else if (to == "PascalCase")
+    parallel_for_chunks(logical_rows - data_start, [&](size_t begin, size_t end) {
+        RegexScratch scratch; // one per thread
+        std::string out;
+        for (size_t i = data_start + begin; i < data_start + end; ++i)
         {
-            if (!delim) continue;
-            val = to_pascal(val, *delim);
+            std::string &val = vals[sheet.row_at(i)];
+            if (re.replace_all(val, repl, out, scratch)) val.swap(out);
         }
-        else if (to == "snake_case")
-        {
-            val = to_snake(val);
-        }
-        else if (to == "upper")
-        {
-            std::transform(val.begin(), val.end(), val.begin(), ::toupper);
-        }
-        else if (to == "lower")
+    }, 4096);
+}
+
+// ----------------------
+// Fused row pipeline: every stage is row-local, so running all stages on
+// row r before moving to r+1 gives the same result as running them one
+// after another, with a single walk over the rows.
+// ----------------------
+bool row_stages_fusable(const NitroSheet &sheet, const std::vector<RowStage> &stages)
+{
+    std::vector<size_t> split_written;
+    for (const RowStage &st : stages)
+    {
+        if (st.col_index < sheet.cols.size() && sheet.cols[st.col_index].is_dict()) return false;
+        if (std::find(split_written.begin(), split_written.end(), st.col_index) != split_written.end()) return false;
+        if (st.kind == RowStage::Kind::Split)
+            split_written.insert(split_written.end(), st.target_col_indices.begin(), st.target_col_indices.end());
+    }
+    return true;
+}
+
+void run_row_stages_nitro(
+    NitroSheet &sheet,
+    const std::vector<RowStage> &stages
+)
+{
+    const size_t total_rows = sheet.num_rows;
+    if (total_rows == 0 || stages.empty())
+        return;
+
+    // per-stage setup, in stage order (a split may create a later stage's column)
+    std::vector<bool> active(stages.size(), false);
+    std::vector<size_t> row_start(stages.size(), 0);
+
+    for (size_t i = 0; i < stages.size(); ++i)
+    {
+        const RowStage &st = stages[i];
+        switch (st.kind)
         {
-            std::transform(val.begin(), val.end(), val.begin(), ::tolower);
+        case RowStage::Kind::Split:
+            active[i] = split_prepare(sheet, st.col_index, st.target_col_indices);
+            break;
+        case RowStage::Kind::Uppercase:
+            active[i] = st.col_index < sheet.cols.size();
+            break;
+        case RowStage::Kind::Replace:
+            active[i] = st.col_index < sheet.cols.size() && !st.find.empty();
+            row_start[i] = (st.first_data_row > 0 ? st.first_data_row - 1 : 1);
+            break;
         }
+    }
+
+    // write targets of every stage, detached once before the row loop
+    std::vector<std::vector<std::vector<std::string> *>> target(stages.size());
+    for (size_t i = 0; i < stages.size(); ++i)
+    {
+        if (!active[i]) continue;
+        if (stages[i].kind == RowStage::Kind::Split)
+            target[i] = split_targets(sheet, stages[i].target_col_indices);
         else
+            target[i] = { &sheet.cols[stages[i].col_index].vals_mut() };
+    }
+
+    SplitScratch scratch;
+    scratch.parts.reserve(8);
+
+    const size_t logical_rows = sheet.row_count();
+
+    for (size_t row = 0; row < logical_rows; ++row)
+    {
+        const size_t r = sheet.row_at(row);
+
+        for (size_t i = 0; i < stages.size(); ++i)
         {
-            throw std::runtime_error("Unknown transform: " + to);
+            if (!active[i] || row < row_start[i]) continue;
+
+            const RowStage &st = stages[i];
+            switch (st.kind)
+            {
+            case RowStage::Kind::Split:
+                split_row(sheet, r, st.col_index, st.delimiter, target[i], st.proper_positions, scratch);
+                break;
+            case RowStage::Kind::Uppercase:
+                uppercase_cell((*target[i][0])[r]);
+                break;
+            case RowStage::Kind::Replace:
+                replace_cell((*target[i][0])[r], st.find, st.repl);
+                break;
+            }
         }
     }
+
+    for (size_t i = 0; i < stages.size(); ++i)
+    {
+        if (!active[i] || stages[i].kind != RowStage::Kind::Split) continue;
+
+        for (size_t tcol : stages[i].target_col_indices)
+            sheet.cols[tcol].dict_encode();
+        split_set_headers(sheet, stages[i].target_col_indices, stages[i].new_headers);
+    }
+}
+
+// ----------------------
+// Apply transformations to a NitroSheet row
+// ----------------------
+void transform_row_nitro(
+    NitroSheet &sheet,
+    const std::size_t row_index,
+    CaseStyle to,
+    std::optional<char> delim
+)
+{
+    if (sheet.cols.empty() || row_index >= sheet.row_count())
+        return;
+
+    // camel/Pascal need a delimiter; without one the row is left as is
+    if (!delim && (to == CaseStyle::Camel || to == CaseStyle::Pascal))
+        return;
+
+    const size_t r = sheet.row_at(row_index);
+    const char d = delim.value_or(0);
+    const CaseKernel kernel = case_kernel_for(to, d);
+    std::string out; // reused for every cell
+
+    for (size_t col = 0; col < sheet.cols.size(); ++col)
+    {
+        Column &column = sheet.cols[col];
+
+        // Ensure this column has storage for all rows
+        if (column.size() < sheet.num_rows)
+            column.vals_mut().resize(sheet.num_rows);
+
+        // only detach shared columns that actually change
+        const std::string &val = column.at(r);
+        if (val.empty()) continue;
+
+        kernel(val, d, out);
+        if (out != val) column.set(r, out);
+    }
 }
 
 
 void transform_header_nitro(
     NitroSheet &sheet,
-    const std::string &to,           // "camelCase", "PascalCase", "snake_case", "upper", "lower"
+    CaseStyle to,
     std::optional<char> delim
 )
 {
     if (sheet.cols.empty())
         return;
 
+    if (!delim && (to == CaseStyle::Camel || to == CaseStyle::Pascal))
+        return;
+
+    const char d = delim.value_or(0);
+    const CaseKernel kernel = case_kernel_for(to, d);
+    std::string out;
+
     for (size_t col = 0; col < sheet.cols.size(); ++col)
     {
         Column &column = sheet.cols[col];
 
         // Ensure this column has storage for all rows
-        if (column.vals.size() < sheet.num_rows)
-            column.vals.resize(sheet.num_rows);
+        if (column.size() < sheet.num_rows)
+            column.vals_mut().resize(sheet.num_rows);
 
-        // Now it's safe
         std::string &val = column.header;
         if (val.empty()) continue;
 
-        if (to == "camelCase")
-        {
-            if (!delim) continue;
-            val = to_camel(val, *delim);
-        }
-        else if (to == "PascalCase")
-        {
-            if (!delim) continue;
-            val = to_pascal(val, *delim);
-        }
-        else if (to == "snake_case")
-        {
-            val = to_snake(val);
-        }
-        else if (to == "upper")
-        {
-            std::transform(val.begin(), val.end(), val.begin(), ::toupper);
-        }
-        else if (to == "lower")
-        {
-            std::transform(val.begin(), val.end(), val.begin(), ::tolower);
-        }
-        else
-        {
-            throw std::runtime_error("Unknown transform header: " + to);
-        }
+        kernel(val, d, out);
+        val.swap(out);
     }
 }
 
@@ -566,41 +981,22 @@ void group_collect_nitro(
         return;
 
     std::string current_key;
-    std::vector<std::vector<std::string>> collected(collect_cols.size());
     std::vector<std::vector<double>> math_values(do_maths_cols.size());
 
-    std::vector<bool> keep_row(sheet.num_rows, true);
+    const size_t logical_rows = sheet.row_count();
+    std::vector<uint32_t> kept_rows; // physical row of each group's first row, in order
     std::size_t first_row_index = 0;
 
+    // collected items of every group, back to back; group g owns
+    // items[ci][group_end[ci][g - 1] .. group_end[ci][g])
+    std::vector<std::vector<std::string>> items(collect_cols.size());
+    std::vector<std::vector<uint32_t>> group_end(collect_cols.size());
+    std::vector<std::vector<std::pair<uint32_t, std::string>>> math_results(do_maths_cols.size());
+
     auto flush_group = [&](size_t first_row)
     {
-        // --- Build JSON array for each collected/output column ---
         for (size_t ci = 0; ci < collect_cols.size(); ++ci)
-        {
-            std::string json = "[";
-            bool first_item = true;
-            for (size_t i = 0; i < collected[ci].size(); ++i)
-            {
-                if (marked_unique)
-                {
-                    bool exists = false;
-                    for (size_t j = 0; j < i; ++j)
-                        if (collected[ci][j] == collected[ci][i]) { exists = true; break; }
-                    if (exists) continue;
-                }
-
-                if (!first_item) json += ",";
-                if (collected[ci][i].find('{') != std::string::npos ||
-                    collected[ci][i].find('[') != std::string::npos)
-                    json += collected[ci][i];
-                else
-                    json += "\"" + collected[ci][i] + "\"";
-
-                first_item = false;
-            }
-            json += "]";
-            sheet.cols[output_cols[ci]].vals[first_row] = json;
-        }
+            group_end[ci].push_back(static_cast<uint32_t>(items[ci].size()));
 
         // --- Perform Maths Operations for each do_maths_col ---
         for (size_t mi = 0; mi < do_maths_cols.size(); ++mi)
@@ -636,113 +1032,260 @@ void group_collect_nitro(
                 throw std::runtime_error("Unknown maths operation: " + op);
             }
 
-            sheet.cols[do_maths_cols[mi]].vals[first_row] = std::to_string(result);
+            math_results[mi].emplace_back(static_cast<uint32_t>(first_row), format_number(result));
         }
     };
 
-    // Pass 1: collect values + mark duplicate rows for deletion
-    for (std::size_t r = 0; r < sheet.num_rows; ++r)
+    // dictionary group column: compare codes instead of strings (safe as long
+    // as this op doesn't write the group column itself)
+    const Column &group = sheet.cols[group_col];
+    const bool by_code = group.is_dict()
+        && std::find(output_cols.begin(), output_cols.end(), group_col) == output_cols.end()
+        && std::find(do_maths_cols.begin(), do_maths_cols.end(), group_col) == do_maths_cols.end();
+    uint32_t current_code = 0;
+
+    // empty cells are skipped via the validity bitmaps (cells are only written after pass 1)
+    std::vector<const std::vector<uint64_t> *> collect_valid, math_valid;
+    for (size_t c : collect_cols) collect_valid.push_back(&sheet.cols[c].validity());
+    for (size_t c : do_maths_cols) math_valid.push_back(&sheet.cols[c].validity());
+
+    // Pass 1: collect values; only the first row of each group is kept
+    for (std::size_t i = 0; i < logical_rows; ++i)
     {
-        const std::string &key = sheet.cols[group_col].vals[r];
+        const std::size_t r = sheet.row_at(i); // physical row
 
-        if (r == 0 || key != current_key)
+        bool new_group;
+        if (by_code)
         {
-            if (r != 0) flush_group(first_row_index);
+            const uint32_t code = group.codes()[r];
+            new_group = i == 0 || code != current_code;
+            current_code = code;
+        }
+        else
+        {
+            const std::string &key = group.at(r);
+            new_group = i == 0 || key != current_key;
+            if (new_group) current_key = key;
+        }
+
+        if (new_group)
+        {
+            if (i != 0) flush_group(first_row_index);
 
-            current_key = key;
             first_row_index = r;
+            kept_rows.push_back(static_cast<uint32_t>(r));
 
-            // clear collected and math values
-            for (auto &v : collected) v.clear();
             for (auto &v : math_values) v.clear();
         }
-        else
-        {
-            keep_row[r] = false; // duplicate row
-        }
 
         // collect values for all collect_cols
         for (size_t ci = 0; ci < collect_cols.size(); ++ci)
         {
-            const std::string &val = sheet.cols[collect_cols[ci]].vals[r];
-            if (!val.empty()) collected[ci].push_back(val);
+            if (!((*collect_valid[ci])[r >> 6] >> (r & 63) & 1)) continue; // empty cell
+            const std::string &val = sheet.cols[collect_cols[ci]].at(r);
+
+            std::vector<std::string> &group_items = items[ci];
+            if (marked_unique)
+            {
+                const size_t begin = group_end[ci].empty() ? 0 : group_end[ci].back();
+                if (std::find(group_items.begin() + begin, group_items.end(), val) != group_items.end())
+                    continue;
+            }
+            group_items.push_back(val);
         }
 
         // collect numeric values for math operations
         for (size_t mi = 0; mi < do_maths_cols.size(); ++mi)
         {
-            const std::string &math_val_str = sheet.cols[do_maths_cols[mi]].vals[r];
-            if (!math_val_str.empty())
-            {
-                try { math_values[mi].push_back(std::stod(math_val_str)); } catch (...) {}
-            }
+            if (!((*math_valid[mi])[r >> 6] >> (r & 63) & 1)) continue; // empty cell
+            double x;
+            if (parse_number(sheet.cols[do_maths_cols[mi]].at(r), x)) math_values[mi].push_back(x);
         }
     }
 
     // Final flush
-    if (!collected.empty())
+    if (logical_rows > 0)
         flush_group(first_row_index);
 
-    // Pass 2: physically remove duplicate rows
-    size_t write_index = 0;
-    for (size_t r = 0; r < sheet.num_rows; ++r)
+    // Store each output column as list cells: a group's first row holds its
+    // items, every other physical row an empty list (those rows are dropped below)
+    for (size_t ci = 0; ci < collect_cols.size(); ++ci)
     {
-        if (keep_row[r])
+        std::vector<uint32_t> offsets(static_cast<size_t>(sheet.num_rows) + 1, 0);
+        for (size_t g = 0; g < kept_rows.size(); ++g)
         {
-            if (write_index != r)
-            {
-                for (auto &col : sheet.cols)
-                    col.vals[write_index] = std::move(col.vals[r]);
-            }
-            write_index++;
+            const uint32_t begin = g == 0 ? 0 : group_end[ci][g - 1];
+            offsets[kept_rows[g] + 1] = group_end[ci][g] - begin;
         }
+        for (size_t r = 0; r < sheet.num_rows; ++r) offsets[r + 1] += offsets[r];
+
+        std::vector<std::string> list_items(items[ci].size());
+        for (size_t g = 0; g < kept_rows.size(); ++g)
+        {
+            const uint32_t begin = g == 0 ? 0 : group_end[ci][g - 1];
+            std::move(items[ci].begin() + begin, items[ci].begin() + group_end[ci][g],
+                      list_items.begin() + offsets[kept_rows[g]]);
+        }
+        items[ci] = {};
+
+        sheet.cols[output_cols[ci]].assign_list(std::move(offsets), std::move(list_items));
     }
 
-    for (auto &col : sheet.cols)
-        col.vals.resize(write_index);
+    for (size_t mi = 0; mi < do_maths_cols.size(); ++mi)
+    {
+        if (math_results[mi].empty()) continue;
+        std::vector<std::string> &vals = sheet.cols[do_maths_cols[mi]].vals_mut();
+        for (auto &[row, value] : math_results[mi]) vals[row] = std::move(value);
+    }
 
-    sheet.num_rows = write_index;
+    // Pass 2: drop the grouped rows from the selection (cells stay where they are)
+    set_row_selection(sheet, std::move(kept_rows));
 }
 
 
+SortAs sort_as_from_string(const std::string &s)
+{
+    if (s == "string") return SortAs::String;
+    if (s == "number") return SortAs::Number;
+    if (s == "date")   return SortAs::Date;
+
+    throw std::runtime_error("Unknown sort-as: " + s + " (expected number, date or string)");
+}
+
+// packed sort key: parsed value next to its (logical) row, so the comparator never touches strings
+template <typename K>
+struct PackedKey {
+    K key;
+    uint32_t row;
+};
+
+// Sort rows by key_of(physical_row, key); rows without a key keep their
+// relative order and go last regardless of direction.
+template <typename K, typename KeyOf>
+static std::vector<uint32_t> sorted_rows_by_key(const NitroSheet &sheet, bool ascending, KeyOf key_of)
+{
+    const size_t total_rows = sheet.row_count();
+    std::vector<PackedKey<K>> keys;
+    keys.reserve(total_rows);
+    std::vector<uint32_t> unparsed;
+
+    for (size_t i = 0; i < total_rows; ++i)
+    {
+        const uint32_t r = static_cast<uint32_t>(sheet.row_at(i));
+        K k;
+        if (key_of(r, k))
+            keys.push_back({ k, static_cast<uint32_t>(i) });
+        else
+            unparsed.push_back(r);
+    }
+
+    // ties broken by current logical position -> stable order
+    if (ascending)
+        std::sort(keys.begin(), keys.end(), [](const PackedKey<K> &a, const PackedKey<K> &b) {
+            return a.key < b.key || (a.key == b.key && a.row < b.row);
+        });
+    else
+        std::sort(keys.begin(), keys.end(), [](const PackedKey<K> &a, const PackedKey<K> &b) {
+            return a.key > b.key || (a.key == b.key && a.row < b.row);
+        });
+
+    std::vector<uint32_t> rows;
+    rows.reserve(total_rows);
+    for (const auto &k : keys) rows.push_back(static_cast<uint32_t>(sheet.row_at(k.row)));
+    rows.insert(rows.end(), unparsed.begin(), unparsed.end());
+    return rows;
+}
+
+// key_of for a dictionary column: parse every entry once, rows look their code up
+template <typename K, typename Parse>
+static auto dict_key_of(const std::vector<std::string> &dict, const std::vector<uint32_t> &codes, Parse parse)
+{
+    std::vector<K> entry_key(dict.size());
+    std::vector<char> entry_ok(dict.size());
+    for (size_t e = 0; e < dict.size(); ++e)
+        entry_ok[e] = parse(dict[e], entry_key[e]);
+
+    return [&codes, entry_key = std::move(entry_key), entry_ok = std::move(entry_ok)](size_t r, K &k) {
+        const uint32_t code = codes[r];
+        k = entry_key[code];
+        return entry_ok[code] != 0;
+    };
+}
+
 void sort_rows_by_column_nitro(
     NitroSheet &sheet,
     const std::size_t col_index,
-    const bool ascending
+    const bool ascending,
+    const SortAs sort_as
 )
 {
     if (sheet.cols.empty() || col_index >= sheet.cols.size())
         return;
 
-    const size_t total_rows = sheet.num_rows;
+    const size_t total_rows = sheet.row_count();
     if (total_rows == 0)
         return;
 
-    // Create index vector
-    std::vector<size_t> indices(total_rows);
-    for (size_t i = 0; i < total_rows; ++i)
-        indices[i] = i;
+    const Column &col = sheet.cols[col_index];
+    std::vector<uint32_t> rows; // physical rows in sorted order
 
-    // Sort indices based on the target column's values
-    Column &col = sheet.cols[col_index];
-    std::sort(indices.begin(), indices.end(),
-        [&](size_t a, size_t b) {
-            if (ascending)
-                return col.vals[a] < col.vals[b];
-            else
-                return col.vals[a] > col.vals[b];
-        });
+    auto parse_num = [](const std::string &s, double &k) { return parse_number(s, k) && k == k; }; // NaN can't be ordered
+    auto parse_date = [](const std::string &s, int64_t &k) { return parse_datetime_epoch(s, k); };
 
-    // Reorder all columns based on sorted indices
-    for (auto &column : sheet.cols)
+    if (col.is_dict())
     {
-        std::vector<std::string> sorted_vals(total_rows);
-        for (size_t i = 0; i < total_rows; ++i)
+        // one key per dictionary entry; rows only look their code up
+        const std::vector<std::string> &dict = col.dict();
+        const std::vector<uint32_t> &codes = col.codes();
+
+        if (sort_as == SortAs::Number)
+            rows = sorted_rows_by_key<double>(sheet, ascending, dict_key_of<double>(dict, codes, parse_num));
+        else if (sort_as == SortAs::Date)
+            rows = sorted_rows_by_key<int64_t>(sheet, ascending, dict_key_of<int64_t>(dict, codes, parse_date));
+        else
         {
-            sorted_vals[i] = std::move(column.vals[indices[i]]);
+            // rank of each entry in string order
+            std::vector<uint32_t> order(dict.size());
+            for (uint32_t e = 0; e < order.size(); ++e) order[e] = e;
+            std::sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) { return dict[a] < dict[b]; });
+
+            std::vector<uint32_t> rank(dict.size());
+            for (uint32_t i = 0; i < order.size(); ++i) rank[order[i]] = i;
+
+            rows = sorted_rows_by_key<uint32_t>(sheet, ascending,
+                [&](size_t r, uint32_t &k) { k = rank[codes[r]]; return true; });
         }
-        column.vals = std::move(sorted_vals);
     }
+    else if (sort_as == SortAs::Number)
+    {
+        rows = sorted_rows_by_key<double>(sheet, ascending,
+            [&](size_t r, double &k) { return parse_num(col.at(r), k); });
+    }
+    else if (sort_as == SortAs::Date)
+    {
+        rows = sorted_rows_by_key<int64_t>(sheet, ascending,
+            [&](size_t r, int64_t &k) { return parse_date(col.at(r), k); });
+    }
+    else
+    {
+        // Create index vector of physical rows in current logical order
+        rows.resize(total_rows);
+        for (size_t i = 0; i < total_rows; ++i)
+            rows[i] = static_cast<uint32_t>(sheet.row_at(i));
+
+        // Sort indices based on the target column's values; stable, so ties
+        // keep their logical order as on the dictionary path
+        std::stable_sort(rows.begin(), rows.end(),
+            [&](uint32_t a, uint32_t b) {
+                if (ascending)
+                    return col.at(a) < col.at(b);
+                else
+                    return col.at(a) > col.at(b);
+            });
+    }
+
+    // Only the selection changes; columns are read through it
+    set_row_selection(sheet, std::move(rows));
 }
 
 void reassign_numbering_nitro(
@@ -757,13 +1300,742 @@ void reassign_numbering_nitro(
     if (sheet.cols.empty() || col_index >= sheet.cols.size())
         return;
 
-    Column &col = sheet.cols[col_index];
+    std::vector<std::string> &vals = sheet.cols[col_index].vals_mut();
+    if (vals.size() < sheet.num_rows)
+        vals.resize(sheet.num_rows);
 
     size_t number = start_number;
 
-    for (size_t r = 0; r < sheet.num_rows; ++r)
+    for (size_t i = 0; i < sheet.row_count(); ++i)
     {
-        col.vals[r] = prefix + std::to_string(number) + suffix;
+        vals[sheet.row_at(i)] = prefix + std::to_string(number) + suffix;
         number += step;
     }
-}
\ No newline at end of file
+}
+
+// ----------------------
+// Filter rows: predicates are evaluated a column at a time into row masks,
+// then the selection keeps the matching rows (no cells move)
+// ----------------------
+static bool is_blank(const std::string &s)
+{
+    return s.find_first_not_of(" \t\r\n") == std::string::npos;
+}
+
+static RowMask eval_predicate(const NitroSheet &sheet, const RowPredicate &p, size_t rows,
+                              std::unordered_map<size_t, NumericColumn> &numeric)
+{
+    using Kind = RowPredicate::Kind;
+
+    if (p.kind == Kind::All || p.kind == Kind::Any)
+    {
+        const bool all = p.kind == Kind::All;
+        RowMask acc(mask_words(rows), all ? ~uint64_t(0) : 0);
+        for (const auto &child : p.children)
+        {
+            RowMask m = eval_predicate(sheet, child, rows, numeric);
+            for (size_t w = 0; w < acc.size(); ++w) acc[w] = all ? (acc[w] & m[w]) : (acc[w] | m[w]);
+        }
+        return acc;
+    }
+
+    auto test = [&](const std::string &cell) -> bool {
+        switch (p.kind)
+        {
+            case Kind::Equals:    return cell == p.value;
+            case Kind::NotEquals: return cell != p.value;
+            case Kind::Contains:  return cell.find(p.value) != std::string::npos;
+            case Kind::IsEmpty:   return is_blank(cell) == p.empty;
+            case Kind::Range:
+            {
+                double x = 0.0;
+                return parse_number(cell, x) && (!p.min || x >= *p.min) && (!p.max || x <= *p.max);
+            }
+            default: return false;
+        }
+    };
+
+    // a missing column reads as blank cells
+    if (p.col_index >= sheet.cols.size())
+        return RowMask(mask_words(rows), test("") ? ~uint64_t(0) : 0);
+
+    const Column &col = sheet.cols[p.col_index];
+    if (p.kind != Kind::Range || col.is_dict())
+        return eval_cell_test(col, rows, test);
+
+    // numeric range over a plain column: parse once, then compare 64 rows per word
+    const size_t n = std::min(rows, col.size());
+    const NumericColumn &nc = numeric_column(col, p.col_index, n, numeric);
+    const double lo = p.min ? *p.min : -std::numeric_limits<double>::infinity();
+    const double hi = p.max ? *p.max : std::numeric_limits<double>::infinity();
+    RowMask out(mask_words(rows), 0);
+    for (size_t w = 0; w < nc.is_num.size(); ++w)
+    {
+        const size_t base = w * 64;
+        const size_t len = std::min<size_t>(64, n - base);
+        const double *x = nc.v.data() + base;
+        uint64_t bits = 0;
+        for (size_t j = 0; j < len; ++j)
+            bits |= uint64_t((x[j] >= lo) & (x[j] <= hi)) << j;
+        out[w] = bits & nc.is_num[w];
+    }
+    return out;
+}
+
+void filter_rows_nitro(
+    NitroSheet &sheet,
+    const RowPredicate &where
+)
+{
+    const size_t logical_rows = sheet.row_count();
+    if (logical_rows == 0) return;
+
+    std::unordered_map<size_t, NumericColumn> numeric;
+    const RowMask keep = eval_predicate(sheet, where, sheet.num_rows, numeric);
+
+    std::vector<uint32_t> rows;
+    rows.reserve(logical_rows);
+    for (size_t i = 0; i < logical_rows; ++i)
+    {
+        const size_t r = sheet.row_at(i);
+        if (mask_test(keep, r)) rows.push_back(static_cast<uint32_t>(r));
+    }
+
+    if (rows.size() != logical_rows)
+        set_row_selection(sheet, std::move(rows));
+}
+
+// ----------------------
+// Lookup column: hash join against a reference sheet
+// ----------------------
+OnDuplicate on_duplicate_from_string(const std::string &s)
+{
+    if (s == "first") return OnDuplicate::First;
+    if (s == "last")  return OnDuplicate::Last;
+    if (s == "error") return OnDuplicate::Error;
+    throw std::runtime_error("Unknown on-duplicate: " + s + " (expected first, last or error)");
+}
+
+void lookup_column_nitro(
+    NitroSheet &sheet,
+    const NitroSheet &ref,
+    const std::size_t key_col,
+    const std::size_t ref_key_col,
+    const std::vector<std::size_t> &ref_value_cols,
+    const std::vector<std::size_t> &output_cols,
+    const std::vector<std::string> &new_headers,
+    const OnDuplicate on_duplicate,
+    const std::string &default_value
+)
+{
+    if (ref_value_cols.size() != output_cols.size())
+        throw std::runtime_error("lookup-column: ref-columns and output-columns must have the same length");
+    if (ref_key_col >= ref.cols.size())
+        throw std::runtime_error("lookup-column: reference key column " + index_to_col(ref_key_col) + " does not exist");
+    for (auto c : ref_value_cols)
+        if (c >= ref.cols.size())
+            throw std::runtime_error("lookup-column: reference column " + index_to_col(c) + " does not exist");
+
+    constexpr uint32_t kMiss = std::numeric_limits<uint32_t>::max();
+
+    // ---- build: key -> physical reference row, once ----
+    const Column &ref_keys = ref.cols[ref_key_col];
+    std::unordered_map<std::string_view, uint32_t> index;
+    index.reserve(ref.row_count());
+    for (size_t i = 0; i < ref.row_count(); ++i)
+    {
+        const uint32_t rr = static_cast<uint32_t>(ref.row_at(i));
+        if (rr >= ref_keys.size() || !ref_keys.has_value(rr)) continue; // blank (or missing) cells are not keys
+        const std::string &key = ref_keys.at(rr);
+
+        auto [it, inserted] = index.emplace(key, rr);
+        if (inserted) continue;
+        if (on_duplicate == OnDuplicate::Error)
+            throw std::runtime_error("lookup-column: duplicate key \"" + key + "\" in reference sheet");
+        if (on_duplicate == OnDuplicate::Last) it->second = rr;
+    }
+
+    auto probe = [&](const std::string &key) -> uint32_t {
+        auto it = index.find(key);
+        return it == index.end() ? kMiss : it->second;
+    };
+
+    // ---- probe: matched reference row of every selected row ----
+    const size_t rows = sheet.num_rows;
+    const size_t logical_rows = sheet.row_count();
+    std::vector<uint32_t> match(rows, kMiss);
+
+    if (key_col < sheet.cols.size())
+    {
+        const Column &keys = sheet.cols[key_col];
+        if (keys.is_dict()) // once per entry
+        {
+            std::vector<uint32_t> entry_match(keys.dict().size());
+            for (size_t e = 0; e < entry_match.size(); ++e) entry_match[e] = probe(keys.dict()[e]);
+            const auto &codes = keys.codes();
+            for (size_t i = 0; i < logical_rows; ++i)
+            {
+                const size_t r = sheet.row_at(i);
+                if (r < codes.size()) match[r] = entry_match[codes[r]];
+            }
+        }
+        else
+        {
+            const std::vector<uint64_t> &valid = keys.validity(); // blank keys never match
+            parallel_for_chunks(logical_rows, [&](size_t begin, size_t end) {
+                for (size_t i = begin; i < end; ++i)
+                {
+                    const size_t r = sheet.row_at(i);
+                    if (r < keys.size() && ((valid[r >> 6] >> (r & 63)) & 1)) match[r] = probe(keys.at(r));
+                }
+            });
+        }
+    }
+
+    // ---- gather the value columns ----
+    for (size_t k = 0; k < output_cols.size(); ++k)
+    {
+        const Column &src = ref.cols[ref_value_cols[k]];
+        Column out;
+        out.header = (k < new_headers.size() && !new_headers[k].empty()) ? new_headers[k] : src.header;
+
+        if (src.is_dict()) // reuse the reference dictionary; misses get the default entry
+        {
+            std::vector<std::string> dict = src.dict();
+            auto it = std::find(dict.begin(), dict.end(), default_value);
+            const uint32_t default_code = static_cast<uint32_t>(it - dict.begin());
+            if (it == dict.end()) dict.push_back(default_value);
+
+            std::vector<uint32_t> codes(rows, default_code);
+            const auto &src_codes = src.codes();
+            parallel_for_chunks(logical_rows, [&](size_t begin, size_t end) {
+                for (size_t i = begin; i < end; ++i)
+                {
+                    const size_t r = sheet.row_at(i);
+                    if (match[r] < src_codes.size()) codes[r] = src_codes[match[r]]; // a short column misses
+                }
+            });
+            out.assign_dict(std::move(codes), std::move(dict));
+        }
+        else
+        {
+            std::vector<std::string> vals(rows);
+            parallel_for_chunks(logical_rows, [&](size_t begin, size_t end) {
+                for (size_t i = begin; i < end; ++i)
+                {
+                    const size_t r = sheet.row_at(i);
+                    vals[r] = match[r] < src.size() ? src.at(match[r]) : default_value; // a short column misses
+                }
+            });
+            out.assign(std::move(vals));
+        }
+
+        if (output_cols[k] >= sheet.cols.size())
+            sheet.cols.resize(output_cols[k] + 1);
+        sheet.cols[output_cols[k]] = std::move(out);
+    }
+}
+
+// ----------------------
+// Dedupe rows: hashed row fingerprints + open-addressing tables
+// ----------------------
+// Hashes and compares the cells of a set of key columns in one row
+// (physical row indices). Dictionary columns hash each entry once and
+// compare codes. A cell past the end of a short column is blank.
+struct RowKeys
+{
+    std::vector<const Column *> cols;
+    std::vector<std::vector<uint64_t>> entry_hash;
+
+    RowKeys(const NitroSheet &sheet, const std::vector<std::size_t> &key_cols) // empty = all columns
+    {
+        if (key_cols.empty())
+            for (const auto &c : sheet.cols) cols.push_back(&c);
+        else
+            for (auto c : key_cols)
+            {
+                if (c >= sheet.cols.size())
+                    throw std::runtime_error("key column " + index_to_col(c) + " does not exist");
+                cols.push_back(&sheet.cols[c]);
+            }
+
+        entry_hash.resize(cols.size());
+        for (size_t k = 0; k < cols.size(); ++k)
+            if (cols[k]->is_dict())
+                for (const auto &e : cols[k]->dict())
+                    entry_hash[k].push_back(std::hash<std::string_view>{}(e));
+    }
+
+    static const std::string &cell(const Column &col, size_t r)
+    {
+        static const std::string blank;
+        return r < col.size() ? col.at(r) : blank;
+    }
+
+    uint64_t hash(size_t r) const
+    {
+        uint64_t h = 0x9e3779b97f4a7c15ULL;
+        for (size_t k = 0; k < cols.size(); ++k)
+        {
+            const Column &col = *cols[k];
+            const uint64_t c = col.is_dict() && r < col.size() ? entry_hash[k][col.codes()[r]]
+                                                               : std::hash<std::string_view>{}(cell(col, r));
+            h = mix64(h ^ c);
+        }
+        return h;
+    }
+
+    bool equal(size_t a, size_t b) const
+    {
+        for (const Column *col : cols)
+        {
+            if (col->is_dict() && a < col->size() && b < col->size())
+            {
+                if (col->codes()[a] != col->codes()[b]) return false;
+            }
+            else if (cell(*col, a) != cell(*col, b))
+                return false;
+        }
+        return true;
+    }
+};
+
+void dedupe_rows_nitro(
+    NitroSheet &sheet,
+    const std::vector<std::size_t> &key_cols
+)
+{
+    for (auto c : key_cols)
+        if (c >= sheet.cols.size())
+            throw std::runtime_error("dedupe-rows: key column " + index_to_col(c) + " does not exist");
+
+    const size_t n = sheet.row_count();
+    if (n < 2) return;
+
+    const RowKeys keys(sheet, key_cols);
+
+    // ---- 1. fingerprint every logical row ----
+    std::vector<uint64_t> fp(n);
+    parallel_for_chunks(n, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) fp[i] = keys.hash(sheet.row_at(i));
+    });
+
+    // ---- 2. keep the first row of each fingerprint ----
+    // Rows are split into partitions by the top fingerprint bits; each partition
+    // owns a preallocated open-addressing table and scans rows in order, so the
+    // first occurrence wins no matter how partitions are scheduled.
+    const unsigned part_bits = n >= 65536 ? 6 : 0;
+    const size_t parts = size_t(1) << part_bits;
+    auto part_of = [&](uint64_t h) { return part_bits ? size_t(h >> (64 - part_bits)) : 0; };
+
+    // bucket the logical rows by partition in one pass, keeping row order
+    std::vector<uint32_t> offset(parts + 1, 0);
+    for (size_t i = 0; i < n; ++i) ++offset[part_of(fp[i]) + 1];
+    for (size_t p = 0; p < parts; ++p) offset[p + 1] += offset[p];
+    std::vector<uint32_t> bucket(n);
+    {
+        std::vector<uint32_t> fill(offset.begin(), offset.end() - 1);
+        for (size_t i = 0; i < n; ++i) bucket[fill[part_of(fp[i])]++] = static_cast<uint32_t>(i);
+    }
+
+    std::vector<uint8_t> keep(n, 0);
+
+    parallel_for_chunks(parts, [&](size_t p_begin, size_t p_end) {
+        for (size_t p = p_begin; p < p_end; ++p)
+        {
+            const size_t count = offset[p + 1] - offset[p];
+
+            size_t cap = 16;
+            while (cap < count * 2) cap <<= 1;
+            constexpr uint32_t kEmpty = std::numeric_limits<uint32_t>::max();
+            std::vector<uint32_t> table(cap, kEmpty); // logical row of each kept representative
+
+            for (size_t b = offset[p]; b < offset[p + 1]; ++b)
+            {
+                const size_t i = bucket[b];
+                size_t slot = fp[i] & (cap - 1);
+                while (true)
+                {
+                    const uint32_t j = table[slot];
+                    if (j == kEmpty) { table[slot] = static_cast<uint32_t>(i); keep[i] = 1; break; }
+                    if (fp[j] == fp[i] && keys.equal(sheet.row_at(j), sheet.row_at(i))) break; // duplicate
+                    slot = (slot + 1) & (cap - 1);
+                }
+            }
+        }
+    }, 1);
+
+    // ---- 3. shrink the selection ----
+    std::vector<uint32_t> rows;
+    rows.reserve(n);
+    for (size_t i = 0; i < n; ++i)
+        if (keep[i]) rows.push_back(static_cast<uint32_t>(sheet.row_at(i)));
+
+    if (rows.size() != n)
+        set_row_selection(sheet, std::move(rows));
+}
+
+// Group id of every logical row by its key cells, numbered in order of first
+// appearance; group_rows gets the physical row that opened each group.
+static void assign_row_groups(
+    const NitroSheet &sheet,
+    const std::vector<std::size_t> &key_cols,
+    std::vector<uint32_t> &group_of,
+    std::vector<uint32_t> &group_rows
+)
+{
+    constexpr uint32_t kNone = std::numeric_limits<uint32_t>::max();
+    const size_t n = sheet.row_count();
+    const RowKeys keys(sheet, key_cols);
+
+    std::vector<uint64_t> fp(n);
+    parallel_for_chunks(n, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) fp[i] = keys.hash(sheet.row_at(i));
+    });
+
+    group_of.assign(n, 0);
+    group_rows.clear();
+    std::vector<uint64_t> group_fp; // fingerprint of each group, checked before keys.equal
+
+    size_t cap = 16;
+    while (cap < n * 2) cap <<= 1;
+    std::vector<uint32_t> table(cap, kNone); // group ids
+    for (size_t i = 0; i < n; ++i)
+    {
+        const size_t r = sheet.row_at(i);
+        size_t slot = fp[i] & (cap - 1);
+        while (true)
+        {
+            const uint32_t g = table[slot];
+            if (g == kNone)
+            {
+                table[slot] = static_cast<uint32_t>(group_rows.size());
+                group_rows.push_back(static_cast<uint32_t>(r));
+                group_fp.push_back(fp[i]);
+                group_of[i] = table[slot];
+                break;
+            }
+            if (group_fp[g] == fp[i] && keys.equal(group_rows[g], r)) { group_of[i] = g; break; }
+            slot = (slot + 1) & (cap - 1);
+        }
+    }
+}
+
+// ----------------------
+// Pivot: hash aggregation into a dense groups x pivot-values matrix
+// ----------------------
+PivotAggregate pivot_aggregate_from_string(const std::string &s)
+{
+    if (s == "sum")   return PivotAggregate::Sum;
+    if (s == "count") return PivotAggregate::Count;
+    if (s == "min")   return PivotAggregate::Min;
+    if (s == "max")   return PivotAggregate::Max;
+    if (s == "avg")   return PivotAggregate::Avg;
+    if (s == "first") return PivotAggregate::First;
+    throw std::runtime_error("Unknown pivot aggregate: " + s + " (expected sum, count, min, max, avg or first)");
+}
+
+constexpr size_t kMaxPivotCells = size_t(1) << 28;
+constexpr const char *kBlankPivotHeader = "(blank)"; // header of the column for blank pivot cells
+
+void pivot_nitro(
+    NitroSheet &sheet,
+    const std::vector<std::size_t> &row_key_cols,
+    const std::size_t pivot_col,
+    const std::size_t value_col,
+    const PivotAggregate aggregate,
+    const std::string &fill_empty
+)
+{
+    if (row_key_cols.empty())
+        throw std::runtime_error("pivot: row-keys must name at least one column");
+    for (auto c : row_key_cols)
+        if (c >= sheet.cols.size())
+            throw std::runtime_error("pivot: row key column " + index_to_col(c) + " does not exist");
+    if (pivot_col >= sheet.cols.size() || value_col >= sheet.cols.size())
+        throw std::runtime_error("pivot: pivot or value column does not exist");
+
+    constexpr uint32_t kNone = std::numeric_limits<uint32_t>::max();
+    const size_t n = sheet.row_count();
+
+    // ---- 1. group id of every row (first appearance order) ----
+    std::vector<uint32_t> group_of;
+    std::vector<uint32_t> group_rows; // physical row of each group's first row
+    assign_row_groups(sheet, row_key_cols, group_of, group_rows);
+
+    // ---- 2. pivot value id of every row, discovered in the same order ----
+    // (cells past the end of a short pivot column are blank)
+    const Column &pcol = sheet.cols[pivot_col];
+    std::vector<uint32_t> pivot_of(n);
+    std::vector<std::string> pivot_names;
+    static const std::string blank;
+    if (pcol.is_dict())
+    {
+        std::vector<uint32_t> by_code(pcol.dict().size() + 1, kNone); // last slot: missing cells
+        for (size_t i = 0; i < n; ++i)
+        {
+            const size_t r = sheet.row_at(i);
+            uint32_t &p = by_code[r < pcol.size() ? pcol.codes()[r] : pcol.dict().size()];
+            if (p == kNone)
+            {
+                p = static_cast<uint32_t>(pivot_names.size());
+                pivot_names.push_back(r < pcol.size() ? pcol.at(r) : blank);
+            }
+            pivot_of[i] = p;
+        }
+    }
+    else
+    {
+        std::unordered_map<std::string_view, uint32_t> by_value;
+        for (size_t i = 0; i < n; ++i)
+        {
+            const size_t r = sheet.row_at(i);
+            const std::string &v = r < pcol.size() ? pcol.at(r) : blank;
+            auto [it, inserted] = by_value.emplace(v, static_cast<uint32_t>(pivot_names.size()));
+            if (inserted) pivot_names.push_back(v);
+            pivot_of[i] = it->second;
+        }
+    }
+
+    // a blank pivot value still needs a header (CSV rejects empty ones); if
+    // "(blank)" is itself a pivot value, the two columns share the name
+    for (auto &name : pivot_names)
+        if (name.empty()) name = kBlankPivotHeader;
+
+    const size_t groups = group_rows.size();
+    const size_t pivots = pivot_names.size();
+    if (groups * pivots > kMaxPivotCells)
+        throw std::runtime_error("pivot: " + std::to_string(groups) + " rows x " + std::to_string(pivots)
+                                 + " pivot values is too large");
+
+    // ---- 3. parse the values once (per entry for dictionary columns) ----
+    const Column &vcol = sheet.cols[value_col];
+    const bool numeric = aggregate != PivotAggregate::Count && aggregate != PivotAggregate::First;
+    std::vector<double> value(numeric ? n : 0);
+    std::vector<uint8_t> is_num(numeric ? n : 0);
+    if (numeric)
+    {
+        std::vector<double> entry_val;
+        std::vector<uint8_t> entry_ok;
+        if (vcol.is_dict())
+        {
+            entry_val.resize(vcol.dict().size());
+            entry_ok.resize(vcol.dict().size());
+            for (size_t e = 0; e < entry_val.size(); ++e) entry_ok[e] = parse_number(vcol.dict()[e], entry_val[e]);
+        }
+        parallel_for_chunks(n, [&](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; ++i)
+            {
+                const size_t r = sheet.row_at(i);
+                if (r >= vcol.size()) continue;
+                if (vcol.is_dict()) { value[i] = entry_val[vcol.codes()[r]]; is_num[i] = entry_ok[vcol.codes()[r]]; }
+                else is_num[i] = parse_number(vcol.at(r), value[i]);
+            }
+        });
+    }
+
+    // ---- 4. aggregate into the dense matrix (cell = group * pivots + pivot) ----
+    std::vector<double> acc(numeric ? groups * pivots : 0);
+    std::vector<uint32_t> count(groups * pivots, 0);
+    std::vector<uint32_t> first(aggregate == PivotAggregate::First ? groups * pivots : 0, kNone);
+
+    for (size_t i = 0; i < n; ++i)
+    {
+        const size_t cell = size_t(group_of[i]) * pivots + pivot_of[i];
+        switch (aggregate)
+        {
+            case PivotAggregate::Count:
+                count[cell]++;
+                break;
+            case PivotAggregate::First:
+                if (first[cell] == kNone) first[cell] = static_cast<uint32_t>(sheet.row_at(i));
+                count[cell]++;
+                break;
+            default:
+            {
+                if (!is_num[i]) break;
+                const double v = value[i];
+                if (count[cell] == 0) acc[cell] = v;
+                else if (aggregate == PivotAggregate::Min) acc[cell] = std::min(acc[cell], v);
+                else if (aggregate == PivotAggregate::Max) acc[cell] = std::max(acc[cell], v);
+                else acc[cell] += v;
+                count[cell]++;
+            }
+        }
+    }
+
+    // ---- 5. write the result: key columns, then one column per pivot value ----
+    std::vector<Column> out;
+    out.reserve(row_key_cols.size() + pivots);
+    for (auto c : row_key_cols)
+    {
+        const Column &src = sheet.cols[c];
+        const bool short_col = std::any_of(group_rows.begin(), group_rows.end(), [&](uint32_t r) { return r >= src.size(); });
+        if (!short_col)
+        {
+            Column key = src; // shares cells until select_rows detaches
+            key.select_rows(group_rows);
+            out.push_back(std::move(key));
+            continue;
+        }
+
+        // a short key column: missing cells are blank, as RowKeys hashes them
+        std::vector<std::string> vals(groups);
+        for (size_t g = 0; g < groups; ++g)
+        {
+            const uint32_t r = group_rows[g];
+            if (r >= src.size()) continue;
+            if (src.is_list() || src.is_timestamp()) src.append_cell_text(r, vals[g]);
+            else vals[g] = src.at(r);
+        }
+        out.emplace_back(src.header, std::move(vals));
+    }
+
+    // pivot columns are independent: render them in parallel
+    out.resize(row_key_cols.size() + pivots);
+    auto render = [&](size_t p) {
+        std::vector<std::string> vals(groups);
+        for (size_t g = 0; g < groups; ++g)
+        {
+            const size_t cell = g * pivots + p;
+            if (count[cell] == 0) { vals[g] = fill_empty; continue; }
+            switch (aggregate)
+            {
+                case PivotAggregate::Count: vals[g] = std::to_string(count[cell]); break;
+                case PivotAggregate::First: vals[g] = first[cell] < vcol.size() ? vcol.at(first[cell]) : blank; break;
+                case PivotAggregate::Avg:   vals[g] = format_number(acc[cell] / count[cell]); break;
+                default:                    vals[g] = format_number(acc[cell]); break;
+            }
+        }
+        Column &col = out[row_key_cols.size() + p];
+        col = Column(pivot_names[p], std::move(vals));
+        col.dict_encode();
+    };
+    parallel_for_chunks(pivots, [&](size_t begin, size_t end) {
+        for (size_t p = begin; p < end; ++p) render(p);
+    }, 1);
+
+    sheet.cols = std::move(out);
+    sheet.num_rows = static_cast<uint32_t>(groups);
+    sheet.sel.clear();
+    sheet.has_sel = false;
+}
+
+// ----------------------
+// Top-n: partial selection over precomputed sort keys
+// ----------------------
+
+// The k best rows of each group by key_of (same order and tie-breaking as
+// sorted_rows_by_key), groups in order of first appearance. Rows without a
+// key only fill groups that have fewer than k keyed rows.
+template <typename K, typename KeyOf>
+static std::vector<uint32_t> top_rows_by_key(
+    const NitroSheet &sheet, bool ascending, size_t k,
+    const std::vector<uint32_t> &group_of, size_t groups, KeyOf key_of)
+{
+    const size_t n = sheet.row_count();
+
+    // bucket rows by group; logical order is kept inside each bucket
+    std::vector<size_t> offset(groups + 1, 0);
+    for (size_t i = 0; i < n; ++i) offset[group_of[i] + 1]++;
+    for (size_t g = 0; g < groups; ++g) offset[g + 1] += offset[g];
+
+    std::vector<PackedKey<K>> keyed(n);
+    std::vector<uint32_t> unkeyed(n);
+    std::vector<size_t> keyed_end(offset.begin(), offset.end() - 1);
+    std::vector<size_t> unkeyed_end(offset.begin(), offset.end() - 1);
+
+    for (size_t i = 0; i < n; ++i)
+    {
+        const uint32_t g = group_of[i];
+        const uint32_t r = static_cast<uint32_t>(sheet.row_at(i));
+        K key;
+        if (key_of(r, key)) keyed[keyed_end[g]++] = { key, static_cast<uint32_t>(i) };
+        else unkeyed[unkeyed_end[g]++] = r;
+    }
+
+    auto better = [ascending](const PackedKey<K> &a, const PackedKey<K> &b) {
+        if (a.key == b.key) return a.row < b.row; // stable
+        return ascending ? a.key < b.key : a.key > b.key;
+    };
+
+    std::vector<uint32_t> rows;
+    rows.reserve(std::min(n, k * groups));
+    for (size_t g = 0; g < groups; ++g)
+    {
+        auto first = keyed.begin() + offset[g];
+        auto last = keyed.begin() + keyed_end[g];
+        const size_t take = std::min<size_t>(k, last - first);
+
+        if (take < static_cast<size_t>(last - first))
+            std::nth_element(first, first + take, last, better);
+        std::sort(first, first + take, better);
+        for (auto it = first; it != first + take; ++it)
+            rows.push_back(static_cast<uint32_t>(sheet.row_at(it->row)));
+
+        for (size_t u = offset[g]; u < unkeyed_end[g] && u - offset[g] + take < k; ++u)
+            rows.push_back(unkeyed[u]);
+    }
+    return rows;
+}
+
+void top_n_nitro(
+    NitroSheet &sheet,
+    const std::size_t col_index,
+    const std::size_t count,
+    const bool ascending,
+    const SortAs sort_as,
+    const std::vector<std::size_t> &group_cols
+)
+{
+    if (col_index >= sheet.cols.size())
+        throw std::runtime_error("top-n: column " + index_to_col(col_index) + " does not exist");
+    if (sheet.row_count() == 0)
+        return;
+
+    std::vector<uint32_t> group_of(sheet.row_count(), 0);
+    std::vector<uint32_t> group_rows(1, 0);
+    if (!group_cols.empty())
+        assign_row_groups(sheet, group_cols, group_of, group_rows);
+    const size_t groups = group_rows.size();
+
+    const Column &col = sheet.cols[col_index];
+    std::vector<uint32_t> rows;
+
+    auto parse_num = [](const std::string &s, double &k) { return parse_number(s, k) && k == k; };
+    auto parse_date = [](const std::string &s, int64_t &k) { return parse_datetime_epoch(s, k); };
+
+    if (col.is_dict())
+    {
+        const std::vector<std::string> &dict = col.dict();
+        const std::vector<uint32_t> &codes = col.codes();
+
+        if (sort_as == SortAs::Number)
+            rows = top_rows_by_key<double>(sheet, ascending, count, group_of, groups, dict_key_of<double>(dict, codes, parse_num));
+        else if (sort_as == SortAs::Date)
+            rows = top_rows_by_key<int64_t>(sheet, ascending, count, group_of, groups, dict_key_of<int64_t>(dict, codes, parse_date));
+        else
+        {
+            std::vector<uint32_t> order(dict.size());
+            for (uint32_t e = 0; e < order.size(); ++e) order[e] = e;
+            std::sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) { return dict[a] < dict[b]; });
+
+            std::vector<uint32_t> rank(dict.size());
+            for (uint32_t i = 0; i < order.size(); ++i) rank[order[i]] = i;
+
+            rows = top_rows_by_key<uint32_t>(sheet, ascending, count, group_of, groups,
+                [&](size_t r, uint32_t &k) { k = rank[codes[r]]; return true; });
+        }
+    }
+    else if (sort_as == SortAs::Number)
+        rows = top_rows_by_key<double>(sheet, ascending, count, group_of, groups,
+            [&](size_t r, double &k) { return r < col.size() && parse_num(col.at(r), k); });
+    else if (sort_as == SortAs::Date)
+        rows = top_rows_by_key<int64_t>(sheet, ascending, count, group_of, groups,
+            [&](size_t r, int64_t &k) { return r < col.size() && parse_date(col.at(r), k); });
+    else
+        rows = top_rows_by_key<std::string_view>(sheet, ascending, count, group_of, groups,
+            [&](size_t r, std::string_view &k) { if (r >= col.size()) return false; k = col.at(r); return true; });
+
+    set_row_selection(sheet, std::move(rows));
+}
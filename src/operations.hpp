@@ -4,13 +4,28 @@
 #include <optional>
 #include "nitro_sheet.hpp"
 
+class LinearRegex;
+
+// "now" and random seed shared by every firestore-* fill of a run; a fixed
+// seed (and now) regenerates identical timestamps regardless of thread count.
+// Only a value left out is taken from the system clock or random_device.
+struct FillClock
+{
+    explicit FillClock(std::optional<std::int64_t> now = std::nullopt, std::optional<std::uint64_t> seed = std::nullopt)
+        : now(now ? *now : epoch_seconds_now()), seed(seed ? *seed : random_seed()) {}
+
+    std::int64_t now;   // epoch seconds
+    std::uint64_t seed;
+};
+
 void fill_column_nitro(
     NitroSheet &sheet,
     const std::uint32_t header_row,        // 1-based Excel row
     const std::uint32_t first_data_row,    // 1-based first row of data
     const std::size_t col_index,           // 0-based column index in sheet.cols
     const std::string &fill_with,
-    const std::string &new_header
+    const std::string &new_header,
+    const FillClock &clock = FillClock()
 );
 
 void add_column_nitro(
@@ -19,7 +34,8 @@ void add_column_nitro(
     const std::uint32_t first_data_row,
     const std::string &at,          // "end", "beginning"/"start", or column letters
     const std::string &fill_with,
-    const std::string &new_header
+    const std::string &new_header,
+    const FillClock &clock = FillClock()
 );
 
 void remove_column_nitro(
@@ -52,16 +68,67 @@ void replace_in_column_nitro(
     const std::string &repl
 );
 
+// like replace_in_column_nitro, but `pattern` is a regular expression (see
+// utils/linear_regex.hpp) and `repl` may refer to groups as $0..$9
+void regex_replace_in_column_nitro(
+    NitroSheet &sheet,
+    const std::uint32_t first_data_row,  // 1-based row index
+    const std::size_t col_index,         // 0-based column index
+    const std::string &pattern,
+    const std::string &repl
+);
+
+// the same with an already compiled pattern
+void regex_replace_in_column_nitro(
+    NitroSheet &sheet,
+    const std::uint32_t first_data_row,
+    const std::size_t col_index,
+    const LinearRegex &re,
+    const std::string &repl
+);
+
+// A row-local operation: it only reads and writes cells of the row it is
+// given, so consecutive stages can be fused into one pass over the rows.
+struct RowStage
+{
+    enum class Kind { Split, Uppercase, Replace };
+
+    Kind kind;
+    std::size_t col_index = 0;
+    std::uint32_t first_data_row = 2;
+
+    // split
+    char delimiter = '-';
+    std::vector<size_t> target_col_indices;
+    std::vector<std::string> new_headers;
+    std::vector<std::uint32_t> proper_positions;
+
+    // replace
+    std::string find;
+    std::string repl;
+};
+
+// false when a stage reads or writes a dictionary column, or one an earlier
+// split writes (the standalone split dictionary-encodes its targets): the
+// standalone ops work once per distinct value there, which no per-row pass
+// can beat
+bool row_stages_fusable(const NitroSheet &sheet, const std::vector<RowStage> &stages);
+
+void run_row_stages_nitro(
+    NitroSheet &sheet,
+    const std::vector<RowStage> &stages  // run per row, in order
+);
+
 void transform_row_nitro(
     NitroSheet &sheet,
     const std::size_t row_index,                // 0-based row index
-    const std::string &to,           // "camelCase", "PascalCase", "snake_case", "upper", "lower"
+    CaseStyle to,                               // see case_style_from_string
     std::optional<char> delim = std::nullopt // optional delimiter for camel/pascal
 );
 
 void transform_header_nitro(
     NitroSheet &sheet,
-    const std::string &to,           // "camelCase", "PascalCase", "snake_case", "upper", "lower"
+    CaseStyle to,                    // see case_style_from_string
     std::optional<char> delim = std::nullopt // optional delimiter for camel/pascal
 );
 
@@ -81,10 +148,27 @@ void group_collect_nitro(
     const std::vector<std::string> &do_maths_operations
 );
 
+// how sort keys are interpreted; keys are parsed once before sorting
+enum class SortAs { String, Number, Date };
+
+SortAs sort_as_from_string(const std::string &s); // "string", "number", "date"
+
 void sort_rows_by_column_nitro(
     NitroSheet &sheet,
     const std::size_t col_index,
-    const bool ascending
+    const bool ascending,
+    const SortAs sort_as = SortAs::String
+);
+
+// keep the `count` best rows by a column (per group when group_cols is
+// given), in sort order; only the selection changes
+void top_n_nitro(
+    NitroSheet &sheet,
+    const std::size_t col_index,
+    const std::size_t count,
+    const bool ascending,                       // false: largest first
+    const SortAs sort_as,
+    const std::vector<std::size_t> &group_cols  // optional 0-based group-by columns
 );
 
 void reassign_numbering_nitro(
@@ -94,4 +178,66 @@ void reassign_numbering_nitro(
     const std::string &suffix,
     const size_t start_number,
     const size_t step
-);
\ No newline at end of file
+);
+
+// a filter-rows predicate on one column, or an all/any group of predicates
+struct RowPredicate
+{
+    enum class Kind { Equals, NotEquals, Range, Contains, IsEmpty, All, Any };
+
+    Kind kind = Kind::All;
+    std::size_t col_index = 0;
+    std::string value;                  // equals, not-equals, contains
+    std::optional<double> min, max;     // range, inclusive; cells that are not numbers never match
+    bool empty = true;                  // is-empty: keep blank (true) or non-blank (false) cells
+    std::vector<RowPredicate> children; // all, any
+};
+
+// keep only the rows matching `where` (the selection shrinks, cells stay in place)
+void filter_rows_nitro(
+    NitroSheet &sheet,
+    const RowPredicate &where
+);
+
+// which reference row wins when a lookup key appears more than once
+enum class OnDuplicate { First, Last, Error };
+
+OnDuplicate on_duplicate_from_string(const std::string &s); // "first", "last", "error"
+
+// hash join: index ref's key column once, then fill output_cols of every
+// selected row with the matching reference row's ref_value_cols
+// (default_value when the key is missing)
+void lookup_column_nitro(
+    NitroSheet &sheet,
+    const NitroSheet &ref,
+    const std::size_t key_col,                        // 0-based key column in sheet
+    const std::size_t ref_key_col,                    // 0-based key column in ref
+    const std::vector<std::size_t> &ref_value_cols,   // 0-based columns copied from ref
+    const std::vector<std::size_t> &output_cols,      // 0-based target columns in sheet
+    const std::vector<std::string> &new_headers,      // optional; defaults to ref's headers
+    const OnDuplicate on_duplicate,
+    const std::string &default_value
+);
+
+// keep the first of each set of rows with equal key cells (all columns when
+// key_cols is empty); duplicates leave the selection, cells stay in place
+void dedupe_rows_nitro(
+    NitroSheet &sheet,
+    const std::vector<std::size_t> &key_cols  // 0-based key columns
+);
+
+enum class PivotAggregate { Sum, Count, Min, Max, Avg, First };
+
+PivotAggregate pivot_aggregate_from_string(const std::string &s); // "sum", "count", "min", "max", "avg", "first"
+
+// reshape to one row per distinct row key with one column per distinct
+// pivot value (in order of first appearance), each cell aggregating the
+// value column of the matching rows; cells with no rows get fill_empty
+void pivot_nitro(
+    NitroSheet &sheet,
+    const std::vector<std::size_t> &row_key_cols,  // 0-based columns kept as row keys
+    const std::size_t pivot_col,                   // 0-based column whose values become columns
+    const std::size_t value_col,                   // 0-based column aggregated into the cells
+    const PivotAggregate aggregate,
+    const std::string &fill_empty
+);
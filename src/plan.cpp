@@ -0,0 +1,1161 @@
+#include "plan.hpp"
+#include <algorithm>
+#include <mutex>
+#include <stdexcept>
+#include "colors.hpp"
+#include "thread_pool.hpp"
+#include "utils/dynamic_placeholder.hpp"
+#include "utils/linear_regex.hpp"
+
+#define FMT_HEADER_ONLY
+#include "fmt/core.h"
+
+namespace {
+
+// ----------------------
+// Field readers: every failure names the field
+// ----------------------
+template <typename T> const char *type_name();
+template <> const char *type_name<std::string>() { return "a string"; }
+template <> const char *type_name<bool>() { return "true or false"; }
+template <> const char *type_name<std::uint32_t>() { return "a non-negative integer"; }
+template <> const char *type_name<std::size_t>() { return "a non-negative integer"; }
+template <> const char *type_name<double>() { return "a number"; }
+
+template <typename T>
+T as_field(const YAML::Node &v, const std::string &key)
+{
+    try { return v.as<T>(); }
+    catch (const YAML::Exception &) { throw std::runtime_error("`" + key + "` must be " + type_name<T>()); }
+}
+
+// a required field
+template <typename T>
+T field(const YAML::Node &node, const std::string &key)
+{
+    const YAML::Node v = node[key];
+    if (!v) throw std::runtime_error("missing `" + key + "`");
+    return as_field<T>(v, key);
+}
+
+// an optional field
+template <typename T>
+T field(const YAML::Node &node, const std::string &key, const T &fallback)
+{
+    const YAML::Node v = node[key];
+    return v ? as_field<T>(v, key) : fallback;
+}
+
+// an optional list field (empty when missing)
+template <typename T>
+std::vector<T> list_field(const YAML::Node &node, const std::string &key)
+{
+    std::vector<T> out;
+    const YAML::Node v = node[key];
+    if (!v) return out;
+    if (!v.IsSequence()) throw std::runtime_error("`" + key + "` must be a list");
+    for (const auto &item : v)
+        out.push_back(as_field<T>(item, key));
+    return out;
+}
+
+std::size_t column_index(const std::string &letters, const std::string &key)
+{
+    bool ok = !letters.empty();
+    for (char c : letters)
+        ok = ok && ((c >= 'A' && c <= 'Z') || (c >= 'a' && c <= 'z'));
+    if (!ok) throw std::runtime_error("`" + key + "`: invalid column letters \"" + letters + "\"");
+    return col_to_index(letters);
+}
+
+std::size_t column_field(const YAML::Node &node, const std::string &key)
+{
+    return column_index(field<std::string>(node, key), key);
+}
+
+std::vector<std::size_t> column_list(const YAML::Node &node, const std::string &key)
+{
+    std::vector<std::size_t> out;
+    for (const auto &letters : list_field<std::string>(node, key))
+        out.push_back(column_index(letters, key));
+    return out;
+}
+
+// the *_from_string parsers throw with their own wording; prefix the field
+template <typename F>
+auto checked(const std::string &key, F parse) -> decltype(parse())
+{
+    try { return parse(); }
+    catch (const std::exception &e) { throw std::runtime_error("`" + key + "`: " + e.what()); }
+}
+
+const std::string kRandomFillPrefix = "firestore-random-past-date-n-year-";
+
+bool is_random_fill(const std::string &fill_with)
+{
+    return fill_with.compare(0, kRandomFillPrefix.size(), kRandomFillPrefix) == 0;
+}
+
+// "firestore-random-past-date-n-year-N" needs N in 0..10000
+void check_fill_with(const std::string &fill_with)
+{
+    if (!is_random_fill(fill_with)) return;
+
+    int64_t years = 0;
+    if (!parse_plain_integer(fill_with.substr(kRandomFillPrefix.size()), years) || years < 0 || years > 10000)
+        throw std::runtime_error("`fill-with`: N years must be 0..10000 in " + fill_with);
+}
+
+// columns a fill-with template reads
+std::vector<std::size_t> template_reads(const std::string &fill_with)
+{
+    std::vector<std::size_t> cols;
+    for (const FillSegment &seg : compile_fill_template(fill_with))
+    {
+        if (seg.kind == FillSegment::Kind::Col) cols.push_back(seg.col);
+        if (seg.kind != FillSegment::Kind::IfCol) continue;
+        for (const auto &all : seg.any_of_all)
+            for (const Comparison &c : all) cols.push_back(c.col);
+        if (seg.if_true.is_col) cols.push_back(seg.if_true.col);
+        if (seg.if_false.is_col) cols.push_back(seg.if_false.col);
+    }
+    return cols;
+}
+
+// the node as flow YAML with map keys sorted and every scalar quoted, so
+// formatting, key order and quoting style do not change it
+void append_canonical(std::string &out, const YAML::Node &node)
+{
+    auto quoted = [&out](const std::string &s) {
+        out += '"';
+        append_json_escaped(out, s);
+        out += '"';
+    };
+
+    if (node.IsMap())
+    {
+        // (sorting YAML::Node handles would assign through them; sort rendered text instead)
+        std::vector<std::pair<std::string, std::string>> entries;
+        for (const auto &kv : node)
+        {
+            entries.emplace_back(kv.first.Scalar(), std::string());
+            append_canonical(entries.back().second, kv.second);
+        }
+        std::sort(entries.begin(), entries.end());
+
+        out += '{';
+        for (std::size_t i = 0; i < entries.size(); ++i)
+        {
+            if (i) out += ", ";
+            quoted(entries[i].first);
+            out += ": ";
+            out += entries[i].second;
+        }
+        out += '}';
+    }
+    else if (node.IsSequence())
+    {
+        out += '[';
+        std::size_t i = 0;
+        for (const auto &item : node)
+        {
+            if (i++) out += ", ";
+            append_canonical(out, item);
+        }
+        out += ']';
+    }
+    else if (node.IsScalar())
+        quoted(node.Scalar());
+    else
+        out += "null";
+}
+
+// ----------------------
+// filter-rows predicates: { all: [...] }, { any: [...] }, or a column with
+// one or more tests (several tests on one column must all hold)
+// ----------------------
+RowPredicate predicate_from_node(const YAML::Node &node)
+{
+    RowPredicate p;
+    for (const char *group : { "all", "any" })
+    {
+        if (!node[group]) continue;
+        if (!node[group].IsSequence())
+            throw std::runtime_error(std::string("`") + group + "` must be a list of conditions");
+        p.kind = std::string(group) == "all" ? RowPredicate::Kind::All : RowPredicate::Kind::Any;
+        for (const auto &child : node[group])
+            p.children.push_back(predicate_from_node(child));
+        return p;
+    }
+
+    if (!node["column"])
+        throw std::runtime_error("each `where` condition needs a column (or all/any)");
+    const std::size_t col_index = column_field(node, "column");
+
+    p.kind = RowPredicate::Kind::All;
+    auto add = [&](RowPredicate::Kind kind) -> RowPredicate & {
+        p.children.emplace_back();
+        p.children.back().kind = kind;
+        p.children.back().col_index = col_index;
+        return p.children.back();
+    };
+
+    if (node["equals"])     add(RowPredicate::Kind::Equals).value = field<std::string>(node, "equals");
+    if (node["not-equals"]) add(RowPredicate::Kind::NotEquals).value = field<std::string>(node, "not-equals");
+    if (node["contains"])   add(RowPredicate::Kind::Contains).value = field<std::string>(node, "contains");
+    if (node["is-empty"])   add(RowPredicate::Kind::IsEmpty).empty = field<bool>(node, "is-empty");
+    if (node["min"] || node["max"])
+    {
+        RowPredicate &range = add(RowPredicate::Kind::Range);
+        if (node["min"]) range.min = field<double>(node, "min");
+        if (node["max"]) range.max = field<double>(node, "max");
+    }
+
+    if (p.children.empty())
+        throw std::runtime_error("condition on column " + field<std::string>(node, "column")
+                                 + " needs equals, not-equals, contains, is-empty, min or max");
+    if (p.children.size() == 1)
+        return p.children.front();
+    return p;
+}
+
+// ----------------------
+// Operations
+// ----------------------
+struct FillColumnOp : Operation
+{
+    static constexpr const char *name = "fill-column";
+    std::size_t col_index = 0;
+    std::string fill_with, new_header;
+
+    void parse(const YAML::Node &node)
+    {
+        column = field<std::string>(node, "column");
+        col_index = column_index(column, "column");
+        fill_with = field<std::string>(node, "fill-with");
+        new_header = field<std::string>(node, "new-header", "");
+        check_fill_with(fill_with);
+    }
+
+    bool uses_clock() const override { return is_random_fill(fill_with); }
+
+    OpAccess access() const override
+    {
+        OpAccess a;
+        a.reads = template_reads(fill_with);
+        a.writes = { col_index };
+        return a;
+    }
+
+    std::string run(OpContext &ctx) const override
+    {
+        fill_column_nitro(ctx.sheet, ctx.header_row, ctx.first_data_row, col_index, fill_with, new_header, ctx.clock);
+
+        return fmt::format(
+            GREEN "✔ " RESET YELLOW "fill-column" RESET
+            " (" CYAN "{}" RESET ") with "
+            MAGENTA "\"{}\"" RESET
+            " → by header "
+            GREEN "\"{}\"" RESET,
+            column, fill_with, new_header
+        );
+    }
+};
+
+struct AddColumnOp : Operation
+{
+    static constexpr const char *name = "add-column";
+    std::string fill_with, new_header;
+
+    void parse(const YAML::Node &node)
+    {
+        column = field<std::string>(node, "at");
+        if (column != "end" && column != "beginning" && column != "start")
+            column_index(column, "at");
+        fill_with = field<std::string>(node, "fill-with");
+        new_header = field<std::string>(node, "new-header", "");
+        check_fill_with(fill_with);
+    }
+
+    bool uses_clock() const override { return is_random_fill(fill_with); }
+
+    OpAccess access() const override
+    {
+        OpAccess a;
+        a.barrier = true; // shifts the columns after it
+        return a;
+    }
+
+    std::string run(OpContext &ctx) const override
+    {
+        add_column_nitro(ctx.sheet, ctx.header_row, ctx.first_data_row, column, fill_with, new_header, ctx.clock);
+
+        return fmt::format(
+            GREEN "✔ " RESET YELLOW "add-column" RESET
+            " (" CYAN "{}" RESET ") with "
+            MAGENTA "\"{}\"" RESET
+            " → by header "
+            GREEN "\"{}\"" RESET,
+            column, fill_with, new_header
+        );
+    }
+};
+
+struct SplitColumnOp : Operation
+{
+    static constexpr const char *name = "split-column";
+    std::size_t col_index = 0;
+    char delimiter = '-';
+    std::vector<std::size_t> targets;
+    std::vector<std::string> new_headers;
+    std::vector<std::uint32_t> proper_positions;
+
+    void parse(const YAML::Node &node)
+    {
+        column = field<std::string>(node, "column");
+        col_index = column_index(column, "column");
+        const std::string delim = field<std::string>(node, "delimiter");
+        if (delim.empty()) throw std::runtime_error("`delimiter` is empty");
+        delimiter = delim[0];
+        targets = column_list(node, "split-to");
+        new_headers = list_field<std::string>(node, "new-headers");
+        proper_positions = list_field<std::uint32_t>(node, "proper-positions");
+    }
+
+    OpAccess access() const override
+    {
+        OpAccess a;
+        a.reads = { col_index };
+        a.writes = targets;
+        return a;
+    }
+
+    std::string run(OpContext &ctx) const override
+    {
+        split_column_nitro(ctx.sheet, ctx.header_row, ctx.first_data_row, col_index, delimiter, targets, new_headers, proper_positions);
+
+        return fmt::format(
+            GREEN "✔ " RESET YELLOW "split-column" RESET
+            " (" CYAN "{}" RESET ")",
+            column
+        );
+    }
+
+    bool row_stage(const OpContext &ctx, RowStage &st) const override
+    {
+        st.kind = RowStage::Kind::Split;
+        st.col_index = col_index;
+        st.first_data_row = ctx.first_data_row;
+        st.delimiter = delimiter;
+        st.target_col_indices = targets;
+        st.new_headers = new_headers;
+        st.proper_positions = proper_positions;
+        return true;
+    }
+};
+
+struct UppercaseColumnOp : Operation
+{
+    static constexpr const char *name = "uppercase-column";
+    std::size_t col_index = 0;
+
+    void parse(const YAML::Node &node)
+    {
+        column = field<std::string>(node, "column");
+        col_index = column_index(column, "column");
+    }
+
+    OpAccess access() const override
+    {
+        OpAccess a;
+        a.reads = a.writes = { col_index };
+        return a;
+    }
+
+    std::string run(OpContext &ctx) const override
+    {
+        uppercase_column_nitro(ctx.sheet, ctx.first_data_row, col_index);
+
+        return fmt::format(
+            GREEN "✔ " RESET YELLOW "uppercase-column" RESET
+            " (" CYAN "{}" RESET ")",
+            column
+        );
+    }
+
+    bool row_stage(const OpContext &ctx, RowStage &st) const override
+    {
+        st.kind = RowStage::Kind::Uppercase;
+        st.col_index = col_index;
+        st.first_data_row = ctx.first_data_row;
+        return true;
+    }
+};
+
+struct ReplaceInColumnOp : Operation
+{
+    static constexpr const char *name = "replace-in-column";
+    std::size_t col_index = 0;
+    std::string find, repl;
+
+    void parse(const YAML::Node &node)
+    {
+        column = field<std::string>(node, "column");
+        col_index = column_index(column, "column");
+        find = field<std::string>(node, "find");
+        repl = field<std::string>(node, "replace");
+    }
+
+    OpAccess access() const override
+    {
+        OpAccess a;
+        a.reads = a.writes = { col_index };
+        return a;
+    }
+
+    std::string run(OpContext &ctx) const override
+    {
+        replace_in_column_nitro(ctx.sheet, ctx.first_data_row, col_index, find, repl);
+
+        return fmt::format(
+            GREEN "✔ " RESET YELLOW "replace-in-column" RESET
+            " (" CYAN "{}" RESET ") "
+            MAGENTA "\"{}\"" RESET
+            " → "
+            GREEN "\"{}\"" RESET,
+            column, find, repl
+        );
+    }
+
+    bool row_stage(const OpContext &ctx, RowStage &st) const override
+    {
+        st.kind = RowStage::Kind::Replace;
+        st.col_index = col_index;
+        st.first_data_row = ctx.first_data_row;
+        st.find = find;
+        st.repl = repl;
+        return true;
+    }
+};
+
+struct RegexReplaceInColumnOp : Operation
+{
+    static constexpr const char *name = "regex-replace-in-column";
+    std::size_t col_index = 0;
+    std::string pattern, repl;
+    std::optional<LinearRegex> re; // compiled once, here
+
+    void parse(const YAML::Node &node)
+    {
+        column = field<std::string>(node, "column");
+        col_index = column_index(column, "column");
+        pattern = field<std::string>(node, "pattern");
+        repl = field<std::string>(node, "replace", "");
+        re = checked("pattern", [&] { return LinearRegex(pattern); });
+    }
+
+    OpAccess access() const override
+    {
+        OpAccess a;
+        a.reads = a.writes = { col_index };
+        return a;
+    }
+
+    std::string run(OpContext &ctx) const override
+    {
+        regex_replace_in_column_nitro(ctx.sheet, ctx.first_data_row, col_index, *re, repl);
+
+        return fmt::format(
+            GREEN "✔ " RESET YELLOW "regex-replace-in-column" RESET
+            " (" CYAN "{}" RESET ") "
+            MAGENTA "/{}/" RESET
+            " → "
+            GREEN "\"{}\"" RESET,
+            column, pattern, repl
+        );
+    }
+};
+
+struct TransformRowOp : Operation
+{
+    static constexpr const char *name = "transform-row";
+    std::uint32_t row = 1;
+    std::string to, delimiter;
+    CaseStyle style = CaseStyle::Lower;
+
+    void parse(const YAML::Node &node)
+    {
+        row = field<std::uint32_t>(node, "row");
+        if (row == 0) throw std::runtime_error("`row` is 1-based");
+        to = field<std::string>(node, "to");
+        style = checked("to", [&] { return case_style_from_string(to); });
+        delimiter = field<std::string>(node, "delimiter", "");
+    }
+
+    OpAccess access() const override
+    {
+        OpAccess a;
+        a.all_columns = true;
+        return a;
+    }
+
+    std::string run(OpContext &ctx) const override
+    {
+        if (!delimiter.empty())
+            transform_row_nitro(ctx.sheet, row - 1, style, delimiter[0]);
+        else
+            transform_row_nitro(ctx.sheet, row - 1, style);
+
+        return fmt::format(
+            GREEN "✔ " RESET YELLOW "transform-row" RESET
+            " (" CYAN "{}" RESET ") → {}{}",
+            row, to,
+            delimiter.empty() ? "" : (" (delim=" + delimiter + ")")
+        );
+    }
+};
+
+struct TransformHeaderOp : Operation
+{
+    static constexpr const char *name = "transform-header";
+    std::string to, delimiter;
+    CaseStyle style = CaseStyle::Lower;
+
+    void parse(const YAML::Node &node)
+    {
+        to = field<std::string>(node, "to");
+        style = checked("to", [&] { return case_style_from_string(to); });
+        delimiter = field<std::string>(node, "delimiter", "");
+    }
+
+    OpAccess access() const override
+    {
+        OpAccess a;
+        a.all_columns = true;
+        return a;
+    }
+
+    std::string run(OpContext &ctx) const override
+    {
+        if (!delimiter.empty())
+            transform_header_nitro(ctx.sheet, style, delimiter[0]);
+        else
+            transform_header_nitro(ctx.sheet, style);
+
+        return fmt::format(
+            GREEN "✔ " RESET YELLOW "transform-header" RESET
+            " → {}{}",
+            to,
+            delimiter.empty() ? "" : (" (delim=" + delimiter + ")")
+        );
+    }
+};
+
+struct RenameHeaderOp : Operation
+{
+    static constexpr const char *name = "rename-header";
+    std::size_t col_index = 0;
+    std::string new_name;
+
+    void parse(const YAML::Node &node)
+    {
+        column = field<std::string>(node, "column");
+        col_index = column_index(column, "column");
+        new_name = field<std::string>(node, "new-name", "");
+    }
+
+    OpAccess access() const override
+    {
+        OpAccess a;
+        a.reads = a.writes = { col_index };
+        return a;
+    }
+
+    std::string run(OpContext &ctx) const override
+    {
+        rename_header_nitro(ctx.sheet, col_index, new_name);
+
+        return fmt::format(
+            GREEN "✔ " RESET YELLOW "rename-header" RESET
+            " (" CYAN "{}" RESET ") → {}",
+            column, new_name
+        );
+    }
+};
+
+struct SortRowsOp : Operation
+{
+    static constexpr const char *name = "sort-rows-by-column";
+    std::size_t col_index = 0;
+    bool ascending = true;
+    std::string sort_as_name;
+    SortAs sort_as = SortAs::String;
+
+    void parse(const YAML::Node &node)
+    {
+        column = field<std::string>(node, "column");
+        col_index = column_index(column, "column");
+        ascending = field<bool>(node, "ascending", true);
+        sort_as_name = field<std::string>(node, "sort-as", "string");
+        sort_as = checked("sort-as", [&] { return sort_as_from_string(sort_as_name); });
+    }
+
+    OpAccess access() const override
+    {
+        OpAccess a;
+        a.barrier = true; // reorders the selection
+        return a;
+    }
+
+    std::string run(OpContext &ctx) const override
+    {
+        sort_rows_by_column_nitro(ctx.sheet, col_index, ascending, sort_as);
+
+        return fmt::format(
+            GREEN "✔ " RESET YELLOW "sort-rows-by-column" RESET
+            " (" CYAN "{}" RESET ") → {} as {}",
+            column, ascending ? "ascending" : "descending", sort_as_name
+        );
+    }
+};
+
+struct TopNOp : Operation
+{
+    static constexpr const char *name = "top-n";
+    std::size_t col_index = 0, count = 0;
+    bool ascending = false;
+    std::string sort_as_name;
+    SortAs sort_as = SortAs::Number;
+    std::vector<std::size_t> group_by;
+
+    void parse(const YAML::Node &node)
+    {
+        column = field<std::string>(node, "column");
+        col_index = column_index(column, "column");
+        count = field<std::size_t>(node, "count");
+        ascending = field<bool>(node, "ascending", false);
+        sort_as_name = field<std::string>(node, "sort-as", "number");
+        sort_as = checked("sort-as", [&] { return sort_as_from_string(sort_as_name); });
+        group_by = column_list(node, "group-by");
+    }
+
+    OpAccess access() const override
+    {
+        OpAccess a;
+        a.barrier = true; // rewrites the selection
+        return a;
+    }
+
+    std::string run(OpContext &ctx) const override
+    {
+        top_n_nitro(ctx.sheet, col_index, count, ascending, sort_as, group_by);
+
+        return fmt::format(
+            GREEN "✔ " RESET YELLOW "top-n" RESET
+            " (" CYAN "{}" RESET ") → {} {} as {}{}",
+            column, ascending ? "lowest" : "highest", count, sort_as_name,
+            group_by.empty() ? "" : fmt::format(" per group of {} columns", group_by.size())
+        );
+    }
+};
+
+struct GroupCollectOp : Operation
+{
+    static constexpr const char *name = "group-collect";
+    std::size_t group_col = 0;
+    std::vector<std::size_t> collect_cols, output_cols, maths_cols;
+    std::vector<std::string> maths_ops;
+    bool marked_unique = false;
+
+    void parse(const YAML::Node &node)
+    {
+        column = field<std::string>(node, "group-by");
+        group_col = column_index(column, "group-by");
+        collect_cols = column_list(node, "to-array-columns");
+        output_cols = column_list(node, "to-array-output-columns");
+        marked_unique = field<bool>(node, "mark-unique-items", false);
+        maths_cols = column_list(node, "do-maths-columns");
+        maths_ops = list_field<std::string>(node, "do-maths-operations");
+
+        if (collect_cols.size() != output_cols.size())
+            throw std::runtime_error("`to-array-columns` and `to-array-output-columns` differ in length");
+        if (maths_cols.size() != maths_ops.size())
+            throw std::runtime_error("`do-maths-columns` and `do-maths-operations` differ in length");
+        for (const auto &op : maths_ops)
+            if (op != "sum" && op != "avg" && op != "min" && op != "max" && op != "count")
+                throw std::runtime_error("`do-maths-operations`: unknown maths operation " + op + " (sum, avg, min, max, count)");
+    }
+
+    OpAccess access() const override
+    {
+        OpAccess a;
+        a.barrier = true; // rewrites the selection
+        return a;
+    }
+
+    std::string run(OpContext &ctx) const override
+    {
+        group_collect_nitro(ctx.sheet, group_col, collect_cols, output_cols, marked_unique, maths_cols, maths_ops);
+
+        return fmt::format(
+            GREEN "✔ " RESET YELLOW "group-collect-to" RESET
+            " (group=" CYAN "{}" RESET ")",
+            column
+        );
+    }
+};
+
+struct ReassignNumberingOp : Operation
+{
+    static constexpr const char *name = "reassign-numbering";
+    std::size_t col_index = 0;
+    std::string prefix, suffix;
+    std::uint32_t start_from = 1, step = 1;
+
+    void parse(const YAML::Node &node)
+    {
+        column = field<std::string>(node, "column");
+        col_index = column_index(column, "column");
+        prefix = field<std::string>(node, "prefix");
+        suffix = field<std::string>(node, "suffix");
+        start_from = field<std::uint32_t>(node, "start-from", 1);
+        step = field<std::uint32_t>(node, "step", 1);
+    }
+
+    OpAccess access() const override
+    {
+        OpAccess a;
+        a.reads = a.writes = { col_index };
+        return a;
+    }
+
+    std::string run(OpContext &ctx) const override
+    {
+        reassign_numbering_nitro(ctx.sheet, col_index, prefix, suffix, start_from, step);
+
+        return fmt::format(
+            GREEN "✔ " RESET YELLOW "reassign-numbering" RESET
+            " (" CYAN "{}" RESET ")",
+            column
+        );
+    }
+};
+
+struct FilterRowsOp : Operation
+{
+    static constexpr const char *name = "filter-rows";
+    std::string match;
+    RowPredicate where;
+
+    void parse(const YAML::Node &node)
+    {
+        match = field<std::string>(node, "match", "all");
+        if (match != "all" && match != "any")
+            throw std::runtime_error("`match` must be all or any, got " + match);
+
+        where.kind = match == "all" ? RowPredicate::Kind::All : RowPredicate::Kind::Any;
+        const YAML::Node conds = node["where"];
+        if (conds && !conds.IsSequence())
+            throw std::runtime_error("`where` must be a list of conditions");
+        for (const auto &cond : conds)
+            where.children.push_back(predicate_from_node(cond));
+    }
+
+    OpAccess access() const override
+    {
+        OpAccess a;
+        a.barrier = true; // rewrites the selection
+        return a;
+    }
+
+    std::string run(OpContext &ctx) const override
+    {
+        const std::size_t before = ctx.sheet.row_count();
+        filter_rows_nitro(ctx.sheet, where);
+
+        return fmt::format(
+            GREEN "✔ " RESET YELLOW "filter-rows" RESET
+            " (match " CYAN "{}" RESET ") → kept {} of {} rows",
+            match, ctx.sheet.row_count(), before
+        );
+    }
+};
+
+struct LookupColumnOp : Operation
+{
+    static constexpr const char *name = "lookup-column";
+    std::string from, sheet_name, default_value;
+    std::uint32_t ref_header_row = 1, ref_first_data_row = 2;
+    std::size_t key_col = 0, ref_key_col = 0;
+    std::vector<std::size_t> ref_columns, output_columns;
+    std::vector<std::string> new_headers;
+    OnDuplicate on_duplicate = OnDuplicate::First;
+
+    void parse(const YAML::Node &node)
+    {
+        from = field<std::string>(node, "from", "");
+        sheet_name = field<std::string>(node, "sheet", "");
+        if (from.empty() && sheet_name.empty())
+            throw std::runtime_error("set `from` (a workbook) and/or `sheet` (a worksheet name)");
+
+        ref_header_row = field<std::uint32_t>(node, "header-row", 1);
+        ref_first_data_row = field<std::uint32_t>(node, "first-data-row", ref_header_row + 1);
+        column = field<std::string>(node, "key-column");
+        key_col = column_index(column, "key-column");
+        ref_key_col = column_field(node, "ref-key-column");
+        const std::string dup = field<std::string>(node, "on-duplicate", "first");
+        on_duplicate = checked("on-duplicate", [&] { return on_duplicate_from_string(dup); });
+        default_value = field<std::string>(node, "default", "");
+
+        ref_columns = column_list(node, "ref-columns");
+        output_columns = column_list(node, "output-columns");
+        new_headers = list_field<std::string>(node, "new-headers");
+    }
+
+    std::vector<std::string> reference_files() const override
+    {
+        if (from.empty()) return {}; // a tab of the input workbook
+        return { from };
+    }
+
+    OpAccess access() const override
+    {
+        OpAccess a;
+        a.reads = { key_col };
+        a.writes = output_columns;
+        return a;
+    }
+
+    std::string run(OpContext &ctx) const override
+    {
+        if (!ctx.load_reference)
+            throw std::runtime_error("lookup-column: no reference sheet loader");
+        const NitroSheet ref = ctx.load_reference(from, sheet_name, ref_header_row, ref_first_data_row);
+
+        lookup_column_nitro(ctx.sheet, ref, key_col, ref_key_col, ref_columns, output_columns, new_headers,
+                            on_duplicate, default_value);
+
+        return fmt::format(
+            GREEN "✔ " RESET YELLOW "lookup-column" RESET
+            " (" CYAN "{}" RESET ") ← {} [{}] ({} rows)",
+            column, from.empty() ? ctx.input_file : from, sheet_name.empty() ? "first sheet" : sheet_name,
+            ref.num_rows
+        );
+    }
+};
+
+struct DedupeRowsOp : Operation
+{
+    static constexpr const char *name = "dedupe-rows";
+    std::vector<std::size_t> key_columns;
+
+    void parse(const YAML::Node &node)
+    {
+        key_columns = column_list(node, "columns");
+    }
+
+    OpAccess access() const override
+    {
+        OpAccess a;
+        a.barrier = true; // rewrites the selection
+        return a;
+    }
+
+    std::string run(OpContext &ctx) const override
+    {
+        const std::size_t before = ctx.sheet.row_count();
+        dedupe_rows_nitro(ctx.sheet, key_columns);
+
+        return fmt::format(
+            GREEN "✔ " RESET YELLOW "dedupe-rows" RESET
+            " (" CYAN "{}" RESET ") → removed {} duplicate rows",
+            key_columns.empty() ? "all columns" : fmt::format("{} columns", key_columns.size()),
+            before - ctx.sheet.row_count()
+        );
+    }
+};
+
+struct PivotOp : Operation
+{
+    static constexpr const char *name = "pivot";
+    std::string value_column, aggregate_name, fill_empty;
+    std::size_t pivot_col = 0, value_col = 0;
+    std::vector<std::size_t> row_keys;
+    PivotAggregate aggregate = PivotAggregate::Sum;
+
+    void parse(const YAML::Node &node)
+    {
+        column = field<std::string>(node, "pivot-column");
+        pivot_col = column_index(column, "pivot-column");
+        value_column = field<std::string>(node, "value-column");
+        value_col = column_index(value_column, "value-column");
+        aggregate_name = field<std::string>(node, "aggregate", "sum");
+        aggregate = checked("aggregate", [&] { return pivot_aggregate_from_string(aggregate_name); });
+        fill_empty = field<std::string>(node, "fill-empty", "");
+        row_keys = column_list(node, "row-keys");
+    }
+
+    OpAccess access() const override
+    {
+        OpAccess a;
+        a.barrier = true; // rebuilds the whole sheet
+        return a;
+    }
+
+    std::string run(OpContext &ctx) const override
+    {
+        const std::size_t before = ctx.sheet.row_count();
+        pivot_nitro(ctx.sheet, row_keys, pivot_col, value_col, aggregate, fill_empty);
+
+        return fmt::format(
+            GREEN "✔ " RESET YELLOW "pivot" RESET
+            " (" CYAN "{}" RESET " by " CYAN "{}" RESET ", {}) → {} rows x {} columns from {} rows",
+            value_column, column, aggregate_name, ctx.sheet.num_rows, ctx.sheet.cols.size(), before
+        );
+    }
+};
+
+struct RemoveColumnOp : Operation
+{
+    static constexpr const char *name = "remove-column";
+    std::size_t col_index = 0;
+
+    void parse(const YAML::Node &node)
+    {
+        column = field<std::string>(node, "column");
+        col_index = column_index(column, "column");
+    }
+
+    OpAccess access() const override
+    {
+        OpAccess a;
+        a.barrier = true; // shifts the columns after it
+        return a;
+    }
+
+    std::string run(OpContext &ctx) const override
+    {
+        remove_column_nitro(ctx.sheet, col_index);
+
+        return fmt::format(
+            GREEN "✔ " RESET YELLOW "remove-column" RESET
+            " (" CYAN "{}" RESET ")",
+            column
+        );
+    }
+};
+
+template <typename Op>
+std::pair<const std::string, OperationFactory> entry()
+{
+    return { Op::name, [](const YAML::Node &node) -> OperationPtr {
+        auto op = std::make_shared<Op>();
+        op->type = Op::name;
+        op->parse(node);
+        append_canonical(op->canonical, node);
+        return op;
+    } };
+}
+
+} // namespace
+
+ReferenceLoader serialized_reference_loader(ReferenceLoader read)
+{
+    auto m = std::make_shared<std::mutex>();
+    return [m, read = std::move(read)](const std::string &from, const std::string &sheet_name,
+                                       std::uint32_t header_row, std::uint32_t first_data_row)
+    {
+        NitroSheet ref;
+        {
+            std::lock_guard<std::mutex> lock(*m);
+            ref = read(from, sheet_name, header_row, first_data_row);
+        }
+        dict_encode_columns(ref);
+        return ref;
+    };
+}
+
+const std::unordered_map<std::string, OperationFactory> &operation_registry()
+{
+    static const std::unordered_map<std::string, OperationFactory> registry = {
+        entry<FillColumnOp>(),
+        entry<AddColumnOp>(),
+        entry<SplitColumnOp>(),
+        entry<UppercaseColumnOp>(),
+        entry<ReplaceInColumnOp>(),
+        entry<RegexReplaceInColumnOp>(),
+        entry<TransformRowOp>(),
+        entry<TransformHeaderOp>(),
+        entry<RenameHeaderOp>(),
+        entry<SortRowsOp>(),
+        entry<TopNOp>(),
+        entry<GroupCollectOp>(),
+        entry<ReassignNumberingOp>(),
+        entry<FilterRowsOp>(),
+        entry<LookupColumnOp>(),
+        entry<DedupeRowsOp>(),
+        entry<PivotOp>(),
+        entry<RemoveColumnOp>(),
+    };
+    return registry;
+}
+
+OperationPtr compile_operation(const YAML::Node &node)
+{
+    if (!node.IsMap())
+        throw std::runtime_error("expected a map with a `type`");
+    const std::string type = field<std::string>(node, "type");
+
+    const auto &registry = operation_registry();
+    auto it = registry.find(type);
+    if (it == registry.end())
+        throw std::runtime_error("unknown operation type: " + type);
+
+    try { return it->second(node); }
+    catch (const std::runtime_error &e) { throw std::runtime_error(type + ": " + e.what()); }
+}
+
+// ----------------------
+// Running a plan
+// ----------------------
+namespace {
+
+// one scheduled step: a single operation, or a fused run of row-local ones
+struct Step
+{
+    std::size_t first = 0, count = 1; // operations [first, first + count)
+    std::vector<RowStage> stages;     // fused run (count >= 2)
+    OpAccess access;
+};
+
+bool touches(const std::vector<std::size_t> &cols, const std::vector<std::size_t> &other)
+{
+    for (std::size_t c : cols)
+        if (std::find(other.begin(), other.end(), c) != other.end()) return true;
+    return false;
+}
+
+// must b wait for a (a earlier in the script)?
+bool conflicts(const OpAccess &a, const OpAccess &b)
+{
+    if (a.all_columns || b.all_columns) return true;
+    return touches(a.writes, b.reads) || touches(a.writes, b.writes) || touches(a.reads, b.writes);
+}
+
+} // namespace
+
+std::vector<std::string> run_operations(
+    const std::vector<OperationPtr> &ops,
+    OpContext &ctx,
+    const std::function<void(std::size_t, std::size_t)> &progress,
+    const std::function<void(std::size_t)> &on_prefix
+)
+{
+    // ---- fuse runs of row-local operations into one pass over the rows ----
+    std::vector<Step> steps;
+    for (std::size_t i = 0; i < ops.size(); )
+    {
+        Step step;
+        step.first = i;
+        RowStage st;
+        while (i + step.stages.size() < ops.size() && ops[i + step.stages.size()]->row_stage(ctx, st))
+        {
+            step.stages.push_back(std::move(st));
+            st = RowStage();
+        }
+        if (step.stages.size() < 2) step.stages.clear();
+        step.count = std::max<std::size_t>(1, step.stages.size());
+
+        for (std::size_t j = i; j < i + step.count; ++j)
+        {
+            const OpAccess a = ops[j]->access();
+            step.access.reads.insert(step.access.reads.end(), a.reads.begin(), a.reads.end());
+            step.access.writes.insert(step.access.writes.end(), a.writes.begin(), a.writes.end());
+            step.access.all_columns |= a.all_columns;
+            step.access.barrier |= a.barrier;
+        }
+        i += step.count;
+        steps.push_back(std::move(step));
+    }
+
+    std::vector<std::string> logs(ops.size());
+    std::mutex progress_m;
+    std::size_t done = 0;
+
+    auto run_step = [&](const Step &step)
+    {
+        if (!step.stages.empty() && row_stages_fusable(ctx.sheet, step.stages))
+        {
+            run_row_stages_nitro(ctx.sheet, step.stages);
+            for (std::size_t j = step.first; j < step.first + step.count; ++j)
+                logs[j] = fmt::format(
+                    GREEN "✔ " RESET YELLOW "{}" RESET
+                    " (" CYAN "{}" RESET ") " BLUE "[fused]" RESET,
+                    ops[j]->type, ops[j]->column
+                );
+        }
+        else
+            for (std::size_t j = step.first; j < step.first + step.count; ++j)
+                logs[j] = ops[j]->run(ctx);
+
+        std::lock_guard<std::mutex> lock(progress_m);
+        done += step.count;
+        if (progress) progress(done, ops.size());
+    };
+
+    ThreadPool &pool = global_pool();
+    if (pool.threads() == 1)
+    {
+        for (const Step &step : steps)
+        {
+            run_step(step);
+            if (on_prefix) on_prefix(step.first + step.count);
+        }
+        return logs;
+    }
+
+    // ---- between barriers, independent steps run concurrently ----
+    std::vector<const Step *> pending; // steps since the last barrier, in script order
+    auto flush = [&]
+    {
+        if (pending.empty()) return;
+        const std::size_t prefix = pending.back()->first + pending.back()->count;
+
+        if (pending.size() == 1)
+            run_step(*pending.front());
+        else
+        {
+            TaskGraph graph;
+            for (std::size_t k = 0; k < pending.size(); ++k)
+            {
+                std::vector<std::size_t> deps;
+                for (std::size_t e = 0; e < k; ++e)
+                    if (conflicts(pending[e]->access, pending[k]->access)) deps.push_back(e);
+                graph.add([&, k] { run_step(*pending[k]); }, deps);
+            }
+            graph.run(pool);
+        }
+        pending.clear();
+        if (on_prefix) on_prefix(prefix);
+    };
+
+    for (const Step &step : steps)
+    {
+        // the column count only changes at barriers, so a step that would
+        // create columns (a write past the end) has to be one too
+        bool grows = false;
+        for (std::size_t c : step.access.writes) grows |= c >= ctx.sheet.cols.size();
+
+        if (step.access.barrier || grows)
+        {
+            flush();
+            run_step(step);
+            if (on_prefix) on_prefix(step.first + step.count);
+        }
+        else
+            pending.push_back(&step);
+    }
+    flush();
+
+    return logs;
+}
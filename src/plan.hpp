@@ -0,0 +1,104 @@
+// plan.hpp
+#pragma once
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <yaml-cpp/yaml.h>
+#include "operations.hpp"
+
+// Compiled script operations.
+//
+// load_script() turns every YAML operation into a typed Operation through the
+// registry below: fields are read, column letters resolved and enums, regexes
+// and predicates checked once, before any workbook is opened. Running the
+// plan only touches plain structs.
+
+// reads a lookup-column reference sheet: workbook path ("" = the input
+// workbook), sheet name ("" = the first sheet), header row, first data row
+using ReferenceLoader = std::function<NitroSheet(const std::string &, const std::string &, std::uint32_t, std::uint32_t)>;
+
+// wrap a reader of plain reference sheets (OpenXLSX documents are not
+// thread-safe): reads run one at a time, and the dictionary encoding runs on
+// the pool after the lock is released. No pool work may run under the lock:
+// waiting on the pool runs other queued tasks, which may be a concurrent
+// lookup taking the same lock on the same thread.
+ReferenceLoader serialized_reference_loader(ReferenceLoader read);
+
+// what an operation sees while it runs
+struct OpContext
+{
+    NitroSheet &sheet;
+    std::uint32_t header_row = 1;
+    std::uint32_t first_data_row = 2;
+    FillClock clock;
+    ReferenceLoader load_reference;
+    std::string input_file; // for log lines
+
+    explicit OpContext(NitroSheet &sheet, std::uint32_t header_row = 1, std::uint32_t first_data_row = 2,
+                       FillClock clock = FillClock())
+        : sheet(sheet), header_row(header_row), first_data_row(first_data_row), clock(clock)
+    {
+    }
+};
+
+// the columns an operation touches; run_operations() runs operations whose
+// accesses do not conflict at the same time
+struct OpAccess
+{
+    std::vector<std::size_t> reads, writes; // 0-based columns
+    bool all_columns = false; // touches every column (a whole row, every header)
+    bool barrier = false;     // reorders/drops rows or moves columns: runs alone, in script order
+};
+
+struct Operation
+{
+    std::string type;   // registry name, e.g. "fill-column"
+    std::string column; // main column letters as written in the script ("" if none), for log lines
+    std::string canonical; // the script entry with sorted keys, for checkpoint keys (see snapshot.hpp)
+
+    virtual ~Operation() = default;
+
+    // apply to ctx.sheet; returns the log line
+    virtual std::string run(OpContext &ctx) const = 0;
+
+    virtual OpAccess access() const = 0;
+
+    // true when the result depends on the run's FillClock (random fills)
+    virtual bool uses_clock() const { return false; }
+
+    // workbooks read besides the input (lookups)
+    virtual std::vector<std::string> reference_files() const { return {}; }
+
+    // row-local operations describe themselves as a RowStage so a run of them
+    // can be fused into one pass (see run_row_stages_nitro)
+    virtual bool row_stage(const OpContext &, RowStage &) const { return false; }
+};
+
+using OperationPtr = std::shared_ptr<const Operation>;
+
+// builds an operation from its YAML node; throws std::runtime_error naming the bad field
+using OperationFactory = std::function<OperationPtr(const YAML::Node &)>;
+
+// every operation type by name
+const std::unordered_map<std::string, OperationFactory> &operation_registry();
+
+// compile one `operations:` entry; throws std::runtime_error on unknown types and bad fields
+OperationPtr compile_operation(const YAML::Node &node);
+
+// run the operations with the result of running them in script order:
+// consecutive row-local operations on plain (not dictionary) columns are
+// fused, and between barriers the rest form a dependency graph on their
+// column accesses whose independent operations run concurrently on the
+// thread pool. progress(done, total) is called (serialized) as operations
+// finish. Returns one log line per operation, in script order. on_prefix(n) is called, on the calling thread,
+// whenever ctx.sheet holds the result of exactly the first n operations
+// (after every step run alone and every concurrent group).
+std::vector<std::string> run_operations(
+    const std::vector<OperationPtr> &ops,
+    OpContext &ctx,
+    const std::function<void(std::size_t, std::size_t)> &progress = {},
+    const std::function<void(std::size_t)> &on_prefix = {}
+);
@@ -0,0 +1,214 @@
+#include "runner.hpp"
+#include <chrono>
+#include <iostream>
+#include <map>
+#include <optional>
+#include "colors.hpp"
+#include "csv.hpp"
+#include "json.hpp"
+#include "openxlsx_adapter.hpp"
+#include "plan.hpp"
+#include "progress.hpp"
+#include "snapshot.hpp"
+#include "thread_pool.hpp"
+
+#define FMT_HEADER_ONLY
+#include "fmt/core.h"
+
+namespace {
+
+double ms_since(std::chrono::steady_clock::time_point t0)
+{
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count();
+}
+
+} // namespace
+
+NitroSheet load_input_sheet(const std::string &path, std::uint32_t header_row, std::uint32_t first_data_row)
+{
+    ox::XLDocument wb = open_workbook(path);
+    auto ws = worksheet_active(wb);
+    NitroSheet sheet = load_sheet_vectorized_from_openxlsx(ws, header_row, first_data_row);
+    close_workbook(wb);
+    return sheet;
+}
+
+RunReport run_script(const Config &cfg, const RunOptions &opt)
+{
+    RunReport report;
+    auto t0 = std::chrono::steady_clock::now();
+
+    // one clock for the whole run: every random timestamp counts back from the same "now"
+    const FillClock clock(cfg.now, cfg.seed);
+
+    // the input workbook is opened on first use: a base sheet or a restored
+    // checkpoint may not need it
+    struct InputWorkbook
+    {
+        ox::XLDocument doc;
+        bool open = false;
+        ~InputWorkbook() { if (open) close_workbook(doc); }
+    } wb;
+    auto input_workbook = [&]() -> ox::XLDocument & {
+        if (!wb.open) wb.doc = open_workbook(cfg.input_file);
+        wb.open = true;
+        return wb.doc;
+    };
+
+    NitroSheet sheet;
+    bool restored = false;
+    std::optional<CheckpointCache> cache;
+    if (!opt.cache_dir.empty())
+    {
+        cache.emplace(opt.cache_dir, cfg, clock);
+        // with a base in memory, only a snapshot past the input is worth reading
+        if (auto prefix = cache->restore(sheet, opt.base ? 1 : 0))
+        {
+            restored = true;
+            report.restored_ops = *prefix;
+            if (opt.verbose)
+                std::cout << "# Restored checkpoint after " << report.restored_ops << " of " << cfg.operations.size()
+                          << " operations: cols=" << sheet.cols.size() << " rows=" << sheet.num_rows << "\n\n" << std::flush;
+        }
+    }
+
+    if (!restored)
+    {
+        if (opt.base)
+            sheet = *opt.base; // shares every column until an operation writes to it
+        else
+        {
+            // Open with OpenXLSX
+            auto ws = worksheet_active(input_workbook());
+
+            sheet = load_sheet_vectorized_from_openxlsx(ws, cfg.header_row, cfg.first_data_row);
+            if (opt.verbose)
+                std::cout << "# Loaded: cols=" << sheet.cols.size() << " rows=" << sheet.num_rows << "\n\n" << std::flush;
+        }
+        if (cache) cache->save(0, sheet);
+    }
+    report.load_ms = ms_since(t0);
+
+    if (opt.verbose)
+        std::cout << BOLD WHITE "#  Running operations..." RESET << "\n\n" << std::flush;
+
+    const std::size_t total_ops = cfg.operations.size();
+
+    OpContext ctx(sheet, cfg.header_row, cfg.first_data_row, clock);
+    ctx.input_file = cfg.input_file;
+
+    // lookup-column reference sheet: another workbook, or another tab of the input workbook
+    // (lookups may run concurrently; the loader serializes the OpenXLSX reads)
+    ctx.load_reference = serialized_reference_loader([&](const std::string &from, const std::string &sheet_name,
+                                                         std::uint32_t header_row, std::uint32_t first_data_row)
+    {
+        ox::XLDocument ref_wb;
+        if (!from.empty()) ref_wb = open_workbook(from);
+        ox::XLDocument &ref_doc = from.empty() ? input_workbook() : ref_wb;
+        auto ref_ws = sheet_name.empty() ? worksheet_active(ref_doc) : worksheet_named(ref_doc, sheet_name);
+        auto ref = read_sheet_from_openxlsx(ref_ws, header_row, first_data_row);
+        if (!from.empty()) close_workbook(ref_wb);
+        return ref;
+    });
+
+    const std::size_t skipped = report.restored_ops;
+    for (std::size_t i = 0; i < skipped; ++i)
+        report.logs.push_back(fmt::format(
+            GREEN "✔ " RESET YELLOW "{}" RESET " (" CYAN "{}" RESET ") " BLUE "[checkpoint]" RESET,
+            cfg.operations[i]->type, cfg.operations[i]->column
+        ));
+
+    // initial progress
+    if (opt.verbose) progress_bar(skipped, total_ops);
+
+    t0 = std::chrono::steady_clock::now();
+
+    const std::vector<OperationPtr> remaining(cfg.operations.begin() + skipped, cfg.operations.end());
+    std::vector<std::string> ran = run_operations(
+        remaining, ctx,
+        [&](std::size_t done, std::size_t) { if (opt.verbose) progress_bar(skipped + done, total_ops); },
+        [&](std::size_t done) { if (cache) cache->save(skipped + done, sheet); }
+    );
+    report.logs.insert(report.logs.end(), ran.begin(), ran.end());
+    report.ops_ms = ms_since(t0);
+
+    t0 = std::chrono::steady_clock::now();
+
+    save_json_nitro(sheet, cfg.header_row, cfg.first_data_row, cfg.output_file + ".json");
+
+    if (cfg.export_csv)
+    {
+        save_csv_nitro(sheet, cfg.output_file + ".csv");
+    }
+    if (cfg.export_xlsx)
+    {
+        save_as_xlsx(sheet, cfg.header_row, cfg.first_data_row, cfg.output_file + ".xlsx");
+    }
+    report.export_ms = ms_since(t0);
+
+    if (cache) cache->finish();
+
+    report.rows = sheet.row_count();
+    report.cols = sheet.cols.size();
+    return report;
+}
+
+std::vector<ScriptResult> run_scripts(const std::vector<Config> &cfgs, const std::string &cache_dir)
+{
+    // one load per distinct input
+    std::map<std::string, std::size_t> input_index;
+    std::vector<std::size_t> input_of(cfgs.size());
+    std::vector<const Config *> loads;
+    for (std::size_t i = 0; i < cfgs.size(); ++i)
+    {
+        const Config &cfg = cfgs[i];
+        const std::string key = cfg.input_file + ":" + std::to_string(cfg.header_row) + ":" + std::to_string(cfg.first_data_row);
+        auto [it, added] = input_index.emplace(key, loads.size());
+        if (added) loads.push_back(&cfg);
+        input_of[i] = it->second;
+    }
+
+    std::vector<NitroSheet> inputs(loads.size());
+    std::vector<std::string> load_errors(loads.size());
+    std::vector<double> load_ms(loads.size());
+    {
+        TaskGroup group(global_pool());
+        for (std::size_t j = 0; j < loads.size(); ++j)
+            group.run([&, j] {
+                const auto t0 = std::chrono::steady_clock::now();
+                try
+                {
+                    inputs[j] = load_input_sheet(loads[j]->input_file, loads[j]->header_row, loads[j]->first_data_row);
+                }
+                catch (const std::exception &e)
+                {
+                    load_errors[j] = "Cannot load " + loads[j]->input_file + ": " + e.what();
+                }
+                load_ms[j] = ms_since(t0);
+            });
+        group.wait();
+    }
+
+    std::vector<ScriptResult> results(cfgs.size());
+    TaskGroup group(global_pool());
+    for (std::size_t i = 0; i < cfgs.size(); ++i)
+        group.run([&, i] {
+            const std::size_t j = input_of[i];
+            if (!load_errors[j].empty())
+            {
+                results[i].error = load_errors[j];
+                return;
+            }
+            try
+            {
+                results[i].report = run_script(cfgs[i], RunOptions{ &inputs[j], cache_dir, false });
+                results[i].report.load_ms = load_ms[j];
+            }
+            catch (const std::exception &e)
+            {
+                results[i].error = e.what();
+            }
+        });
+    group.wait();
+    return results;
+}
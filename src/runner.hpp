@@ -0,0 +1,46 @@
+// runner.hpp
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "config.hpp"
+#include "nitro_sheet.hpp"
+
+// Running one compiled script end to end: input sheet, operations, exports.
+// Shared by the one-shot run and --watch.
+
+// open a workbook and load its active sheet; throws std::runtime_error
+NitroSheet load_input_sheet(const std::string &path, std::uint32_t header_row, std::uint32_t first_data_row);
+
+struct RunOptions
+{
+    // an already loaded input. The run works on a copy-on-write view, so the
+    // base is never modified and can be reused by the next run.
+    // nullptr: load cfg.input_file (skipped when a checkpoint is restored)
+    const NitroSheet *base = nullptr;
+    std::string cache_dir; // checkpoint directory, "" = none (see snapshot.hpp)
+    bool verbose = true;   // print load messages and the progress bar
+};
+
+struct RunReport
+{
+    std::vector<std::string> logs; // one per operation, in script order
+    std::size_t restored_ops = 0;  // leading operations taken from a checkpoint
+    std::size_t rows = 0, cols = 0; // of the result
+    double load_ms = 0, ops_ms = 0, export_ms = 0;
+};
+
+// run cfg's operations and write its JSON (and CSV/XLSX) outputs
+RunReport run_script(const Config &cfg, const RunOptions &opt = {});
+
+struct ScriptResult
+{
+    RunReport report;  // load_ms: loading the (shared) input
+    std::string error; // "" on success
+};
+
+// run several scripts at once: each distinct input (path, header and first
+// data rows) is loaded once, then every script runs concurrently on the
+// thread pool against its own copy-on-write view of it. One failing script
+// does not stop the others. Results are in cfgs order.
+std::vector<ScriptResult> run_scripts(const std::vector<Config> &cfgs, const std::string &cache_dir = "");
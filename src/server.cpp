@@ -0,0 +1,218 @@
+#include "server.hpp"
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+#include <stdexcept>
+#include <thread>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <yaml-cpp/yaml.h>
+#include "colors.hpp"
+#include "runner.hpp"
+#include "utils/utils.hpp"
+
+#define FMT_HEADER_ONLY
+#include "fmt/core.h"
+
+namespace fs = std::filesystem;
+
+namespace {
+
+// longest request line accepted; a client past it gets an error and is disconnected
+constexpr std::size_t kMaxRequestBytes = 1 << 20;
+
+double ms_since(std::chrono::steady_clock::time_point t0)
+{
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count();
+}
+
+// "path:mtime:size": changes whenever the file is rewritten
+std::string file_key(const std::string &path)
+{
+    std::error_code ec;
+    const auto mtime = fs::last_write_time(path, ec);
+    const auto size = ec ? 0 : fs::file_size(path, ec);
+    if (ec)
+        throw std::runtime_error("Cannot read " + path + " (" + ec.message() + ")");
+    return path + ":" + std::to_string(mtime.time_since_epoch().count()) + ":" + std::to_string(size);
+}
+
+std::string quoted(const std::string &s)
+{
+    std::string out = "\"";
+    append_json_escaped(out, s);
+    out += '"';
+    return out;
+}
+
+bool send_all(int fd, const std::string &data)
+{
+    std::size_t sent = 0;
+    while (sent < data.size())
+    {
+        const ssize_t n = ::send(fd, data.data() + sent, data.size() - sent, MSG_NOSIGNAL);
+        if (n <= 0) return false;
+        sent += static_cast<std::size_t>(n);
+    }
+    return true;
+}
+
+} // namespace
+
+SeedServer::SeedServer(std::size_t cache_entries, std::string checkpoint_dir)
+    : scripts_(cache_entries), inputs_(cache_entries), checkpoint_dir_(std::move(checkpoint_dir))
+{
+}
+
+std::string SeedServer::handle(const std::string &request)
+{
+    const auto start = std::chrono::steady_clock::now();
+    std::string script_path;
+    try
+    {
+        YAML::Node req;
+        try { req = YAML::Load(request); }
+        catch (const YAML::Exception &e) { throw std::runtime_error(std::string("Invalid request: ") + e.what()); }
+        if (!req.IsMap() || !req["script"])
+            throw std::runtime_error("Invalid request: expected an object with a `script` path");
+        script_path = req["script"].as<std::string>();
+
+        auto t0 = std::chrono::steady_clock::now();
+        bool script_cached = false;
+        Config cfg = scripts_.get(file_key(script_path), [&] { return load_script(script_path); }, script_cached);
+        if (req["input"]) cfg.input_file = req["input"].as<std::string>();
+        if (req["output"]) cfg.output_file = req["output"].as<std::string>();
+        const double script_ms = ms_since(t0);
+
+        t0 = std::chrono::steady_clock::now();
+        bool input_cached = false;
+        const std::string input_key = file_key(cfg.input_file) + ":" + std::to_string(cfg.header_row) + ":" + std::to_string(cfg.first_data_row);
+        const std::shared_ptr<const NitroSheet> base = inputs_.get(input_key, [&] {
+            return std::make_shared<const NitroSheet>(load_input_sheet(cfg.input_file, cfg.header_row, cfg.first_data_row));
+        }, input_cached);
+        const double load_ms = ms_since(t0);
+
+        const RunReport report = run_script(cfg, RunOptions{ base.get(), checkpoint_dir_, false });
+        const double total_ms = ms_since(start);
+
+        if (log_)
+        {
+            std::lock_guard<std::mutex> lock(log_m_);
+            std::cout << GREEN "✔ " RESET << script_path << " -> " << cfg.output_file << ": "
+                      << fmt::format("{:.2f} ms", total_ms) << (input_cached ? "" : " (loaded input)") << "\n" << std::flush;
+        }
+
+        return fmt::format(
+            "{{\"ok\": true, \"rows\": {}, \"cols\": {}, \"operations\": {}, \"script_cached\": {}, \"input_cached\": {}, "
+            "\"script_ms\": {:.3f}, \"load_ms\": {:.3f}, \"ops_ms\": {:.3f}, \"export_ms\": {:.3f}, \"total_ms\": {:.3f}}}",
+            report.rows, report.cols, cfg.operations.size(), script_cached, input_cached,
+            script_ms, load_ms, report.ops_ms, report.export_ms, total_ms
+        );
+    }
+    catch (const std::exception &e)
+    {
+        const double total_ms = ms_since(start);
+        if (log_)
+        {
+            std::lock_guard<std::mutex> lock(log_m_);
+            std::cerr << RED "✘ " << (script_path.empty() ? "request" : script_path) << ": " << e.what() << RESET "\n" << std::flush;
+        }
+        return fmt::format("{{\"ok\": false, \"error\": {}, \"total_ms\": {:.3f}}}", quoted(e.what()), total_ms);
+    }
+}
+
+void SeedServer::serve_client(int fd)
+{
+    std::string pending;
+    char buf[4096];
+    for (;;)
+    {
+        const ssize_t n = ::recv(fd, buf, sizeof buf, 0);
+        if (n <= 0) break;
+        pending.append(buf, static_cast<std::size_t>(n));
+
+        std::size_t eol;
+        while ((eol = pending.find('\n')) != std::string::npos)
+        {
+            std::string line = pending.substr(0, eol);
+            pending.erase(0, eol + 1);
+            if (!line.empty() && line.back() == '\r') line.pop_back();
+            if (line.empty()) continue;
+            if (!send_all(fd, handle(line) + "\n"))
+            {
+                ::close(fd);
+                return;
+            }
+        }
+
+        // what is left is an unfinished line
+        if (pending.size() > kMaxRequestBytes)
+        {
+            send_all(fd, fmt::format("{{\"ok\": false, \"error\": \"Request line longer than {} bytes\", \"total_ms\": 0.000}}\n",
+                                     kMaxRequestBytes));
+            break;
+        }
+    }
+    ::close(fd);
+}
+
+void SeedServer::listen(const std::string &socket_path)
+{
+    sockaddr_un addr{};
+    addr.sun_family = AF_UNIX;
+    if (socket_path.size() >= sizeof addr.sun_path)
+        throw std::runtime_error("Socket path too long: " + socket_path);
+    socket_path.copy(addr.sun_path, socket_path.size());
+
+    // only a stale socket from an earlier run is replaced: never a regular
+    // file, nor a socket another server still accepts connections on
+    struct stat st;
+    if (::lstat(socket_path.c_str(), &st) == 0)
+    {
+        if (!S_ISSOCK(st.st_mode))
+            throw std::runtime_error("Cannot listen on " + socket_path + ": not a socket");
+        const int probe = ::socket(AF_UNIX, SOCK_STREAM, 0);
+        const bool live = probe >= 0 && ::connect(probe, reinterpret_cast<const sockaddr *>(&addr), sizeof addr) == 0;
+        if (probe >= 0) ::close(probe);
+        if (live)
+            throw std::runtime_error("Cannot listen on " + socket_path + ": another server is using it");
+        ::unlink(socket_path.c_str());
+    }
+
+    const int server = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    if (server < 0)
+        throw std::runtime_error("Cannot create socket");
+
+    if (::bind(server, reinterpret_cast<const sockaddr *>(&addr), sizeof addr) < 0 || ::listen(server, SOMAXCONN) < 0)
+    {
+        ::close(server);
+        throw std::runtime_error("Cannot listen on " + socket_path);
+    }
+
+    log_ = true;
+    std::cout << BOLD WHITE "# Listening on " RESET << socket_path << " (one JSON request per line, Ctrl+C to stop)\n\n" << std::flush;
+
+    for (;;)
+    {
+        const int client = ::accept(server, nullptr, nullptr);
+        if (client < 0)
+        {
+            if (errno == EINTR || errno == ECONNABORTED) continue;
+            if (errno == EMFILE || errno == ENFILE || errno == ENOBUFS || errno == ENOMEM)
+            {
+                // out of descriptors or memory: wait for connections to close
+                std::this_thread::sleep_for(std::chrono::milliseconds(100));
+                continue;
+            }
+            const int err = errno;
+            ::close(server);
+            throw std::runtime_error("Cannot accept connections on " + socket_path + " (" + std::strerror(err) + ")");
+        }
+        // one thread per connection only reads and writes: the runs themselves share the pool
+        std::thread([this, client] { serve_client(client); }).detach();
+    }
+}
@@ -0,0 +1,129 @@
+// server.hpp
+#pragma once
+#include <cstdint>
+#include <functional>
+#include <future>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include "config.hpp"
+#include "nitro_sheet.hpp"
+
+// Long-running server mode (--serve).
+//
+// Listens on a Unix domain socket for requests, one JSON object per line:
+//
+//   {"script": "seed.yaml", "input": "master.xlsx", "output": "out/products"}
+//
+// `input` and `output` override the script's own and may be left out. Each
+// request is answered with one JSON line, in order per connection:
+//
+//   {"ok": true, "rows": 120, "cols": 9, "operations": 10, "script_cached": true,
+//    "input_cached": true, "script_ms": 0.01, "load_ms": 0.02, "ops_ms": 1.2,
+//    "export_ms": 0.8, "total_ms": 2.1}
+//   {"ok": false, "error": "...", "total_ms": 0.3}
+//
+// A request line longer than 1 MiB is answered with an error and the
+// connection is closed.
+//
+// Connections are served concurrently and every run shares the global thread
+// pool. Compiled scripts and loaded input sheets are kept in LRU caches keyed
+// by path, modification time and size (inputs also by their header and first
+// data rows), so a request for an unchanged script and workbook skips both
+// the YAML compile and the XLSX parse. Runs work on copy-on-write views of
+// the cached sheets.
+
+// A thread-safe LRU map whose values are computed on a miss. Concurrent
+// misses on one key wait for a single computation; a failed one is not cached.
+template <typename V>
+class LruCache {
+public:
+    explicit LruCache(std::size_t capacity) : capacity_(capacity ? capacity : 1) {}
+
+    // the value for key, from make() on a miss; hit reports which
+    V get(const std::string &key, const std::function<V()> &make, bool &hit)
+    {
+        std::promise<V> promise;
+        std::shared_future<V> value;
+        {
+            std::lock_guard<std::mutex> lock(m_);
+            auto it = index_.find(key);
+            hit = it != index_.end();
+            if (hit)
+            {
+                order_.splice(order_.begin(), order_, it->second);
+                value = it->second->second;
+            }
+            else
+            {
+                value = promise.get_future().share();
+                order_.emplace_front(key, value);
+                index_[key] = order_.begin();
+                while (order_.size() > capacity_)
+                {
+                    index_.erase(order_.back().first);
+                    order_.pop_back();
+                }
+            }
+        }
+        if (hit) return value.get();
+
+        try
+        {
+            promise.set_value(make());
+        }
+        catch (...)
+        {
+            promise.set_exception(std::current_exception());
+            std::lock_guard<std::mutex> lock(m_);
+            if (auto it = index_.find(key); it != index_.end())
+            {
+                order_.erase(it->second);
+                index_.erase(it);
+            }
+        }
+        return value.get();
+    }
+
+    std::size_t size() const
+    {
+        std::lock_guard<std::mutex> lock(m_);
+        return order_.size();
+    }
+
+private:
+    using Entry = std::pair<std::string, std::shared_future<V>>;
+
+    mutable std::mutex m_;
+    std::size_t capacity_;
+    std::list<Entry> order_; // most recently used first
+    std::unordered_map<std::string, typename std::list<Entry>::iterator> index_;
+};
+
+class SeedServer {
+public:
+    // cache_entries: scripts and input sheets kept loaded (each);
+    // checkpoint_dir: as --cache, "" = none
+    explicit SeedServer(std::size_t cache_entries, std::string checkpoint_dir = "");
+
+    // answer one request line; errors are reported in the response, never thrown
+    std::string handle(const std::string &request);
+
+    // serve connections on a Unix domain socket until the process is stopped.
+    // An existing socket file is replaced only if nothing answers on it.
+    // Throws std::runtime_error if the socket cannot be set up (the path is
+    // another kind of file, or a live server owns it) or accept fails for
+    // good; running out of descriptors only pauses accepting.
+    void listen(const std::string &socket_path);
+
+private:
+    void serve_client(int fd);
+
+    LruCache<Config> scripts_;
+    LruCache<std::shared_ptr<const NitroSheet>> inputs_;
+    std::string checkpoint_dir_;
+    bool log_ = false; // print one line per request (set by listen)
+    std::mutex log_m_;
+};
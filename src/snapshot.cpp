@@ -0,0 +1,367 @@
+#include "snapshot.hpp"
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+#include <unordered_set>
+#include "utils/utils.hpp"
+
+namespace fs = std::filesystem;
+
+namespace {
+
+constexpr std::uint64_t kMagic = 0x3150414e53544e4eULL; // "NNTSNAP1"; bump on format changes
+
+enum ColumnKind : std::uint8_t { kEmpty, kPlain, kDict, kList, kTimestamp };
+
+inline std::uint64_t mix64(std::uint64_t x) // splitmix64 finalizer
+{
+    x ^= x >> 30; x *= 0xbf58476d1ce4e5b9ULL;
+    x ^= x >> 27; x *= 0x94d049bb133111ebULL;
+    return x ^ (x >> 31);
+}
+
+std::string hex(std::uint64_t v)
+{
+    static const char digits[] = "0123456789abcdef";
+    std::string out(16, '0');
+    for (int i = 15; i >= 0; --i, v >>= 4) out[i] = digits[v & 15];
+    return out;
+}
+
+// buffered binary output
+struct Writer
+{
+    std::ofstream out;
+    std::string buf;
+
+    void raw(const void *p, std::size_t n)
+    {
+        buf.append(static_cast<const char *>(p), n);
+        if (buf.size() >= (1 << 20)) flush();
+    }
+    void flush()
+    {
+        out.write(buf.data(), static_cast<std::streamsize>(buf.size()));
+        buf.clear();
+    }
+
+    template <typename T> void pod(T v) { raw(&v, sizeof v); }
+
+    template <typename T> void array(const std::vector<T> &v)
+    {
+        pod<std::uint64_t>(v.size());
+        raw(v.data(), v.size() * sizeof(T));
+    }
+
+    void string(const std::string &s)
+    {
+        pod<std::uint32_t>(static_cast<std::uint32_t>(s.size()));
+        raw(s.data(), s.size());
+    }
+
+    // n strings as a length array, then the bytes back to back
+    template <typename Get> void strings(std::size_t n, Get get)
+    {
+        std::vector<std::uint32_t> lens(n);
+        for (std::size_t i = 0; i < n; ++i) lens[i] = static_cast<std::uint32_t>(get(i).size());
+        array(lens);
+        for (std::size_t i = 0; i < n; ++i) raw(get(i).data(), lens[i]);
+    }
+};
+
+// bounds-checked reads over a loaded file; ok turns false on the first overrun
+struct Reader
+{
+    const char *p, *end;
+    bool ok = true;
+
+    bool raw(void *dst, std::size_t n)
+    {
+        if (!ok || static_cast<std::size_t>(end - p) < n) return ok = false;
+        std::memcpy(dst, p, n);
+        p += n;
+        return true;
+    }
+
+    template <typename T> T pod()
+    {
+        T v{};
+        raw(&v, sizeof v);
+        return v;
+    }
+
+    template <typename T> std::vector<T> array()
+    {
+        const std::uint64_t n = pod<std::uint64_t>();
+        if (!ok || n > static_cast<std::size_t>(end - p) / sizeof(T)) { ok = false; return {}; }
+        std::vector<T> v(n);
+        raw(v.data(), n * sizeof(T));
+        return v;
+    }
+
+    std::string string()
+    {
+        const std::uint32_t n = pod<std::uint32_t>();
+        if (!ok || n > static_cast<std::size_t>(end - p)) { ok = false; return {}; }
+        std::string s(p, n);
+        p += n;
+        return s;
+    }
+
+    std::vector<std::string> strings()
+    {
+        const std::vector<std::uint32_t> lens = array<std::uint32_t>();
+        std::vector<std::string> out(lens.size());
+        for (std::size_t i = 0; ok && i < lens.size(); ++i)
+        {
+            if (lens[i] > static_cast<std::size_t>(end - p)) { ok = false; return {}; }
+            out[i].assign(p, lens[i]);
+            p += lens[i];
+        }
+        return out;
+    }
+};
+
+} // namespace
+
+// ----------------------
+// Snapshot files
+// ----------------------
+void write_snapshot(const NitroSheet &sheet, const std::string &path)
+{
+    // unique per writer: concurrent runs of one script may save the same snapshot
+    const std::string tmp = path + "." + hex(random_seed()) + ".tmp";
+    Writer w;
+    w.out.open(tmp, std::ios::binary);
+    if (!w.out.is_open())
+        throw std::runtime_error("Cannot write snapshot: " + tmp);
+
+    w.pod(kMagic);
+    w.pod(sheet.first_row);
+    w.pod(sheet.data_row_start);
+    w.pod(sheet.num_rows);
+    w.pod<std::uint8_t>(sheet.has_sel);
+    w.array(sheet.sel);
+    w.pod<std::uint64_t>(sheet.cols.size());
+
+    for (const Column &col : sheet.cols)
+    {
+        w.string(col.header);
+        if (col.is_dict())
+        {
+            w.pod<std::uint8_t>(kDict);
+            w.strings(col.dict().size(), [&](std::size_t i) -> const std::string & { return col.dict()[i]; });
+            w.array(col.codes());
+        }
+        else if (col.is_list())
+        {
+            w.pod<std::uint8_t>(kList);
+            w.array(col.offsets());
+            w.strings(col.items().size(), [&](std::size_t i) -> const std::string & { return col.items()[i]; });
+        }
+        else if (col.is_timestamp())
+        {
+            w.pod<std::uint8_t>(kTimestamp);
+            w.array(col.timestamps());
+        }
+        else if (col.size() == 0)
+            w.pod<std::uint8_t>(kEmpty);
+        else
+        {
+            w.pod<std::uint8_t>(kPlain);
+            w.strings(col.size(), [&](std::size_t r) -> const std::string & { return col.at(r); });
+        }
+    }
+
+    w.flush();
+    w.out.close();
+    if (!w.out)
+        throw std::runtime_error("Cannot write snapshot: " + tmp);
+
+    std::error_code ec;
+    fs::rename(tmp, path, ec);
+    if (ec)
+        throw std::runtime_error("Cannot write snapshot: " + path + " (" + ec.message() + ")");
+}
+
+bool read_snapshot(const std::string &path, NitroSheet &out)
+{
+    std::ifstream in(path, std::ios::binary | std::ios::ate);
+    if (!in.is_open()) return false;
+    std::string data(static_cast<std::size_t>(in.tellg()), '\0');
+    in.seekg(0);
+    if (!in.read(data.data(), static_cast<std::streamsize>(data.size()))) return false;
+
+    Reader r{ data.data(), data.data() + data.size() };
+    if (r.pod<std::uint64_t>() != kMagic) return false;
+
+    NitroSheet s;
+    s.first_row = r.pod<std::uint32_t>();
+    s.data_row_start = r.pod<std::uint32_t>();
+    s.num_rows = r.pod<std::uint32_t>();
+    s.has_sel = r.pod<std::uint8_t>() != 0;
+    s.sel = r.array<std::uint32_t>();
+    for (std::uint32_t row : s.sel)
+        if (row >= s.num_rows) return false;
+
+    const std::uint64_t cols = r.pod<std::uint64_t>();
+    for (std::uint64_t c = 0; r.ok && c < cols; ++c)
+    {
+        Column col;
+        col.header = r.string();
+        switch (r.pod<std::uint8_t>())
+        {
+        case kEmpty:
+            break;
+        case kPlain:
+            col = Column(std::move(col.header), r.strings());
+            break;
+        case kDict:
+        {
+            std::vector<std::string> dict = r.strings();
+            std::vector<std::uint32_t> codes = r.array<std::uint32_t>();
+            for (std::uint32_t code : codes)
+                if (code >= dict.size()) return false;
+            col.assign_dict(std::move(codes), std::move(dict));
+            break;
+        }
+        case kList:
+        {
+            std::vector<std::uint32_t> offsets = r.array<std::uint32_t>();
+            std::vector<std::string> items = r.strings();
+            if (offsets.empty() || offsets.front() != 0 || offsets.back() != items.size() ||
+                !std::is_sorted(offsets.begin(), offsets.end()))
+                return false;
+            col.assign_list(std::move(offsets), std::move(items));
+            break;
+        }
+        case kTimestamp:
+            col.assign_timestamps(r.array<std::int64_t>());
+            break;
+        default:
+            return false;
+        }
+        s.cols.push_back(std::move(col));
+    }
+
+    if (!r.ok || r.p != r.end) return false;
+    out = std::move(s);
+    return true;
+}
+
+// ----------------------
+// Hashing
+// ----------------------
+std::uint64_t hash_bytes(std::uint64_t h, std::string_view bytes)
+{
+    const char *p = bytes.data();
+    std::size_t n = bytes.size();
+    for (; n >= 8; p += 8, n -= 8)
+    {
+        std::uint64_t w;
+        std::memcpy(&w, p, 8);
+        h = mix64(h ^ w) * 0x9e3779b97f4a7c15ULL;
+    }
+    std::uint64_t tail = 0;
+    std::memcpy(&tail, p, n);
+    return mix64(h ^ tail ^ (static_cast<std::uint64_t>(bytes.size()) << 3));
+}
+
+std::uint64_t hash_file(const std::string &path)
+{
+    std::ifstream in(path, std::ios::binary);
+    if (!in.is_open())
+        throw std::runtime_error("Cannot read " + path);
+
+    std::uint64_t h = 0;
+    std::string chunk(1 << 20, '\0');
+    while (in)
+    {
+        in.read(chunk.data(), static_cast<std::streamsize>(chunk.size()));
+        const auto got = static_cast<std::size_t>(in.gcount());
+        if (got == 0) break;
+        h = hash_bytes(h, std::string_view(chunk.data(), got));
+    }
+    return h;
+}
+
+// ----------------------
+// Operation-prefix checkpoints
+// ----------------------
+CheckpointCache::CheckpointCache(std::string dir, const Config &cfg, const FillClock &clock)
+    : dir_(std::move(dir)), writes_(global_pool())
+{
+    std::error_code ec;
+    fs::create_directories(dir_, ec);
+    if (ec)
+        throw std::runtime_error("Cannot create checkpoint directory " + dir_ + " (" + ec.message() + ")");
+
+    std::uint64_t key = hash_file(cfg.input_file);
+    key = hash_bytes(key, hex(kMagic) + ":" + std::to_string(cfg.header_row) + ":" + std::to_string(cfg.first_data_row));
+    input_tag_ = hex(hash_bytes(key, cfg.script_file)); // scripts sharing a directory prune only their own files
+    keys_.push_back(key);
+
+    for (const OperationPtr &op : cfg.operations)
+    {
+        key = hash_bytes(key, op->canonical);
+        if (op->uses_clock())
+            key = hash_bytes(key, std::to_string(clock.seed) + ":" + std::to_string(clock.now));
+        for (const std::string &file : op->reference_files())
+            key = hash_bytes(key, hex(hash_file(file)));
+        keys_.push_back(key);
+    }
+}
+
+CheckpointCache::~CheckpointCache() = default;
+
+std::string CheckpointCache::path_of(std::size_t prefix) const
+{
+    return (fs::path(dir_) / (input_tag_ + "-" + hex(keys_[prefix]) + ".nsnap")).string();
+}
+
+std::optional<std::size_t> CheckpointCache::restore(NitroSheet &sheet, std::size_t min_prefix) const
+{
+    for (std::size_t k = keys_.size(); k-- > min_prefix; )
+        if (read_snapshot(path_of(k), sheet)) return k;
+    return std::nullopt;
+}
+
+void CheckpointCache::save(std::size_t prefix, const NitroSheet &sheet)
+{
+    if (prefix >= keys_.size()) return;
+    std::string path = path_of(prefix);
+    if (fs::exists(path)) return; // e.g. the prefix this run was restored from
+
+    // the copy shares the columns copy-on-write; later operations detach from it
+    writes_.run([snapshot = sheet, path = std::move(path)] {
+        try
+        {
+            write_snapshot(snapshot, path);
+        }
+        catch (const std::exception &e)
+        {
+            std::cerr << "WARNING: checkpoint skipped: " << e.what() << "\n";
+        }
+    });
+}
+
+void CheckpointCache::finish()
+{
+    writes_.wait();
+
+    std::unordered_set<std::string> current;
+    for (std::size_t k = 0; k < keys_.size(); ++k)
+        current.insert(fs::path(path_of(k)).filename().string());
+
+    std::error_code ec;
+    for (const auto &entry : fs::directory_iterator(dir_, ec))
+    {
+        const std::string name = entry.path().filename().string();
+        if (name.compare(0, input_tag_.size() + 1, input_tag_ + "-") == 0 && !current.count(name) &&
+            entry.path().extension() != ".tmp") // another run's snapshot still being written
+            fs::remove(entry.path(), ec);
+    }
+}
@@ -0,0 +1,64 @@
+// snapshot.hpp
+#pragma once
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "config.hpp"
+#include "nitro_sheet.hpp"
+#include "thread_pool.hpp"
+
+// Binary columnar snapshots of a NitroSheet.
+//
+// Each column is stored in its in-memory encoding: plain cells as one length
+// array plus one byte blob, dictionary columns as their entries plus the code
+// array, list cells as offsets plus items, and timestamps as raw int64s.
+// Loading one is a handful of bulk reads, with no XLSX parsing and no
+// re-encoding. The files are a local cache in native byte order, not an
+// exchange format.
+
+// write atomically (a temporary file renamed into place); throws std::runtime_error
+void write_snapshot(const NitroSheet &sheet, const std::string &path);
+
+// false when the file is missing, truncated or from another format version
+bool read_snapshot(const std::string &path, NitroSheet &out);
+
+// 64-bit content hashes for cache keys (not cryptographic)
+std::uint64_t hash_bytes(std::uint64_t h, std::string_view bytes);
+std::uint64_t hash_file(const std::string &path); // throws std::runtime_error if unreadable
+
+// Operation-prefix checkpoints.
+//
+// Snapshot k holds the sheet after the first k operations of a script (k = 0:
+// the loaded input). Its key chains the input file's content, the header and
+// first data rows and the canonical text of operations 1..k; random fills
+// also chain the run's seed and "now", and lookups the content of the
+// workbook they read. A re-run restores the longest cached prefix and runs
+// only the operations after it. Unless the script fixes both `seed:` and
+// `now:`, a random fill's key changes every run (its dates count back from
+// the current time), so nothing after it is reused.
+class CheckpointCache {
+public:
+    CheckpointCache(std::string dir, const Config &cfg, const FillClock &clock);
+    ~CheckpointCache();
+
+    // load the longest cached prefix of at least min_prefix operations into
+    // sheet and return its length; nullopt if none
+    std::optional<std::size_t> restore(NitroSheet &sheet, std::size_t min_prefix = 0) const;
+
+    // snapshot the sheet after the first `prefix` operations; written in the background
+    void save(std::size_t prefix, const NitroSheet &sheet);
+
+    // wait for pending snapshots, then delete this script's snapshots of this
+    // input that are not on its current chain
+    void finish();
+
+private:
+    std::string path_of(std::size_t prefix) const;
+
+    std::string dir_;
+    std::string input_tag_;            // hex key of the input and script path, prefix of every file name
+    std::vector<std::uint64_t> keys_;  // keys_[k]: sheet after k operations
+    TaskGroup writes_;
+};
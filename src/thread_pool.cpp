@@ -0,0 +1,207 @@
+#include "thread_pool.hpp"
+#include <chrono>
+
+namespace {
+
+// worker identity of the calling thread
+thread_local const ThreadPool *tl_pool = nullptr;
+thread_local std::size_t tl_index = 0;
+
+std::mutex g_pool_m;
+std::unique_ptr<ThreadPool> g_pool;
+
+} // namespace
+
+ThreadPool::ThreadPool(std::size_t threads)
+{
+    if (threads == 0) threads = std::max(1u, std::thread::hardware_concurrency());
+
+    workers_.reserve(threads - 1);
+    for (std::size_t i = 0; i + 1 < threads; ++i)
+        workers_.push_back(std::make_unique<Worker>());
+    for (std::size_t i = 0; i < workers_.size(); ++i)
+        workers_[i]->thread = std::thread([this, i] { worker_loop(i); });
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(sleep_m_);
+        stop_ = true;
+    }
+    sleep_cv_.notify_all();
+    for (auto &w : workers_) w->thread.join();
+}
+
+std::size_t ThreadPool::current_worker() const
+{
+    return tl_pool == this ? tl_index : workers_.size();
+}
+
+void ThreadPool::submit(Task task)
+{
+    if (workers_.empty()) // single-threaded: nobody else would pick it up
+    {
+        run_task(task, 0);
+        return;
+    }
+
+    const std::size_t self = current_worker();
+    Worker &w = self < workers_.size() ? *workers_[self] : shared_;
+    {
+        std::lock_guard<std::mutex> lock(w.m);
+        w.tasks.push_back(std::move(task));
+    }
+    bool helpers;
+    {
+        std::lock_guard<std::mutex> lock(sleep_m_);
+        queued_.fetch_add(1, std::memory_order_relaxed);
+        helpers = helpers_ != 0;
+    }
+    sleep_cv_.notify_one();
+    if (helpers) help_cv_.notify_all();
+}
+
+void ThreadPool::notify_helpers()
+{
+    {
+        std::lock_guard<std::mutex> lock(sleep_m_); // orders the change done() sees before the wait's re-check
+        if (helpers_ == 0) return;
+    }
+    help_cv_.notify_all();
+}
+
+bool ThreadPool::pop_task(std::size_t self, Task &out)
+{
+    auto take = [&](Worker &w, bool newest) {
+        std::lock_guard<std::mutex> lock(w.m);
+        if (w.tasks.empty()) return false;
+        if (newest) { out = std::move(w.tasks.back()); w.tasks.pop_back(); }
+        else        { out = std::move(w.tasks.front()); w.tasks.pop_front(); }
+        queued_.fetch_sub(1, std::memory_order_relaxed);
+        return true;
+    };
+
+    const std::size_t n = workers_.size();
+    if (self < n && take(*workers_[self], true)) return true;
+    if (take(shared_, false)) return true;
+    for (std::size_t k = 1; k <= n; ++k)
+    {
+        const std::size_t victim = (self + k) % n;
+        if (victim == self) continue;
+        if (take(*workers_[victim], false))
+        {
+            (self < n ? *workers_[self] : shared_).steals.fetch_add(1, std::memory_order_relaxed);
+            return true;
+        }
+    }
+    return false;
+}
+
+void ThreadPool::run_task(Task &task, std::size_t self)
+{
+    Worker &w = self < workers_.size() ? *workers_[self] : shared_;
+    const auto t0 = std::chrono::steady_clock::now();
+    task();
+    const auto t1 = std::chrono::steady_clock::now();
+    w.busy_ns.fetch_add(std::chrono::duration_cast<std::chrono::nanoseconds>(t1 - t0).count(), std::memory_order_relaxed);
+    w.done.fetch_add(1, std::memory_order_relaxed);
+}
+
+bool ThreadPool::run_one()
+{
+    const std::size_t self = current_worker();
+    Task task;
+    if (!pop_task(self, task)) return false;
+    run_task(task, self);
+    return true;
+}
+
+void ThreadPool::worker_loop(std::size_t self)
+{
+    tl_pool = this;
+    tl_index = self;
+
+    for (;;)
+    {
+        Task task;
+        if (pop_task(self, task))
+        {
+            run_task(task, self);
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(sleep_m_);
+        sleep_cv_.wait(lock, [&] { return stop_ || queued_.load(std::memory_order_relaxed) > 0; });
+        if (stop_) return;
+    }
+}
+
+std::vector<ThreadPool::WorkerStats> ThreadPool::stats() const
+{
+    std::vector<WorkerStats> out;
+    out.reserve(workers_.size() + 1);
+    auto read = [](const Worker &w) {
+        WorkerStats s;
+        s.busy_ns = w.busy_ns.load(std::memory_order_relaxed);
+        s.tasks = w.done.load(std::memory_order_relaxed);
+        s.steals = w.steals.load(std::memory_order_relaxed);
+        return s;
+    };
+    for (const auto &w : workers_) out.push_back(read(*w));
+    out.push_back(read(shared_));
+    return out;
+}
+
+// ----------------------
+// Task graphs
+// ----------------------
+std::size_t TaskGraph::add(std::function<void()> f, const std::vector<std::size_t> &deps)
+{
+    const std::size_t id = nodes_.size();
+    nodes_.push_back(Node{ std::move(f), {}, 0 });
+    for (std::size_t d : deps)
+    {
+        if (d >= id) continue; // only earlier tasks can be waited on
+        nodes_[d].next.push_back(id);
+        ++nodes_[id].deps;
+    }
+    return id;
+}
+
+void TaskGraph::run(ThreadPool &pool)
+{
+    std::vector<std::atomic<std::size_t>> remaining(nodes_.size());
+    for (std::size_t i = 0; i < nodes_.size(); ++i)
+        remaining[i].store(nodes_[i].deps, std::memory_order_relaxed);
+
+    TaskGroup group(pool);
+    std::function<void(std::size_t)> start = [&](std::size_t id) {
+        group.run([&, id] {
+            nodes_[id].f(); // a throw skips everything that depends on this task
+            for (std::size_t next : nodes_[id].next)
+                if (remaining[next].fetch_sub(1, std::memory_order_acq_rel) == 1) start(next);
+        });
+    };
+
+    for (std::size_t i = 0; i < nodes_.size(); ++i)
+        if (nodes_[i].deps == 0) start(i);
+    group.wait();
+}
+
+// ----------------------
+// Runtime pool
+// ----------------------
+ThreadPool &global_pool()
+{
+    std::lock_guard<std::mutex> lock(g_pool_m);
+    if (!g_pool) g_pool = std::make_unique<ThreadPool>();
+    return *g_pool;
+}
+
+void set_thread_count(std::size_t threads)
+{
+    std::lock_guard<std::mutex> lock(g_pool_m);
+    g_pool.reset();
+    g_pool = std::make_unique<ThreadPool>(threads);
+}
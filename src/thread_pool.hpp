@@ -0,0 +1,200 @@
+// thread_pool.hpp
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Work-stealing thread pool shared by the loader, the operations and the writers.
+//
+// A pool of N threads runs N - 1 workers; a thread waiting on a TaskGroup runs
+// queued tasks too, so ThreadPool(1) runs everything inline on the caller.
+// Each worker owns a deque: it pops its newest task, idle workers steal the
+// oldest task of another worker, and tasks submitted from outside the pool go
+// to a shared queue.
+class ThreadPool {
+public:
+    using Task = std::function<void()>;
+
+    struct WorkerStats {
+        std::uint64_t busy_ns = 0; // time spent running tasks
+        std::uint64_t tasks = 0;
+        std::uint64_t steals = 0;  // tasks taken from another worker's deque
+    };
+
+    explicit ThreadPool(std::size_t threads = 0); // 0: one per hardware thread
+    ~ThreadPool();
+    ThreadPool(const ThreadPool &) = delete;
+    ThreadPool &operator=(const ThreadPool &) = delete;
+
+    std::size_t threads() const { return workers_.size() + 1; }
+
+    void submit(Task task);
+
+    // run one queued task on the calling thread; false if none was found
+    bool run_one();
+
+    // run queued tasks on the calling thread until done() holds, sleeping
+    // while there are none. done() must only turn true before a call to
+    // notify_helpers(), which wakes the sleeping callers to re-check it.
+    template <typename Done>
+    void help_until(Done done);
+    void notify_helpers();
+
+    // one entry per worker thread, then one for non-worker threads helping in TaskGroup::wait
+    std::vector<WorkerStats> stats() const;
+
+    // f(begin, end) over contiguous chunks of [0, n); below min_chunk rows per
+    // chunk (or with one thread) it runs inline. Rethrows the first exception
+    // once every chunk has finished.
+    template <typename F>
+    void parallel_for(std::size_t n, F f, std::size_t min_chunk = 16384);
+
+private:
+    struct Worker {
+        mutable std::mutex m;
+        std::deque<Task> tasks;
+        std::atomic<std::uint64_t> busy_ns{ 0 }, done{ 0 }, steals{ 0 };
+        std::thread thread;
+    };
+
+    bool pop_task(std::size_t self, Task &out);
+    void run_task(Task &task, std::size_t self);
+    void worker_loop(std::size_t self);
+    std::size_t current_worker() const; // index of the calling worker, or workers_.size()
+
+    std::vector<std::unique_ptr<Worker>> workers_;
+    Worker shared_; // tasks from outside the pool; stats of helping threads
+
+    std::mutex sleep_m_;
+    std::condition_variable sleep_cv_; // idle workers
+    std::condition_variable help_cv_;  // threads in help_until
+    std::size_t helpers_ = 0;          // sleeping in help_until (guarded by sleep_m_)
+    std::atomic<std::int64_t> queued_{ 0 };
+    bool stop_ = false;
+};
+
+// Tasks whose completion is awaited together. wait() runs queued tasks while
+// it waits and rethrows the first exception a task threw.
+class TaskGroup {
+public:
+    explicit TaskGroup(ThreadPool &pool) : pool_(pool) {}
+    ~TaskGroup() { drain(); }
+    TaskGroup(const TaskGroup &) = delete;
+    TaskGroup &operator=(const TaskGroup &) = delete;
+
+    template <typename F>
+    void run(F f) {
+        pending_.fetch_add(1, std::memory_order_relaxed);
+        pool_.submit([this, &pool = pool_, f = std::move(f)]() mutable {
+            run_here(f);
+            // the group may be gone once pending_ reaches 0: only the pool is touched after
+            if (pending_.fetch_sub(1, std::memory_order_acq_rel) == 1) pool.notify_helpers();
+        });
+    }
+
+    // run f on the calling thread, recording its exception like a task's
+    template <typename F>
+    void run_here(F &f) {
+        try { f(); }
+        catch (...) {
+            std::lock_guard<std::mutex> lock(error_m_);
+            if (!error_) error_ = std::current_exception();
+        }
+    }
+
+    void wait() {
+        drain();
+        if (error_) {
+            std::exception_ptr e = error_;
+            error_ = nullptr;
+            std::rethrow_exception(e);
+        }
+    }
+
+private:
+    void drain() {
+        pool_.help_until([this] { return pending_.load(std::memory_order_acquire) == 0; });
+    }
+
+    ThreadPool &pool_;
+    std::atomic<std::size_t> pending_{ 0 };
+    std::mutex error_m_;
+    std::exception_ptr error_;
+};
+
+// Tasks with dependencies: a task starts once every task it depends on has
+// finished. Dependencies must be ids returned by earlier add() calls, so the
+// graph is acyclic by construction. If a task throws, tasks depending on it
+// are skipped and run() rethrows after the started tasks finish.
+class TaskGraph {
+public:
+    std::size_t add(std::function<void()> f, const std::vector<std::size_t> &deps = {});
+    std::size_t size() const { return nodes_.size(); }
+    void run(ThreadPool &pool);
+
+private:
+    struct Node {
+        std::function<void()> f;
+        std::vector<std::size_t> next;
+        std::size_t deps = 0;
+    };
+    std::vector<Node> nodes_;
+};
+
+// The runtime's pool, created on first use. set_thread_count() (0 = all
+// hardware threads, 1 = single-threaded) replaces it; call it while no work runs.
+ThreadPool &global_pool();
+void set_thread_count(std::size_t threads);
+
+template <typename Done>
+void ThreadPool::help_until(Done done)
+{
+    while (!done())
+    {
+        if (run_one()) continue;
+
+        std::unique_lock<std::mutex> lock(sleep_m_);
+        ++helpers_;
+        help_cv_.wait(lock, [&] { return done() || queued_.load(std::memory_order_relaxed) > 0; });
+        --helpers_;
+    }
+}
+
+template <typename F>
+void ThreadPool::parallel_for(std::size_t n, F f, std::size_t min_chunk)
+{
+    // a few chunks per thread so idle workers have something to steal
+    const std::size_t chunks = std::min(threads() * 4, std::max<std::size_t>(1, n / std::max<std::size_t>(1, min_chunk)));
+    if (chunks <= 1 || threads() == 1)
+    {
+        f(std::size_t(0), n);
+        return;
+    }
+
+    const std::size_t step = (n + chunks - 1) / chunks;
+    TaskGroup group(*this);
+    for (std::size_t begin = step; begin < n; begin += step)
+    {
+        const std::size_t end = std::min(n, begin + step);
+        group.run([&f, begin, end] { f(begin, end); });
+    }
+    auto first = [&f, step] { f(std::size_t(0), step); };
+    group.run_here(first);
+    group.wait();
+}
+
+// parallel_for on the runtime's pool
+template <typename F>
+inline void parallel_for_chunks(std::size_t n, F f, std::size_t min_chunk = 16384)
+{
+    global_pool().parallel_for(n, std::move(f), min_chunk);
+}
@@ -1,4 +1,7 @@
+#include <algorithm>
+#include <sstream>
 #include "dynamic_placeholder.hpp"
+#include "utils.hpp"
 
 
 std::vector<PlaceholderSpan> scan_placeholders(const std::string &s) {
@@ -31,4 +34,130 @@ std::vector<PlaceholderSpan> scan_placeholders(const std::string &s) {
     }
 
     return spans;
-}
\ No newline at end of file
+}
+
+namespace {
+
+std::string trim_blank(const std::string &s) {
+    size_t start = s.find_first_not_of(" \t");
+    size_t end = s.find_last_not_of(" \t");
+    if (start == std::string::npos) return "";
+    return s.substr(start, end - start + 1);
+}
+
+std::string extract_quoted(const std::string &s) {
+    std::string t = trim_blank(s);
+    if (t.size() >= 2 &&
+        ((t.front() == '\'' && t.back() == '\'') || (t.front() == '"' && t.back() == '"')))
+        return t.substr(1, t.size() - 2);
+    return t;
+}
+
+CmpOp cmp_op_from_string(const std::string &op) {
+    if (op == "==") return CmpOp::Eq;
+    if (op == "!=") return CmpOp::Ne;
+    if (op == ">")  return CmpOp::Gt;
+    if (op == "<")  return CmpOp::Lt;
+    if (op == ">=") return CmpOp::Ge;
+    if (op == "<=") return CmpOp::Le;
+    return CmpOp::None;
+}
+
+// "<col_letters> <op> <value>"
+bool parse_comparison(const std::string &text, Comparison &out) {
+    std::string col_letters, op, value;
+    std::istringstream iss(text);
+    if (!(iss >> col_letters >> op)) return false;
+    std::getline(iss, value);
+    value = extract_quoted(value);
+
+    out.col = col_to_index(col_letters);
+    out.op = cmp_op_from_string(op);
+    out.value_is_number = parse_number(value, out.value_num);
+    out.value = std::move(value);
+    return true;
+}
+
+FillOperand parse_operand(const std::string &res) {
+    FillOperand o;
+    std::string s = trim_blank(extract_quoted(res));
+    if (s.rfind("col ", 0) == 0) {
+        o.is_col = true;
+        o.col = col_to_index(s.substr(4));
+    } else {
+        o.text = std::move(s);
+    }
+    return o;
+}
+
+// "<cond> ? <true> : <false>"; false leaves the placeholder as literal text
+bool parse_ifcol(const std::string &expr, FillSegment &seg) {
+    size_t qmark_pos = expr.find('?');
+    size_t colon_pos = expr.find(':');
+    if (qmark_pos == std::string::npos || colon_pos == std::string::npos) return false;
+
+    std::string cond = trim_blank(expr.substr(0, qmark_pos));
+
+    // split on '||' into groups and each group on '&&'
+    std::vector<std::vector<Comparison>> groups(1);
+    size_t pos = 0;
+    while (true) {
+        size_t and_pos = cond.find("&&", pos);
+        size_t or_pos = cond.find("||", pos);
+        size_t cut = std::min(and_pos, or_pos);
+
+        Comparison c;
+        if (!parse_comparison(cond.substr(pos, cut == std::string::npos ? std::string::npos : cut - pos), c))
+            return false;
+        groups.back().push_back(std::move(c));
+
+        if (cut == std::string::npos) break;
+        if (cut == or_pos) groups.emplace_back();
+        pos = cut + 2;
+    }
+
+    seg.kind = FillSegment::Kind::IfCol;
+    seg.any_of_all = std::move(groups);
+    seg.if_true = parse_operand(expr.substr(qmark_pos + 1, colon_pos - (qmark_pos + 1)));
+    seg.if_false = parse_operand(expr.substr(colon_pos + 1));
+    return true;
+}
+
+} // namespace
+
+std::vector<FillSegment> compile_fill_template(const std::string &s) {
+    std::vector<FillSegment> segs;
+    auto push_literal = [&](std::string text) {
+        if (text.empty()) return;
+        if (!segs.empty() && segs.back().kind == FillSegment::Kind::Literal)
+            segs.back().text += text;
+        else {
+            FillSegment seg;
+            seg.text = std::move(text);
+            segs.push_back(std::move(seg));
+        }
+    };
+
+    std::size_t pos = 0;
+    for (auto &p : scan_placeholders(s)) {
+        push_literal(s.substr(pos, p.start - pos));
+        pos = p.end + 1;
+
+        FillSegment seg;
+        if (p.key.rfind("col ", 0) == 0) {
+            seg.kind = FillSegment::Kind::Col;
+            seg.col = col_to_index(p.key.substr(4));
+            segs.push_back(std::move(seg));
+        }
+        else if (p.key.rfind("ifcol ", 0) == 0) {
+            seg.text = "${" + p.key + "}";
+            if (parse_ifcol(p.key.substr(6), seg))
+                segs.push_back(std::move(seg));
+            else
+                push_literal(std::move(seg.text));
+        }
+        // any other key expands to nothing
+    }
+    push_literal(s.substr(pos));
+    return segs;
+}
@@ -8,4 +8,37 @@ struct PlaceholderSpan {
     std::string key;
 };
 
-std::vector<PlaceholderSpan> scan_placeholders(const std::string &s);
\ No newline at end of file
+std::vector<PlaceholderSpan> scan_placeholders(const std::string &s);
+
+// ---- compiled fill templates ----
+// "${col X}" and "${ifcol A == 'v' && B > 3 ? 'yes' : col C}" are parsed once per
+// operation instead of once per row.
+
+enum class CmpOp { Eq, Ne, Gt, Lt, Ge, Le, None }; // None: unknown operator, never true
+
+struct Comparison {
+    std::size_t col = 0;          // 0-based column compared
+    CmpOp op = CmpOp::Eq;
+    std::string value;            // right-hand side, unquoted
+    bool value_is_number = false;
+    double value_num = 0.0;
+};
+
+// a branch of an ifcol: either literal text or a column reference
+struct FillOperand {
+    bool is_col = false;
+    std::size_t col = 0;
+    std::string text;
+};
+
+struct FillSegment {
+    enum class Kind { Literal, Col, IfCol } kind = Kind::Literal;
+    std::string text;                                // Literal text, or the raw "${...}" of an ifcol
+    std::size_t col = 0;                             // Col
+    std::vector<std::vector<Comparison>> any_of_all; // IfCol: '||' of '&&' groups
+    FillOperand if_true, if_false;
+};
+
+// split a fill template into literal text and placeholders; malformed ifcol
+// placeholders stay literal, unknown keys expand to nothing
+std::vector<FillSegment> compile_fill_template(const std::string &s);
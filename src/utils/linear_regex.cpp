@@ -0,0 +1,532 @@
+#include "linear_regex.hpp"
+#include <algorithm>
+#include <stdexcept>
+
+
+struct LinearRegex::Node {
+    enum class Kind { Empty, Char, Any, Class, Begin, End, Cat, Alt, Repeat, Group };
+
+    Kind kind = Kind::Empty;
+    uint8_t c = 0;
+    uint32_t cls = 0;
+    int min = 0, max = -1;  // Repeat; max -1 = unbounded
+    bool greedy = true;
+    uint32_t group = 0;     // Group; 0 = non-capturing
+    std::vector<Node> kids;
+};
+
+namespace {
+
+using Node = LinearRegex::Node;
+using ByteSet = std::vector<uint64_t>; // 4 x 64 bits
+
+constexpr int kMaxRepeat = 1000;
+constexpr size_t kMaxProgram = 100000;
+
+void add_range(ByteSet &set, unsigned lo, unsigned hi) {
+    for (unsigned b = lo; b <= hi; ++b) set[b >> 6] |= uint64_t(1) << (b & 63);
+}
+
+// \d \w \s and their negations
+bool add_class_escape(ByteSet &set, char e) {
+    ByteSet tmp(4, 0);
+    switch (e) {
+        case 'd': case 'D': add_range(tmp, '0', '9'); break;
+        case 'w': case 'W': add_range(tmp, 'a', 'z'); add_range(tmp, 'A', 'Z'); add_range(tmp, '0', '9'); add_range(tmp, '_', '_'); break;
+        case 's': case 'S': for (char c : std::string(" \t\n\r\f\v")) add_range(tmp, uint8_t(c), uint8_t(c)); break;
+        default: return false;
+    }
+    const bool negate = e == 'D' || e == 'W' || e == 'S';
+    for (int w = 0; w < 4; ++w) set[w] |= negate ? ~tmp[w] : tmp[w];
+    return true;
+}
+
+char escaped_char(char e) {
+    switch (e) {
+        case 'n': return '\n';
+        case 't': return '\t';
+        case 'r': return '\r';
+        case 'f': return '\f';
+        case 'v': return '\v';
+        case '0': return '\0';
+        default: return e;
+    }
+}
+
+struct Parser {
+    const std::string &p;
+    std::vector<ByteSet> &classes;
+    size_t i = 0;
+    uint32_t groups = 0;
+
+    [[noreturn]] void fail(const std::string &what) const {
+        throw std::runtime_error("regex: " + what + " at offset " + std::to_string(i) + " in \"" + p + "\"");
+    }
+
+    bool more() const { return i < p.size(); }
+    bool eat(char c) { if (more() && p[i] == c) { ++i; return true; } return false; }
+
+    Node parse() {
+        Node n = alt();
+        if (more()) fail("unmatched ')'");
+        return n;
+    }
+
+    Node alt() {
+        Node first = cat();
+        if (!more() || p[i] != '|') return first;
+        Node a;
+        a.kind = Node::Kind::Alt;
+        a.kids.push_back(std::move(first));
+        while (eat('|')) a.kids.push_back(cat());
+        return a;
+    }
+
+    Node cat() {
+        Node c;
+        c.kind = Node::Kind::Cat;
+        while (more() && p[i] != '|' && p[i] != ')') c.kids.push_back(repeat());
+        return c;
+    }
+
+    // {n}, {n,}, {n,m}; false (nothing consumed) if this is not a counted repeat
+    bool counted(int &min, int &max) {
+        size_t j = i + 1;
+        auto number = [&](int &out) {
+            size_t start = j;
+            long v = 0;
+            while (j < p.size() && p[j] >= '0' && p[j] <= '9') v = std::min<long>(v * 10 + (p[j++] - '0'), kMaxRepeat + 1);
+            out = static_cast<int>(v);
+            return j > start;
+        };
+        if (!number(min)) return false;
+        max = min;
+        if (j < p.size() && p[j] == ',') {
+            ++j;
+            if (!number(max)) max = -1;
+        }
+        if (j >= p.size() || p[j] != '}') return false;
+        i = j + 1;
+        return true;
+    }
+
+    Node repeat() {
+        Node a = atom();
+        while (more()) {
+            int min = 0, max = -1;
+            if (p[i] == '*') { ++i; }
+            else if (p[i] == '+') { ++i; min = 1; }
+            else if (p[i] == '?') { ++i; max = 1; }
+            else if (p[i] == '{' && counted(min, max)) {
+                if (min > kMaxRepeat || max > kMaxRepeat) fail("repeat count above " + std::to_string(kMaxRepeat));
+                if (max != -1 && max < min) fail("bad repeat range");
+            }
+            else break;
+
+            Node r;
+            r.kind = Node::Kind::Repeat;
+            r.min = min;
+            r.max = max;
+            r.greedy = !eat('?');
+            r.kids.push_back(std::move(a));
+            a = std::move(r);
+        }
+        return a;
+    }
+
+    Node atom() {
+        Node n;
+        const char c = p[i++];
+        switch (c) {
+            case '(':
+                n.kind = Node::Kind::Group;
+                if (p.compare(i, 2, "?:") == 0) i += 2;
+                else n.group = ++groups;
+                n.kids.push_back(alt());
+                if (!eat(')')) fail("missing ')'");
+                return n;
+            case ')': fail("unmatched ')'");
+            case '*': case '+': case '?': --i; fail("nothing to repeat");
+            case '.': n.kind = Node::Kind::Any; return n;
+            case '^': n.kind = Node::Kind::Begin; return n;
+            case '$': n.kind = Node::Kind::End; return n;
+            case '[': return char_class();
+            case '\\': {
+                if (!more()) fail("trailing '\\'");
+                const char e = p[i++];
+                ByteSet set(4, 0);
+                if (add_class_escape(set, e)) return make_class(std::move(set));
+                if (e >= '1' && e <= '9') { --i; fail("backreferences are not supported"); }
+                if ((e >= 'a' && e <= 'z') || (e >= 'A' && e <= 'Z'))
+                    if (std::string("ntrfv").find(e) == std::string::npos) { --i; fail(std::string("unsupported escape \\") + e); }
+                n.kind = Node::Kind::Char;
+                n.c = static_cast<uint8_t>(escaped_char(e));
+                return n;
+            }
+            default:
+                n.kind = Node::Kind::Char;
+                n.c = static_cast<uint8_t>(c);
+                return n;
+        }
+    }
+
+    Node make_class(ByteSet set) {
+        Node n;
+        n.kind = Node::Kind::Class;
+        n.cls = static_cast<uint32_t>(classes.size());
+        classes.push_back(std::move(set));
+        return n;
+    }
+
+    Node char_class() {
+        ByteSet set(4, 0);
+        const bool negate = eat('^');
+        bool first = true;
+        while (true) {
+            if (!more()) fail("missing ']'");
+            char c = p[i++];
+            if (c == ']' && !first) break;
+            first = false;
+
+            if (c == '\\') {
+                if (!more()) fail("trailing '\\'");
+                const char e = p[i++];
+                if (add_class_escape(set, e)) continue;
+                c = escaped_char(e);
+            }
+
+            if (i + 1 < p.size() && p[i] == '-' && p[i + 1] != ']') {
+                ++i;
+                char hi = p[i++];
+                if (hi == '\\') {
+                    if (!more()) fail("trailing '\\'");
+                    hi = escaped_char(p[i++]);
+                }
+                if (uint8_t(hi) < uint8_t(c)) fail("bad class range");
+                add_range(set, uint8_t(c), uint8_t(hi));
+            }
+            else add_range(set, uint8_t(c), uint8_t(c));
+        }
+        if (negate)
+            for (auto &w : set) w = ~w;
+        return make_class(std::move(set));
+    }
+};
+
+// Literal analysis for the prefilter: `exact` when the node only matches
+// the string s; `best` is the longest literal every match contains.
+struct LiteralInfo {
+    bool exact = false;
+    std::string s;
+    std::string best;
+};
+
+const std::string &longer(const std::string &a, const std::string &b) { return b.size() > a.size() ? b : a; }
+
+LiteralInfo literals(const Node &n) {
+    using Kind = Node::Kind;
+    LiteralInfo out;
+    switch (n.kind) {
+        case Kind::Char:
+            out.exact = true;
+            out.s = out.best = std::string(1, char(n.c));
+            return out;
+        case Kind::Empty: case Kind::Begin: case Kind::End:
+            out.exact = true;
+            return out;
+        case Kind::Any: case Kind::Class:
+            return out;
+        case Kind::Group:
+            return literals(n.kids[0]);
+        case Kind::Cat: {
+            std::string run;
+            out.exact = true;
+            for (const auto &k : n.kids) {
+                LiteralInfo l = literals(k);
+                if (l.exact) { run += l.s; continue; }
+                out.exact = false;
+                out.best = longer(out.best, run);
+                out.best = longer(out.best, l.best);
+                run.clear();
+            }
+            if (out.exact) out.s = run;
+            out.best = longer(out.best, run);
+            return out;
+        }
+        case Kind::Alt: {
+            LiteralInfo first = literals(n.kids[0]);
+            for (size_t k = 1; k < n.kids.size(); ++k) {
+                LiteralInfo l = literals(n.kids[k]);
+                if (!l.exact || !first.exact || l.s != first.s) return out;
+            }
+            return first;
+        }
+        case Kind::Repeat: {
+            if (n.min == 0) return out;
+            LiteralInfo l = literals(n.kids[0]);
+            if (!l.exact) { out.best = l.best; return out; }
+            std::string rep;
+            for (int k = 0; k < n.min; ++k) rep += l.s;
+            out.exact = n.min == n.max;
+            if (out.exact) out.s = rep;
+            out.best = rep;
+            return out;
+        }
+    }
+    return out;
+}
+
+} // namespace
+
+LinearRegex::LinearRegex(const std::string &pattern) {
+    Parser parser{ pattern, classes_ };
+    Node root = parser.parse();
+    groups_ = parser.groups;
+
+    // Save 0, <pattern>, Save 1, Match
+    emit({ Op::Save, 0, 0, 0 });
+    compile(root);
+    emit({ Op::Save, 0, 1, 0 });
+    emit({ Op::Match });
+
+    LiteralInfo lit = literals(root);
+    required_ = lit.exact ? lit.s : lit.best;
+    anchored_ = prog_.size() > 1 && prog_[1].op == Op::Begin;
+
+    // bytes a match can start with; unusable if the pattern can match empty
+    skip_ = true;
+    std::vector<uint32_t> todo{ 0 };
+    std::vector<char> seen(prog_.size(), 0);
+    while (!todo.empty() && skip_) {
+        const uint32_t pc = todo.back();
+        todo.pop_back();
+        if (seen[pc]) continue;
+        seen[pc] = 1;
+        const Inst &in = prog_[pc];
+        switch (in.op) {
+            case Op::Char:  add_range(first_, in.c, in.c); break;
+            case Op::Any:   add_range(first_, 0, 255); first_['\n' >> 6] &= ~(uint64_t(1) << ('\n' & 63)); break;
+            case Op::Class: for (int w = 0; w < 4; ++w) first_[w] |= classes_[in.x][w]; break;
+            case Op::Jmp:   todo.push_back(in.x); break;
+            case Op::Split: todo.push_back(in.x); todo.push_back(in.y); break;
+            case Op::Save: case Op::Begin: todo.push_back(pc + 1); break;
+            case Op::End: case Op::Match: skip_ = false; break;
+        }
+    }
+}
+
+void LinearRegex::compile(const Node &n) {
+    using Kind = Node::Kind;
+    if (prog_.size() > kMaxProgram) throw std::runtime_error("regex: pattern too large");
+
+    switch (n.kind) {
+        case Kind::Empty: break;
+        case Kind::Char:  emit({ Op::Char, n.c }); break;
+        case Kind::Any:   emit({ Op::Any }); break;
+        case Kind::Class: emit({ Op::Class, 0, n.cls }); break;
+        case Kind::Begin: emit({ Op::Begin }); break;
+        case Kind::End:   emit({ Op::End }); break;
+        case Kind::Cat:
+            for (const auto &k : n.kids) compile(k);
+            break;
+        case Kind::Group:
+            if (n.group) emit({ Op::Save, 0, 2 * n.group });
+            compile(n.kids[0]);
+            if (n.group) emit({ Op::Save, 0, 2 * n.group + 1 });
+            break;
+        case Kind::Alt: {
+            // Split L1, next; L1: kid; Jmp end; next: ...
+            std::vector<uint32_t> jumps;
+            for (size_t k = 0; k + 1 < n.kids.size(); ++k) {
+                const uint32_t split = emit({ Op::Split });
+                prog_[split].x = split + 1;
+                compile(n.kids[k]);
+                jumps.push_back(emit({ Op::Jmp }));
+                prog_[split].y = static_cast<uint32_t>(prog_.size());
+            }
+            compile(n.kids.back());
+            for (auto j : jumps) prog_[j].x = static_cast<uint32_t>(prog_.size());
+            break;
+        }
+        case Kind::Repeat: {
+            const Node &kid = n.kids[0];
+            for (int k = 0; k < n.min; ++k) compile(kid);
+
+            auto split_to = [&](uint32_t split, uint32_t body, uint32_t exit) {
+                prog_[split].x = n.greedy ? body : exit;
+                prog_[split].y = n.greedy ? exit : body;
+            };
+
+            if (n.max == -1) { // L1: Split L2, L3; L2: kid; Jmp L1; L3:
+                const uint32_t split = emit({ Op::Split });
+                compile(kid);
+                emit({ Op::Jmp, 0, split });
+                split_to(split, split + 1, static_cast<uint32_t>(prog_.size()));
+            }
+            else {
+                std::vector<uint32_t> splits;
+                for (int k = n.min; k < n.max; ++k) {
+                    splits.push_back(emit({ Op::Split }));
+                    compile(kid);
+                }
+                for (auto s : splits) split_to(s, s + 1, static_cast<uint32_t>(prog_.size()));
+            }
+            break;
+        }
+    }
+}
+
+// Follow non-consuming instructions from pc, in priority order, adding each
+// reachable consuming instruction to `list` with the captures in scratch.tmp.
+void LinearRegex::add_thread(int list, uint32_t pc0, size_t sp, size_t len, RegexScratch &scratch) const {
+    const size_t ncap = 2 * (groups_ + 1);
+    auto &sparse = scratch.sparse[list];
+    auto &dense = scratch.dense[list];
+    size_t &size = scratch.size[list];
+    std::vector<int> &caps = scratch.tmp;
+    auto &stack = scratch.stack;
+
+    // frame: pc << 1 (explore) or slot << 33 | old << 1 | 1 (restore a capture)
+    stack.clear();
+    stack.push_back(uint64_t(pc0) << 1);
+    while (!stack.empty()) {
+        const uint64_t f = stack.back();
+        stack.pop_back();
+        if (f & 1) {
+            caps[f >> 33] = static_cast<int>(static_cast<uint32_t>(f >> 1));
+            continue;
+        }
+
+        const uint32_t pc = static_cast<uint32_t>(f >> 1);
+        if (sparse[pc] < size && dense[sparse[pc]] == pc) continue; // already on the list
+        sparse[pc] = static_cast<uint32_t>(size);
+        dense[size++] = pc;
+
+        const Inst &in = prog_[pc];
+        switch (in.op) {
+            case Op::Jmp:
+                stack.push_back(uint64_t(in.x) << 1);
+                break;
+            case Op::Split:
+                stack.push_back(uint64_t(in.y) << 1);
+                stack.push_back(uint64_t(in.x) << 1);
+                break;
+            case Op::Save:
+                if (in.x < ncap) {
+                    stack.push_back((uint64_t(in.x) << 33) | (uint64_t(static_cast<uint32_t>(caps[in.x])) << 1) | 1);
+                    caps[in.x] = static_cast<int>(sp);
+                }
+                stack.push_back(uint64_t(pc + 1) << 1);
+                break;
+            case Op::Begin:
+                if (sp == 0) stack.push_back(uint64_t(pc + 1) << 1);
+                break;
+            case Op::End:
+                if (sp == len) stack.push_back(uint64_t(pc + 1) << 1);
+                break;
+            default: // consuming instruction or Match: park the thread
+                std::copy(caps.begin(), caps.end(), scratch.caps[list].begin() + pc * ncap);
+                break;
+        }
+    }
+}
+
+bool LinearRegex::search(std::string_view s, size_t from, std::vector<int> &out, RegexScratch &scratch) const {
+    const size_t ncap = 2 * (groups_ + 1);
+    const size_t len = s.size();
+    for (int l = 0; l < 2; ++l) {
+        scratch.sparse[l].resize(prog_.size());
+        scratch.dense[l].resize(prog_.size());
+        scratch.caps[l].resize(prog_.size() * ncap);
+        scratch.size[l] = 0;
+    }
+
+    int cur = 0, nxt = 1;
+    bool matched = false;
+
+    for (size_t sp = from; ; ++sp) {
+        if (skip_ && !matched && scratch.size[cur] == 0) {
+            // nothing in flight: jump to the next byte that can start a match
+            while (sp < len && !((first_[uint8_t(s[sp]) >> 6] >> (uint8_t(s[sp]) & 63)) & 1)) ++sp;
+            if (sp == len) break;
+        }
+        if (!matched && (!anchored_ || sp == 0)) {
+            scratch.tmp.assign(ncap, -1);
+            add_thread(cur, 0, sp, len, scratch);
+        }
+        if (scratch.size[cur] == 0) break;
+
+        for (size_t k = 0; k < scratch.size[cur]; ++k) {
+            const uint32_t pc = scratch.dense[cur][k];
+            const Inst &in = prog_[pc];
+            const int *tc = scratch.caps[cur].data() + pc * ncap;
+
+            bool step = false;
+            switch (in.op) {
+                case Op::Char:  step = sp < len && uint8_t(s[sp]) == in.c; break;
+                case Op::Any:   step = sp < len && s[sp] != '\n'; break;
+                case Op::Class: step = sp < len && ((classes_[in.x][uint8_t(s[sp]) >> 6] >> (uint8_t(s[sp]) & 63)) & 1); break;
+                case Op::Match:
+                    matched = true;
+                    out.assign(tc, tc + ncap);
+                    k = scratch.size[cur]; // lower-priority threads lose
+                    continue;
+                default: break;
+            }
+            if (step) {
+                scratch.tmp.assign(tc, tc + ncap);
+                add_thread(nxt, pc + 1, sp + 1, len, scratch);
+            }
+        }
+
+        std::swap(cur, nxt);
+        scratch.size[nxt] = 0;
+        if (sp >= len) break;
+    }
+
+    // threads still alive after the text ends were handled in the last step
+    return matched;
+}
+
+bool LinearRegex::replace_all(std::string_view s, std::string_view repl, std::string &out, RegexScratch &scratch) const {
+    if (!required_.empty() && s.find(required_) == std::string_view::npos)
+        return false; // prefilter: no match possible
+
+    std::vector<int> &caps = scratch.match;
+    std::string result;
+    size_t pos = 0, last = 0;
+    bool any = false;
+
+    while (pos <= s.size() && search(s, pos, caps, scratch)) {
+        any = true;
+        const size_t m0 = caps[0], m1 = caps[1];
+        result.append(s.substr(last, m0 - last));
+
+        for (size_t i = 0; i < repl.size(); ++i) {
+            const char c = repl[i];
+            if (c == '$' && i + 1 < repl.size()) {
+                const char d = repl[i + 1];
+                if (d == '$') { result += '$'; ++i; continue; }
+                if (d >= '0' && d <= '9') {
+                    const size_t g = d - '0';
+                    if (g <= groups_ && caps[2 * g] >= 0)
+                        result.append(s.substr(caps[2 * g], caps[2 * g + 1] - caps[2 * g]));
+                    ++i;
+                    continue;
+                }
+            }
+            result += c;
+        }
+
+        if (m1 == m0) { // empty match: copy one byte and move on
+            if (m1 < s.size()) result += s[m1];
+            last = pos = m1 + 1;
+        }
+        else last = pos = m1;
+    }
+
+    if (!any) return false;
+    if (last < s.size()) result.append(s.substr(last));
+    out = std::move(result);
+    return true;
+}
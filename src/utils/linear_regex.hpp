@@ -0,0 +1,65 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Linear-time regular expressions for cell cleanup.
+//
+// The pattern is compiled once into a Thompson NFA program and run as a
+// Pike VM, so matching is O(pattern x text) with no backtracking blow-up.
+// Matching is byte based (UTF-8 bytes are literals; '.' and classes see
+// single bytes) with leftmost-first (Perl-like) semantics.
+//
+// Syntax: literals, '.', [...] / [^...] classes with ranges, \d \w \s \D \W \S,
+// escapes (\. \\ \t \n ...), groups (...) and (?:...), alternation |,
+// quantifiers * + ? {n} {n,} {n,m} (append ? for lazy), anchors ^ $.
+
+// per-thread buffers reused across searches
+struct RegexScratch {
+    std::vector<uint32_t> sparse[2], dense[2];
+    std::vector<int> caps[2];
+    std::vector<int> tmp, match;
+    std::vector<uint64_t> stack;
+    size_t size[2] = { 0, 0 };
+};
+
+class LinearRegex {
+public:
+    explicit LinearRegex(const std::string &pattern); // throws std::runtime_error on bad syntax
+
+    // leftmost-first match starting at or after `from`; caps gets 2 * (groups + 1)
+    // offsets (-1 for groups that did not take part)
+    bool search(std::string_view s, size_t from, std::vector<int> &caps, RegexScratch &scratch) const;
+
+    // replace every non-overlapping match; repl may use $0..$9 and $$.
+    // Returns false (out untouched) when nothing matched.
+    bool replace_all(std::string_view s, std::string_view repl, std::string &out, RegexScratch &scratch) const;
+
+    // a literal every match contains ("" if none): cells without it cannot match
+    const std::string &required_literal() const { return required_; }
+
+    size_t groups() const { return groups_; }
+
+    struct Node; // parsed pattern (see linear_regex.cpp)
+
+private:
+    enum class Op : uint8_t { Char, Any, Class, Split, Jmp, Save, Begin, End, Match };
+    struct Inst {
+        Op op;
+        uint8_t c = 0;
+        uint32_t x = 0, y = 0; // Split/Jmp targets, Save slot, Class index
+    };
+
+    void compile(const Node &n);
+    uint32_t emit(Inst i) { prog_.push_back(i); return static_cast<uint32_t>(prog_.size() - 1); }
+    void add_thread(int list, uint32_t pc, size_t sp, size_t len, RegexScratch &scratch) const;
+
+    std::vector<Inst> prog_;
+    std::vector<std::vector<uint64_t>> classes_; // 256-bit sets
+    size_t groups_ = 0;
+    std::string required_;
+    bool anchored_ = false; // starts with ^
+    bool skip_ = false;     // every match starts with a byte in first_
+    std::vector<uint64_t> first_ = std::vector<uint64_t>(4, 0);
+};
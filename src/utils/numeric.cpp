@@ -0,0 +1,122 @@
+#include "numeric.hpp"
+#include <charconv>
+#include <cmath>
+#include <cstdlib>
+
+static inline bool is_digit(char c) { return c >= '0' && c <= '9'; }
+
+static inline bool is_blank(char c) { return c == ' ' || c == '\t' || c == '\r' || c == '\n'; }
+
+bool parse_plain_integer(std::string_view s, int64_t &out)
+{
+    size_t i = (!s.empty() && s[0] == '-') ? 1 : 0;
+    const size_t digits = s.size() - i;
+    if (digits == 0 || digits > 18) return false;
+
+    int64_t v = 0;
+    for (; i < s.size(); ++i)
+    {
+        if (!is_digit(s[i])) return false;
+        v = v * 10 + (s[i] - '0');
+    }
+    out = s[0] == '-' ? -v : v;
+    return true;
+}
+
+bool parse_number(std::string_view s, double &out)
+{
+    size_t b = 0, e = s.size();
+    while (b < e && is_blank(s[b])) ++b;
+    while (e > b && is_blank(s[e - 1])) --e;
+    if (b < e && s[b] == '+' && (e - b < 2 || s[b + 1] != '-')) ++b;
+    if (b == e) return false;
+    s = s.substr(b, e - b);
+
+    // most numeric cells are small integers: exact in a double, no from_chars needed
+    int64_t i;
+    if (s.size() <= 16 && parse_plain_integer(s, i))
+    {
+        out = static_cast<double>(i);
+        return true;
+    }
+
+    double v;
+    auto [end, ec] = std::from_chars(s.data(), s.data() + s.size(), v);
+    if (ec == std::errc::result_out_of_range && end == s.data() + s.size())
+    {
+        // rare: let strtod pick +-inf or 0 like before
+        out = std::strtod(std::string(s).c_str(), nullptr);
+        return true;
+    }
+    if (ec != std::errc() || end != s.data() + s.size()) return false;
+    out = v;
+    return true;
+}
+
+bool is_json_number(std::string_view s)
+{
+    size_t i = 0;
+    const size_t n = s.size();
+    if (i < n && s[i] == '-') ++i;
+
+    if (i >= n || !is_digit(s[i])) return false;
+    if (s[i] == '0') ++i;
+    else while (i < n && is_digit(s[i])) ++i;
+
+    if (i < n && s[i] == '.')
+    {
+        ++i;
+        if (i >= n || !is_digit(s[i])) return false;
+        while (i < n && is_digit(s[i])) ++i;
+    }
+
+    if (i < n && (s[i] == 'e' || s[i] == 'E'))
+    {
+        ++i;
+        if (i < n && (s[i] == '+' || s[i] == '-')) ++i;
+        if (i >= n || !is_digit(s[i])) return false;
+        while (i < n && is_digit(s[i])) ++i;
+    }
+
+    return i == n;
+}
+
+void append_number(std::string &out, double v)
+{
+    char buf[400]; // fixed notation of DBL_MAX is 309 digits
+    auto [end, ec] = std::to_chars(buf, buf + sizeof(buf), v, std::chars_format::fixed);
+    if (ec != std::errc()) end = std::to_chars(buf, buf + sizeof(buf), v).ptr;
+    out.append(buf, end);
+
+    if (std::isfinite(v) && std::string_view(buf, end - buf).find('.') == std::string_view::npos)
+        out += ".0";
+}
+
+std::string format_number(double v)
+{
+    std::string out;
+    append_number(out, v);
+    return out;
+}
+
+std::string_view clean_number_view(std::string_view s)
+{
+    // only plain decimals are touched
+    size_t i = (!s.empty() && s[0] == '-') ? 1 : 0;
+    const size_t int_begin = i;
+    while (i < s.size() && is_digit(s[i])) ++i;
+    if (i == int_begin || i >= s.size() || s[i] != '.') return s;
+    const size_t dot = i++;
+    while (i < s.size() && is_digit(s[i])) ++i;
+    if (i != s.size()) return s;
+
+    size_t e = s.size();
+    while (e > dot + 2 && s[e - 1] == '0') --e; // keep one digit after the dot
+    if (e == dot + 1) e = dot;                  // "3." -> "3"
+    return s.substr(0, e);
+}
+
+std::string to_clean_number(const std::string &s)
+{
+    return std::string(clean_number_view(s));
+}
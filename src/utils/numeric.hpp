@@ -0,0 +1,27 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+// Numeric cells: one parser/formatter pair built on std::from_chars and
+// std::to_chars, shared by the operations and the writers. Nothing here
+// throws, and only the append_* functions allocate (into the caller's buffer).
+
+// parse a whole cell as a number (surrounding blanks and a leading '+' allowed);
+// false if it is empty or has trailing junk
+bool parse_number(std::string_view s, double &out);
+
+// fast path for "-?[0-9]{1,18}" cells; false for anything else
+bool parse_plain_integer(std::string_view s, int64_t &out);
+
+// true when s is a JSON number literal: -?(0|[1-9][0-9]*)(.[0-9]+)?([eE][+-]?[0-9]+)?
+bool is_json_number(std::string_view s);
+
+// shortest decimal that reads back as v; integral values keep a ".0"
+void append_number(std::string &out, double v);
+std::string format_number(double v);
+
+// a plain decimal ("-?[0-9]+.[0-9]*") without redundant trailing zeros:
+// "1.50" -> "1.5", "2.00" -> "2.0", "3." -> "3"; other text is returned whole
+std::string_view clean_number_view(std::string_view s);
+std::string to_clean_number(const std::string &s);
@@ -1,5 +1,8 @@
 #include <random>
 #include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <stdexcept>
 #include "utils.hpp"
 #include <iostream>
 #include <string>
@@ -81,169 +84,382 @@ std::string index_to_col(size_t index)
     return letters;
 }
 
-std::string to_clean_number(const std::string &s)
+// Howard Hinnant's days_from_civil
+int64_t days_from_civil(int64_t y, unsigned m, unsigned d)
 {
-    // Fast check: must contain a dot
-    if (s.find('.') == std::string::npos)
-        return s;
+    y -= m <= 2;
+    const int64_t era = (y >= 0 ? y : y - 399) / 400;
+    const unsigned yoe = static_cast<unsigned>(y - era * 400);
+    const unsigned doy = (153 * (m + (m > 2 ? -3 : 9)) + 2) / 5 + d - 1;
+    const unsigned doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+    return era * 146097 + static_cast<int64_t>(doe) - 719468;
+}
 
-    std::string out = s;
+bool parse_datetime_epoch(const std::string &s, int64_t &out)
+{
+    size_t i = 0;
+    const size_t n = s.size();
+    while (i < n && s[i] == ' ') ++i;
 
-    // Strip trailing zeros
-    while (!out.empty() && out.back() == '0' && out[out.size() - 2] != '.')
-        out.pop_back();
+    auto read_digits = [&](size_t count, unsigned &v) -> bool {
+        v = 0;
+        for (size_t k = 0; k < count; ++k, ++i)
+        {
+            if (i >= n || s[i] < '0' || s[i] > '9') return false;
+            v = v * 10 + unsigned(s[i] - '0');
+        }
+        return true;
+    };
+
+    unsigned y, mo, d;
+    size_t save = i;
+    if (read_digits(4, y) && i < n && (s[i] == '-' || s[i] == '/'))
+    {
+        char sep = s[i++];
+        if (!read_digits(2, mo) || i >= n || s[i++] != sep || !read_digits(2, d))
+            return false;
+        if (mo < 1 || mo > 12 || d < 1) return false;
+        static const unsigned kDaysIn[12] = { 31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31 };
+        const bool leap = (y % 4 == 0 && y % 100 != 0) || y % 400 == 0;
+        if (d > kDaysIn[mo - 1] + (mo == 2 && leap)) return false;
+
+        unsigned hh = 0, mm = 0, ss = 0;
+        if (i < n && (s[i] == 'T' || s[i] == ' '))
+        {
+            ++i;
+            if (!read_digits(2, hh) || i >= n || s[i++] != ':' || !read_digits(2, mm))
+                return false;
+            if (i < n && s[i] == ':')
+            {
+                ++i;
+                if (!read_digits(2, ss)) return false;
+            }
+        }
+        if (hh > 23 || mm > 59 || ss > 60) return false; // 60: leap second
+        if (i < n && s[i] == 'Z') ++i;
+        while (i < n && s[i] == ' ') ++i;
+        if (i != n) return false;
 
-    // Strip trailing dot
-    if (!out.empty() && out.back() == '.')
-        out.pop_back();
+        out = days_from_civil(y, mo, d) * 86400 + hh * 3600 + mm * 60 + ss;
+        return true;
+    }
 
-    return out;
+    // Excel serial date (days since 1899-12-30, fraction = time of day)
+    i = save;
+    double serial;
+    if (!parse_number(s, serial)) return false;
+    out = std::llround((serial - 25569.0) * 86400.0);
+    return true;
 }
 
 
-std::string to_upper(const std::string &str)
+void append_json_escaped(std::string &out, std::string_view s)
 {
-    std::string r = str;
-    std::transform(r.begin(), r.end(), r.begin(), [](unsigned char c) { return std::toupper(c);});
-
-    return r;
+    for (unsigned char c : s)
+    {
+        switch (c)
+        {
+        case '\"': out += "\\\""; break;
+        case '\\': out += "\\\\"; break;
+        case '\b': out += "\\b"; break;
+        case '\f': out += "\\f"; break;
+        case '\n': out += "\\n"; break;
+        case '\r': out += "\\r"; break;
+        case '\t': out += "\\t"; break;
+        default:
+            if (c < 0x20)
+            {
+                char buf[7];
+                std::snprintf(buf, sizeof(buf), "\\u%04x", c);
+                out += buf;
+            }
+            else out += (char)c;
+        }
+    }
 }
 
-std::string to_lower(const std::string &str)
+void append_json_list(std::string &out, const std::string *first, const std::string *last)
 {
-    std::string r = str;
-    std::transform(r.begin(), r.end(), r.begin(), [](unsigned char c) { return std::tolower(c);});
+    out += '[';
+    for (const std::string *it = first; it != last; ++it)
+    {
+        if (it != first) out += ',';
+
+        size_t b = it->find_first_not_of(" \t\r\n");
+        size_t e = it->find_last_not_of(" \t\r\n");
+        const bool nested = b != std::string::npos && e > b &&
+            (((*it)[b] == '{' && (*it)[e] == '}') || ((*it)[b] == '[' && (*it)[e] == ']'));
 
-    return r;
+        if (nested)
+            out.append(*it, b, e - b + 1);
+        else
+        {
+            out += '"';
+            append_json_escaped(out, *it);
+            out += '"';
+        }
+    }
+    out += ']';
 }
 
-std::string to_camel(const std::string &str, char &delim)
+
+namespace {
+
+// ASCII case tables (C-locale toupper/tolower/isupper/isspace/ispunct)
+enum : uint8_t { kCharOther, kCharUpper, kCharSep };
+
+struct CaseTables {
+    char upper[256];
+    char lower[256];
+    uint8_t cls[256];
+    constexpr CaseTables() : upper(), lower(), cls() {
+        for (int c = 0; c < 256; ++c) {
+            const bool is_upper = c >= 'A' && c <= 'Z';
+            const bool is_lower = c >= 'a' && c <= 'z';
+            const bool is_space = c == ' ' || (c >= '\t' && c <= '\r');
+            const bool is_punct = (c >= '!' && c <= '/') || (c >= ':' && c <= '@') ||
+                                  (c >= '[' && c <= '`') || (c >= '{' && c <= '~');
+            upper[c] = static_cast<char>(is_lower ? c - 32 : c);
+            lower[c] = static_cast<char>(is_upper ? c + 32 : c);
+            cls[c] = is_upper ? kCharUpper : (is_space || is_punct) ? kCharSep : kCharOther;
+        }
+    }
+};
+constexpr CaseTables kCase;
+
+inline uint8_t byte(char c) { return static_cast<uint8_t>(c); }
+
+// D != 0 fixes the delimiter at compile time; D == 0 reads it from delim
+template <CaseStyle S, char D>
+void case_kernel(std::string_view src, char delim, std::string &out)
 {
-    std::string r = str;
-    bool cap_next = false;
+    const char d = D ? D : delim;
+    out.clear();
 
-    for (size_t i = 0; i < r.size(); i++)
+    if constexpr (S == CaseStyle::Upper || S == CaseStyle::Lower)
     {
-        if (i == 0)
-        {
-            r[i] = std::tolower(r[i]);
-        }
-        else if (r[i] == delim)
-        {
-            cap_next = true;
-        }
-        else if (cap_next)
+        const char *table = S == CaseStyle::Upper ? kCase.upper : kCase.lower;
+        out.resize(src.size());
+        for (size_t i = 0; i < src.size(); ++i) out[i] = table[byte(src[i])];
+    }
+    else if constexpr (S == CaseStyle::Camel || S == CaseStyle::Pascal)
+    {
+        // first char lowered; a delimiter capitalizes the char after it; delimiters dropped
+        if (src.empty()) return;
+        out.reserve(src.size());
+        const char first = kCase.lower[byte(src[0])];
+        if (first != d) out += first;
+
+        bool cap_next = false;
+        for (size_t i = 1; i < src.size(); ++i)
         {
-            r[i] = std::toupper(r[i]);
+            const char c = src[i];
+            if (c == d) { cap_next = true; continue; }
+            const char o = cap_next ? kCase.upper[byte(c)] : c;
+            if (o != d) out += o;
             cap_next = false;
         }
-    }
 
-    r.erase(std::remove(r.begin(), r.end(), delim), r.end());
+        if (S == CaseStyle::Pascal && !out.empty()) out[0] = kCase.upper[byte(out[0])];
+    }
+    else // snake_case
+    {
+        // spaces/punctuation become one '_', an uppercase letter starts a new word
+        out.reserve(src.size() * 2);
+        bool last_was_sep = false;
+        for (char c : src)
+        {
+            const uint8_t cls = kCase.cls[byte(c)];
+            if (cls == kCharSep)
+            {
+                if (!out.empty() && !last_was_sep)
+                {
+                    out += '_';
+                    last_was_sep = true;
+                }
+                continue;
+            }
+            if (cls == kCharUpper && !out.empty() && !last_was_sep) out += '_';
+            out += kCase.lower[byte(c)];
+            last_was_sep = false;
+        }
 
-    return r;
+        while (!out.empty() && out.back() == '_')
+            out.pop_back();
+    }
 }
 
-
-std::string to_pascal(const std::string &str, char &delim)
+template <CaseStyle S>
+CaseKernel delimited_kernel(char delim)
 {
-    std::string r = to_camel(str, delim);
-    if (!r.empty())
+    switch (delim)
     {
-        r[0] = std::toupper(r[0]);
+    case ' ': return case_kernel<S, ' '>;
+    case '-': return case_kernel<S, '-'>;
+    case '_': return case_kernel<S, '_'>;
+    default:  return case_kernel<S, 0>;
     }
-    return r;
 }
 
-// helper for to_snake
-static inline bool is_sep(char c)
-{
-    return std::isspace((unsigned char)c) || std::ispunct((unsigned char)c);
-}
+} // namespace
 
-std::string to_snake(const std::string &str)
+CaseStyle case_style_from_string(const std::string &s)
 {
-    std::string out;
-    out.reserve(str.size() * 2);
+    if (s == "camelCase")  return CaseStyle::Camel;
+    if (s == "PascalCase") return CaseStyle::Pascal;
+    if (s == "snake_case") return CaseStyle::Snake;
+    if (s == "upper")      return CaseStyle::Upper;
+    if (s == "lower")      return CaseStyle::Lower;
 
-    bool last_was_sep = false;
+    throw std::runtime_error("Unknown transform: " + s + " (expected camelCase, PascalCase, snake_case, upper or lower)");
+}
 
-    for (size_t i = 0; i < str.size(); ++i)
+CaseKernel case_kernel_for(CaseStyle style, char delim)
+{
+    switch (style)
     {
-        unsigned char c = str[i];
+    case CaseStyle::Camel:  return delimited_kernel<CaseStyle::Camel>(delim);
+    case CaseStyle::Pascal: return delimited_kernel<CaseStyle::Pascal>(delim);
+    case CaseStyle::Snake:  return case_kernel<CaseStyle::Snake, 0>;
+    case CaseStyle::Upper:  return case_kernel<CaseStyle::Upper, 0>;
+    case CaseStyle::Lower:  return case_kernel<CaseStyle::Lower, 0>;
+    }
+    return case_kernel<CaseStyle::Lower, 0>;
+}
 
-        // ---- Separator / punctuation / space ----
-        if (is_sep(c))
-        {
-            if (!out.empty() && !last_was_sep)
-            {
-                out += '_';
-                last_was_sep = true;
-            }
-            continue;
-        }
+static std::string apply_case(CaseStyle style, const std::string &str, char delim = 0)
+{
+    std::string out;
+    case_kernel_for(style, delim)(str, delim, out);
+    return out;
+}
 
-        // ---- Uppercase letter and not first char ----
-        if (std::isupper(c))
-        {
-            if (!out.empty() && !last_was_sep)
-            {
-                out += '_';
-            }
-            out += (char)std::tolower(c);
-            last_was_sep = false;
-            continue;
-        }
+std::string to_upper(const std::string &str)
+{
+    return apply_case(CaseStyle::Upper, str);
+}
 
-        // ---- Lowercase or digit ----
-        out += (char)std::tolower(c);
-        last_was_sep = false;
-    }
+std::string to_lower(const std::string &str)
+{
+    return apply_case(CaseStyle::Lower, str);
+}
+
+std::string to_camel(const std::string &str, char &delim)
+{
+    return apply_case(CaseStyle::Camel, str, delim);
+}
 
-    // Trim trailing underscore
-    while (!out.empty() && out.back() == '_')
-        out.pop_back();
+std::string to_pascal(const std::string &str, char &delim)
+{
+    return apply_case(CaseStyle::Pascal, str, delim);
+}
 
-    return out;
+std::string to_snake(const std::string &str)
+{
+    return apply_case(CaseStyle::Snake, str);
 }
 
 // json-firestore-seed
 
-std::string random_past_utc_date_within_n_years(
-    std::optional<uint32_t> n_years
-)
+int64_t epoch_seconds_now()
 {
+    return std::chrono::duration_cast<std::chrono::seconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+}
 
-    // Current UTC time point
-    std::chrono::system_clock::time_point now = std::chrono::system_clock::now();
+uint64_t random_seed()
+{
+    std::random_device rd;
+    return (static_cast<uint64_t>(rd()) << 32) ^ rd();
+}
 
+int64_t random_past_epoch(uint64_t stream, uint64_t counter, uint32_t n_years, int64_t now)
+{
     // One year in seconds (365 days)
-    const int64_t one_year_seconds = 365LL * 24 * 60 * 60 * *n_years;
+    const uint64_t span = 365ULL * 24 * 60 * 60 * n_years;
+
+    // splitmix64 of the counter's position in the stream
+    uint64_t x = stream + (counter + 1) * 0x9e3779b97f4a7c15ULL;
+    x ^= x >> 30; x *= 0xbf58476d1ce4e5b9ULL;
+    x ^= x >> 27; x *= 0x94d049bb133111ebULL;
+    x ^= x >> 31;
 
-    // Random generator
-    static thread_local std::mt19937_64 rng(std::random_device{}());
-    std::uniform_int_distribution<int64_t> dist(0, one_year_seconds);
+    return now - static_cast<int64_t>(x % (span + 1));
+}
 
-    // Pick a random offset backwards from "now"
-    int64_t random_offset = dist(rng);
+namespace {
 
-    std::chrono::system_clock::time_point random_time = now - std::chrono::seconds(random_offset);
+// "00" .. "99", so every two-digit field is a single table copy
+struct TwoDigits {
+    char d[200];
+    constexpr TwoDigits() : d() {
+        for (int i = 0; i < 100; ++i) {
+            d[2 * i] = static_cast<char>('0' + i / 10);
+            d[2 * i + 1] = static_cast<char>('0' + i % 10);
+        }
+    }
+};
+constexpr TwoDigits kTwoDigits;
 
-    // Convert to time_t (UTC)
-    std::time_t tt = std::chrono::system_clock::to_time_t(random_time);
+inline char *put2(char *p, unsigned v)
+{
+    p[0] = kTwoDigits.d[2 * v];
+    p[1] = kTwoDigits.d[2 * v + 1];
+    return p + 2;
+}
 
-    // Format as UTC ISO 8601
-    std::tm tm_utc;
-    #if defined(_WIN32)
-        gmtime_s(&tm_utc, &tt);
-    #else
-        gmtime_r(&tt, &tm_utc);
-    #endif
+} // namespace
 
-    char buffer[32];
-    std::strftime(buffer, sizeof(buffer), "%Y-%m-%dT%H:%M:%SZ", &tm_utc);
+void append_iso8601_utc(std::string &out, int64_t epoch_seconds)
+{
+    int64_t days = epoch_seconds / 86400;
+    int64_t secs = epoch_seconds % 86400;
+    if (secs < 0) { secs += 86400; --days; }
+
+    // civil date from days since 1970-01-01 (proleptic Gregorian, 400-year eras)
+    days += 719468;
+    const int64_t era = (days >= 0 ? days : days - 146096) / 146097;
+    const unsigned doe = static_cast<unsigned>(days - era * 146097);
+    const unsigned yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+    const unsigned doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+    const unsigned mp = (5 * doy + 2) / 153;
+    const unsigned day = doy - (153 * mp + 2) / 5 + 1;
+    const unsigned month = mp < 10 ? mp + 3 : mp - 9;
+    const int64_t year = static_cast<int64_t>(yoe) + era * 400 + (month <= 2);
+
+    char buf[20];
+    char *p = buf;
+    if (year < 0 || year > 9999) // outside what four digits can show
+        out += std::to_string(year);
+    else
+    {
+        p = put2(p, static_cast<unsigned>(year / 100));
+        p = put2(p, static_cast<unsigned>(year % 100));
+    }
+    *p++ = '-';
+    p = put2(p, month);
+    *p++ = '-';
+    p = put2(p, day);
+    *p++ = 'T';
+    p = put2(p, static_cast<unsigned>(secs / 3600));
+    *p++ = ':';
+    p = put2(p, static_cast<unsigned>(secs / 60 % 60));
+    *p++ = ':';
+    p = put2(p, static_cast<unsigned>(secs % 60));
+    *p++ = 'Z';
+    out.append(buf, p);
+}
 
-    return std::string(buffer);
+void append_firestore_timestamp(std::string &out, int64_t epoch_seconds)
+{
+    if (epoch_seconds == kFirestoreNow)
+    {
+        out += "\"__fire_ts_now__\"";
+        return;
+    }
+    out += "{ \"__fire_ts_from_date__\": \"";
+    append_iso8601_utc(out, epoch_seconds);
+    out += "\" }";
 }
 
 // os terminal helpers
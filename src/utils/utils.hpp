@@ -1,5 +1,9 @@
+#pragma once
 #include <string>
-#include <optional>
+#include <string_view>
+#include <cstdint>
+#include <climits>
+#include "numeric.hpp"
 
 // helpers
 std::string str_trim_copy(const std::string &s);
@@ -16,7 +20,30 @@ std::size_t col_to_index(const std::string &letters);
 
 std::string index_to_col(size_t index);
 
-std::string to_clean_number(const std::string &s);
+// parse "YYYY-MM-DD[ T]HH:MM[:SS][Z]" (also '/' separated) or an Excel serial date
+// into UTC epoch seconds
+bool parse_datetime_epoch(const std::string &s, int64_t &out);
+
+// days since 1970-01-01 for a proleptic Gregorian civil date
+int64_t days_from_civil(int64_t y, unsigned m, unsigned d);
+
+// append s escaped for use inside a JSON string literal
+void append_json_escaped(std::string &out, std::string_view s);
+
+// append list items as a JSON array; items that are JSON objects or arrays
+// are written raw, everything else as strings
+void append_json_list(std::string &out, const std::string *first, const std::string *last);
+
+// case transforms for transform-row / transform-header
+enum class CaseStyle { Camel, Pascal, Snake, Upper, Lower };
+
+// "camelCase", "PascalCase", "snake_case", "upper", "lower"; throws std::runtime_error otherwise
+CaseStyle case_style_from_string(const std::string &s);
+
+// writes src in the given style into out, reusing out's capacity; delim
+// separates words for camel/Pascal. Pick the kernel once, call it per cell.
+using CaseKernel = void (*)(std::string_view src, char delim, std::string &out);
+CaseKernel case_kernel_for(CaseStyle style, char delim);
 
 std::string to_upper(const std::string &str);
 
@@ -29,9 +56,27 @@ std::string to_pascal(const std::string &str, char &delim);
 std::string to_snake(const std::string &str);
 
 // json-firestore-seed funcs
-std::string random_past_utc_date_within_n_years(
-    std::optional<uint32_t> n_years = 1
-);
+
+// stored in timestamp columns for "firestore-now" (rendered as __fire_ts_now__)
+constexpr int64_t kFirestoreNow = INT64_MIN;
+
+// current UTC time as epoch seconds
+int64_t epoch_seconds_now();
+
+// nondeterministic 64-bit seed
+uint64_t random_seed();
+
+// random epoch second in [now - n_years * 365 days, now] from a counter-based
+// stream: the same (stream, counter) always gives the same value, so cells can
+// be generated in any order and on any thread
+int64_t random_past_epoch(uint64_t stream, uint64_t counter, uint32_t n_years, int64_t now);
+
+// append epoch seconds as "YYYY-MM-DDTHH:MM:SSZ"
+void append_iso8601_utc(std::string &out, int64_t epoch_seconds);
+
+// append a timestamp cell as json-firestore-seed expects it:
+// { "__fire_ts_from_date__": "<ISO-8601>" }, or "__fire_ts_now__" for kFirestoreNow
+void append_firestore_timestamp(std::string &out, int64_t epoch_seconds);
 
 // os terminal helpers
 int get_terminal_width();
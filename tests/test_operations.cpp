@@ -1,6 +1,19 @@
 #define CATCH_CONFIG_MAIN
 #include <catch2/catch_all.hpp>
+#include <algorithm>
 #include "operations.hpp"
+#include "plan.hpp"
+#include "thread_pool.hpp"
+#include "snapshot.hpp"
+#include "runner.hpp"
+#include "server.hpp"
+#include <filesystem>
+#include <fstream>
+#include <thread>
+#include <atomic>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
 
 
 TEST_CASE("to_lower converts strings to lowercase", "[to_lower]")
@@ -46,4 +59,873 @@ TEST_CASE("to_snake converts strings to snake_case", "[to_snake]")
     REQUIRE(to_snake("Test-Delim") == "test_delim");
     REQUIRE(to_snake("Test Space") == "test_space");
     REQUIRE(to_snake("DUNS number") == "d_u_n_s_number");
-}
\ No newline at end of file
+}
+
+static NitroSheet make_sheet(const std::vector<std::vector<std::string>> &cols)
+{
+    NitroSheet s;
+    for (size_t c = 0; c < cols.size(); ++c)
+    {
+        s.cols.emplace_back(index_to_col(c), cols[c]);
+    }
+    s.num_rows = cols.empty() ? 0 : static_cast<uint32_t>(cols[0].size());
+    return s;
+}
+
+// column values in logical (selection) order
+static std::vector<std::string> logical_vals(const NitroSheet &s, size_t c)
+{
+    std::vector<std::string> out;
+    for (size_t i = 0; i < s.row_count(); ++i)
+        out.push_back(s.cols[c].at(s.row_at(i)));
+    return out;
+}
+
+TEST_CASE("sort_rows_by_column_nitro sorts numbers and dates by value", "[sort_rows_by_column_nitro]")
+{
+    auto sheet = make_sheet({ { "100", "20", "", "3.5" }, { "a", "b", "c", "d" } });
+
+    sort_rows_by_column_nitro(sheet, 0, true, SortAs::Number);
+    REQUIRE(logical_vals(sheet, 0) == std::vector<std::string>{ "3.5", "20", "100", "" });
+    REQUIRE(logical_vals(sheet, 1) == std::vector<std::string>{ "d", "b", "a", "c" });
+
+    sort_rows_by_column_nitro(sheet, 0, false, SortAs::Number);
+    REQUIRE(logical_vals(sheet, 0) == std::vector<std::string>{ "100", "20", "3.5", "" });
+
+    sort_rows_by_column_nitro(sheet, 0, true, SortAs::String);
+    REQUIRE(logical_vals(sheet, 0) == std::vector<std::string>{ "", "100", "20", "3.5" });
+
+    auto dates = make_sheet({ { "2024-03-01", "2023-12-31T23:59:59Z", "2024/01/15" } });
+    sort_rows_by_column_nitro(dates, 0, true, SortAs::Date);
+    REQUIRE(logical_vals(dates, 0) == std::vector<std::string>{ "2023-12-31T23:59:59Z", "2024/01/15", "2024-03-01" });
+
+    // equal keys keep their order whether or not the column is dictionary-encoded
+    auto ties_plain = make_sheet({ { "b", "a", "b", "a" }, { "1", "2", "3", "4" } });
+    auto ties_dict = ties_plain;
+    ties_dict.cols[0].assign_dict({ 0, 1, 0, 1 }, { "b", "a" });
+    sort_rows_by_column_nitro(ties_plain, 0, false, SortAs::String);
+    sort_rows_by_column_nitro(ties_dict, 0, false, SortAs::String);
+    REQUIRE(logical_vals(ties_plain, 1) == std::vector<std::string>{ "1", "3", "2", "4" });
+    REQUIRE(logical_vals(ties_dict, 1) == logical_vals(ties_plain, 1));
+
+    REQUIRE_THROWS(sort_as_from_string("bogus"));
+}
+
+TEST_CASE("run_row_stages_nitro matches running the ops one by one", "[run_row_stages_nitro]")
+{
+    auto sequential = make_sheet({ { "1", "2", "3" }, { "bn-xs-red", "gh-blue", "" } });
+    auto fused = sequential;
+
+    split_column_nitro(sequential, 1, 2, 1, '-', { 2, 3, 4 }, { "Code", "Size", "Color" }, {});
+    uppercase_column_nitro(sequential, 2, 4);
+    replace_in_column_nitro(sequential, 1, 4, "RED", "R");
+
+    RowStage split;
+    split.kind = RowStage::Kind::Split;
+    split.col_index = 1;
+    split.target_col_indices = { 2, 3, 4 };
+    split.new_headers = { "Code", "Size", "Color" };
+    RowStage upper;
+    upper.kind = RowStage::Kind::Uppercase;
+    upper.col_index = 4;
+    RowStage replace;
+    replace.kind = RowStage::Kind::Replace;
+    replace.col_index = 4;
+    replace.first_data_row = 1;
+    replace.find = "RED";
+    replace.repl = "R";
+
+    run_row_stages_nitro(fused, { split, upper, replace });
+
+    REQUIRE(fused.cols.size() == sequential.cols.size());
+    for (size_t c = 0; c < fused.cols.size(); ++c)
+    {
+        REQUIRE(fused.cols[c].header == sequential.cols[c].header);
+        REQUIRE(logical_vals(fused, c) == logical_vals(sequential, c));
+    }
+    REQUIRE(fused.cols[4].at(0) == "R");
+
+    // only the targets are padded: a short column the split does not name is
+    // left alone (another step may be reading it), a short source reads as blank
+    auto ragged = make_sheet({ { "1", "2" }, { "a-b", "c-d" } });
+    ragged.cols[0].vals_mut().resize(1);
+    ragged.cols[1].vals_mut().resize(1);
+    run_row_stages_nitro(ragged, { split });
+    REQUIRE(ragged.cols[0].size() == 1);
+    REQUIRE(ragged.cols[1].size() == 1);
+    REQUIRE(logical_vals(ragged, 2) == std::vector<std::string>{ "a", "" });
+
+    // dictionary columns (and split targets, which the standalone split
+    // encodes) are left to the standalone ops
+    auto plain = make_sheet({ { "1" }, { "a-b" } });
+    REQUIRE(row_stages_fusable(plain, { upper, replace }));
+    REQUIRE_FALSE(row_stages_fusable(plain, { split, upper, replace }));
+    auto encoded = make_sheet({ { "1" }, { "a-b" }, { "" }, { "" }, { "x" } });
+    encoded.cols[4].assign_dict({ 0 }, { "x" });
+    REQUIRE(encoded.cols[4].is_dict());
+    REQUIRE_FALSE(row_stages_fusable(encoded, { upper, replace }));
+}
+
+TEST_CASE("compile_operation validates fields before anything runs", "[compile_operation]")
+{
+    auto compile = [](const char *yaml) { return compile_operation(YAML::Load(yaml)); };
+    auto error_of = [&](const char *yaml) -> std::string {
+        try { compile(yaml); }
+        catch (const std::runtime_error &e) { return e.what(); }
+        return "";
+    };
+
+    REQUIRE(error_of("{ type: no-such-op }").find("unknown operation type") != std::string::npos);
+    REQUIRE(error_of("{ type: uppercase-column }").find("missing `column`") != std::string::npos);
+    REQUIRE(error_of("{ type: uppercase-column, column: B2 }").find("invalid column letters") != std::string::npos);
+    REQUIRE(error_of("{ type: top-n, column: A, count: many }").find("`count` must be") != std::string::npos);
+    REQUIRE(error_of("{ type: sort-rows-by-column, column: A, sort-as: bogus }").find("`sort-as`") != std::string::npos);
+    REQUIRE(error_of("{ type: regex-replace-in-column, column: A, pattern: '(' }").find("`pattern`") != std::string::npos);
+    REQUIRE(error_of("{ type: fill-column, column: A, fill-with: firestore-random-past-date-n-year-x }").find("N years") != std::string::npos);
+
+    // a compiled plan gives the same sheet as calling the operations directly
+    auto direct = make_sheet({ { "b-1", "a-2", "c-3" }, { "x", "y", "z" } });
+    auto planned = direct;
+
+    split_column_nitro(direct, 1, 2, 0, '-', { 2, 3 }, { "L", "N" }, {});
+    uppercase_column_nitro(direct, 2, 2);
+    sort_rows_by_column_nitro(direct, 1, false, SortAs::String);
+
+    const std::vector<OperationPtr> ops = {
+        compile("{ type: split-column, column: A, delimiter: '-', split-to: [C, D], new-headers: [L, N] }"),
+        compile("{ type: uppercase-column, column: C }"),
+        compile("{ type: sort-rows-by-column, column: B, ascending: false }"),
+    };
+    OpContext ctx(planned, 1, 2);
+    REQUIRE(run_operations(ops, ctx).size() == 3);
+
+    REQUIRE(planned.cols.size() == direct.cols.size());
+    for (size_t c = 0; c < planned.cols.size(); ++c)
+    {
+        REQUIRE(planned.cols[c].header == direct.cols[c].header);
+        REQUIRE(logical_vals(planned, c) == logical_vals(direct, c));
+    }
+}
+
+TEST_CASE("run_operations gives the sequential result on any thread count", "[run_operations]")
+{
+    std::vector<std::string> a, b, c;
+    for (int i = 0; i < 50000; ++i)
+    {
+        a.push_back(std::to_string(i % 97) + "-x");
+        b.push_back(i % 3 ? "red" : "blue");
+        c.push_back(std::to_string(i));
+    }
+    const auto base = make_sheet({ a, b, c, std::vector<std::string>(a.size()) });
+
+    // independent column ops around a barrier, plus a chain through column D
+    std::vector<OperationPtr> ops;
+    for (const char *yaml : {
+             "{ type: uppercase-column, column: A }",
+             "{ type: replace-in-column, column: B, find: red, replace: R }",
+             "{ type: fill-column, column: D, fill-with: '${col B}:${col C}' }",
+             "{ type: regex-replace-in-column, column: D, pattern: '^R:', replace: 'r=' }",
+             "{ type: sort-rows-by-column, column: C, ascending: false, sort-as: number }",
+             "{ type: reassign-numbering, column: C, prefix: 'n', suffix: '' }",
+             "{ type: rename-header, column: A, new-name: Code }",
+             "{ type: transform-header, to: upper }",
+         })
+        ops.push_back(compile_operation(YAML::Load(yaml)));
+
+    auto run_with = [&](std::size_t threads) {
+        set_thread_count(threads);
+        NitroSheet sheet = base;
+        OpContext ctx(sheet, 1, 2);
+        std::size_t last = 0;
+        const auto logs = run_operations(ops, ctx, [&](std::size_t done, std::size_t) { last = done; });
+        REQUIRE(logs.size() == ops.size());
+        REQUIRE(last == ops.size());
+        return sheet;
+    };
+
+    const NitroSheet sequential = run_with(1);
+    const NitroSheet concurrent = run_with(4);
+    set_thread_count(0);
+
+    REQUIRE(concurrent.cols.size() == sequential.cols.size());
+    for (size_t col = 0; col < sequential.cols.size(); ++col)
+    {
+        REQUIRE(concurrent.cols[col].header == sequential.cols[col].header);
+        REQUIRE(logical_vals(concurrent, col) == logical_vals(sequential, col));
+    }
+    REQUIRE(logical_vals(sequential, 3)[0] == "r=49999");
+}
+
+TEST_CASE("snapshots round-trip and checkpoints resume from the longest prefix", "[CheckpointCache]")
+{
+    auto sheet = make_sheet({ { "x", "y", "x", "y" }, { "1", "", "3", "4" }, { "a", "b", "c", "d" } });
+    sheet.cols[0].assign_constant(4, "same");
+    sheet.cols[2].assign_list({ 0, 1, 1, 3, 4 }, { "p", "q", "{\"k\":1}", "r" });
+    sheet.cols.emplace_back();
+    sheet.cols.back().header = "Empty";
+    Column ts;
+    ts.header = "When";
+    ts.assign_timestamps({ 0, kFirestoreNow, 86400, -1 });
+    sheet.cols.push_back(ts);
+    set_row_selection(sheet, { 3, 1, 0 });
+
+    const std::string dir = "test_checkpoints";
+    std::filesystem::remove_all(dir);
+    std::filesystem::create_directories(dir);
+
+    write_snapshot(sheet, dir + "/round.nsnap");
+    NitroSheet back;
+    REQUIRE(read_snapshot(dir + "/round.nsnap", back));
+    REQUIRE(back.num_rows == sheet.num_rows);
+    REQUIRE(back.sel == sheet.sel);
+    REQUIRE(back.cols.size() == sheet.cols.size());
+    REQUIRE(back.cols[0].is_dict());
+    REQUIRE(back.cols[2].is_list());
+    REQUIRE(back.cols[4].is_timestamp());
+    for (size_t c = 0; c < sheet.cols.size(); ++c)
+    {
+        REQUIRE(back.cols[c].header == sheet.cols[c].header);
+        if (sheet.cols[c].size() == 0) continue;
+        REQUIRE(logical_vals(back, c) == logical_vals(sheet, c));
+    }
+    REQUIRE_FALSE(read_snapshot(dir + "/missing.nsnap", back));
+
+    // a checkpoint chain: editing the last operation keeps the first two
+    { std::ofstream(dir + "/input.bin") << "input bytes"; }
+    auto config = [&](const char *last) {
+        Config cfg;
+        cfg.input_file = dir + "/input.bin";
+        for (const char *yaml : { "{ type: uppercase-column, column: A }", "{ column: B, type: rename-header, new-name: N }", last })
+            cfg.operations.push_back(compile_operation(YAML::Load(yaml)));
+        return cfg;
+    };
+
+    {
+        CheckpointCache cache(dir, config("{ type: remove-column, column: C }"), FillClock());
+        REQUIRE_FALSE(cache.restore(back).has_value());
+        for (size_t k = 0; k <= 3; ++k) cache.save(k, sheet);
+        cache.finish();
+        REQUIRE(cache.restore(back) == std::optional<size_t>(3));
+    }
+    {
+        // same operations with another key order and quoting: same keys
+        CheckpointCache cache(dir, config("{ column: 'C', type: remove-column }"), FillClock());
+        REQUIRE(cache.restore(back) == std::optional<size_t>(3));
+    }
+    {
+        CheckpointCache cache(dir, config("{ type: remove-column, column: D }"), FillClock());
+        REQUIRE(cache.restore(back) == std::optional<size_t>(2));
+    }
+    std::filesystem::remove_all(dir);
+}
+
+TEST_CASE("run_script leaves the base sheet untouched between runs", "[run_script]")
+{
+    const auto base = make_sheet({ { "b", "a", "c" }, { "x", "y", "z" } });
+
+    Config cfg;
+    cfg.input_file = "unused.xlsx"; // never opened: the base is the input
+    cfg.output_file = "test_run_script";
+    cfg.export_csv = true;
+    for (const char *yaml : {
+             "{ type: uppercase-column, column: A }",
+             "{ type: sort-rows-by-column, column: A, ascending: true }",
+             "{ type: remove-column, column: B }",
+         })
+        cfg.operations.push_back(compile_operation(YAML::Load(yaml)));
+
+    auto csv = [&] {
+        std::ifstream in(cfg.output_file + ".csv");
+        return std::string(std::istreambuf_iterator<char>(in), {});
+    };
+
+    RunOptions opt;
+    opt.base = &base;
+    opt.verbose = false;
+    const RunReport first = run_script(cfg, opt);
+    REQUIRE(first.logs.size() == 3);
+    REQUIRE(first.rows == 3);
+    REQUIRE(first.cols == 1);
+    const std::string out = csv();
+    REQUIRE(out.find("A\nB\nC") != std::string::npos);
+
+    // the base kept its columns and order, so a second run gives the same output
+    REQUIRE(base.cols.size() == 2);
+    REQUIRE(logical_vals(base, 0) == std::vector<std::string>{ "b", "a", "c" });
+    run_script(cfg, opt);
+    REQUIRE(csv() == out);
+
+    std::filesystem::remove(cfg.output_file + ".json");
+    std::filesystem::remove(cfg.output_file + ".csv");
+
+    // a script set reports a failed load per script instead of throwing
+    Config other = cfg;
+    cfg.input_file = other.input_file = "missing.xlsx";
+    other.output_file = "test_run_script_other";
+    const auto results = run_scripts({ cfg, other });
+    REQUIRE(results.size() == 2);
+    REQUIRE(results[0].error.find("Cannot load missing.xlsx") == 0);
+    REQUIRE(results[1].error == results[0].error);
+}
+
+TEST_CASE("server caches are LRU and requests fail with JSON errors", "[SeedServer]")
+{
+    LruCache<int> cache(2);
+    int made = 0;
+    bool hit = false;
+    auto get = [&](const std::string &key) { return cache.get(key, [&] { return ++made; }, hit); };
+
+    REQUIRE(get("a") == 1);
+    REQUIRE_FALSE(hit);
+    REQUIRE(get("a") == 1);
+    REQUIRE(hit);
+    get("b");
+    get("a"); // b is now the least recently used
+    get("c");
+    REQUIRE(cache.size() == 2);
+    REQUIRE(get("a") == 1);
+    REQUIRE(hit);
+    REQUIRE(get("b") == 4);
+    REQUIRE_FALSE(hit);
+
+    // a failed computation is not cached
+    REQUIRE_THROWS(cache.get("bad", []() -> int { throw std::runtime_error("boom"); }, hit));
+    REQUIRE(cache.get("bad", [] { return 7; }, hit) == 7);
+    REQUIRE_FALSE(hit);
+
+    SeedServer server(4);
+    auto error_of = [&](const std::string &request) {
+        const std::string response = server.handle(request);
+        REQUIRE(response.rfind("{\"ok\": false, \"error\": ", 0) == 0);
+        return response;
+    };
+    REQUIRE(error_of("{ not json").find("Invalid request") != std::string::npos);
+    REQUIRE(error_of("{\"input\": \"a.xlsx\"}").find("`script`") != std::string::npos);
+    REQUIRE(error_of("{\"script\": \"missing.yaml\"}").find("Cannot read missing.yaml") != std::string::npos);
+
+    { std::ofstream("test_server_script.yaml") << "input: a.xlsx\noutput: out\noperations:\n  - type: no-such-op\n"; }
+    REQUIRE(error_of("{\"script\": \"test_server_script.yaml\"}").find("no-such-op") != std::string::npos);
+    std::filesystem::remove("test_server_script.yaml");
+
+    // listen never removes a regular file or takes over a live socket
+    { std::ofstream("test_server_not_a_socket") << "keep"; }
+    REQUIRE_THROWS_AS(server.listen("test_server_not_a_socket"), std::runtime_error);
+    REQUIRE(std::filesystem::is_regular_file("test_server_not_a_socket"));
+    std::filesystem::remove("test_server_not_a_socket");
+
+    const std::string live_path = "test_server_live.sock";
+    sockaddr_un addr{};
+    addr.sun_family = AF_UNIX;
+    live_path.copy(addr.sun_path, live_path.size());
+    ::unlink(live_path.c_str());
+    const int live = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    REQUIRE(::bind(live, reinterpret_cast<const sockaddr *>(&addr), sizeof addr) == 0);
+    REQUIRE(::listen(live, 1) == 0);
+    REQUIRE_THROWS_AS(server.listen(live_path), std::runtime_error);
+    REQUIRE(std::filesystem::is_socket(live_path));
+    ::close(live);
+    ::unlink(live_path.c_str());
+}
+
+TEST_CASE("columns are shared copy-on-write", "[Column]")
+{
+    auto sheet = make_sheet({ { "a", "b" }, { "x", "y" } });
+
+    fill_column_nitro(sheet, 1, 2, 2, "${col B}", "Copy");
+    REQUIRE(sheet.cols[2].header == "Copy");
+    REQUIRE(sheet.cols[2].shares_data_with(sheet.cols[1]));
+    REQUIRE(logical_vals(sheet, 2) == std::vector<std::string>{ "x", "y" });
+
+    uppercase_column_nitro(sheet, 2, 2);
+    REQUIRE_FALSE(sheet.cols[2].shares_data_with(sheet.cols[1]));
+    REQUIRE(logical_vals(sheet, 2) == std::vector<std::string>{ "X", "Y" });
+    REQUIRE(logical_vals(sheet, 1) == std::vector<std::string>{ "x", "y" });
+
+    NitroSheet copy = sheet;
+    REQUIRE(copy.cols[0].shares_data_with(sheet.cols[0]));
+    remove_column_nitro(copy, 0);
+    REQUIRE(copy.cols[0].shares_data_with(sheet.cols[1]));
+}
+
+TEST_CASE("validity bitmaps follow writes", "[validity]")
+{
+    std::vector<std::string> a(70), b(70);
+    a[3] = "x";
+    b[65] = "y";
+    for (int r = 0; r < 70; r += 10) b[r] = "";
+    auto sheet = make_sheet({ a, b });
+
+    auto mask = sheet.nonempty_row_mask();
+    REQUIRE(mask.size() == 2);
+    REQUIRE(mask[0] == (uint64_t(1) << 3));
+    REQUIRE(mask[1] == (uint64_t(1) << 1));
+
+    NitroSheet copy = sheet;
+    copy.cols[0].vals_mut()[3] = "";
+    copy.cols[1].set(10, "z");
+    REQUIRE(copy.nonempty_row_mask()[0] == (uint64_t(1) << 10));
+    REQUIRE(sheet.cols[0].has_value(3)); // the original keeps its bitmap
+
+    copy.cols[1].assign_constant(70, "");
+    REQUIRE_FALSE(copy.cols[1].has_value(65));
+    REQUIRE(copy.nonempty_row_mask() == std::vector<uint64_t>{ 0, 0 });
+}
+
+TEST_CASE("sort and group only rewrite the selection", "[materialize_selection]")
+{
+    auto sheet = make_sheet({ { "b", "a", "b", "a" }, { "1", "2", "3", "4" } });
+
+    sort_rows_by_column_nitro(sheet, 0, true);
+    REQUIRE(sheet.has_sel);
+    REQUIRE(sheet.cols[1].at(0) == "1"); // cells untouched
+    REQUIRE(sheet.cols[1].at(3) == "4");
+
+    group_collect_nitro(sheet, 0, { 1 }, { 1 }, false, {}, {});
+    REQUIRE(sheet.row_count() == 2);
+    REQUIRE(logical_vals(sheet, 0) == std::vector<std::string>{ "a", "b" });
+    REQUIRE(logical_vals(sheet, 1) == std::vector<std::string>{ "[\"2\",\"4\"]", "[\"1\",\"3\"]" });
+
+    reassign_numbering_nitro(sheet, 0, "#", "", 1, 1);
+    REQUIRE(logical_vals(sheet, 0) == std::vector<std::string>{ "#1", "#2" });
+
+    materialize_selection(sheet);
+    REQUIRE_FALSE(sheet.has_sel);
+    REQUIRE(sheet.num_rows == 2);
+    REQUIRE(logical_vals(sheet, 0) == std::vector<std::string>{ "#1", "#2" });
+}
+
+TEST_CASE("group_collect_nitro stores native list cells", "[group_collect_nitro]")
+{
+    auto sheet = make_sheet({ { "a", "a", "b", "a" }, { "say \"hi\"", "{\"k\":1}", "x", "say \"hi\"" } });
+
+    group_collect_nitro(sheet, 0, { 1 }, { 1 }, true, {}, {});
+    const Column &list = sheet.cols[1];
+    REQUIRE(list.is_list());
+    REQUIRE(sheet.row_count() == 3);
+
+    // items are kept as-is; objects are written raw, strings escaped
+    const size_t r = sheet.row_at(0);
+    REQUIRE(std::vector<std::string>(list.items().begin() + list.offsets()[r],
+                                     list.items().begin() + list.offsets()[r + 1])
+            == std::vector<std::string>{ "say \"hi\"", "{\"k\":1}" });
+    REQUIRE(logical_vals(sheet, 1) == std::vector<std::string>{ "[\"say \\\"hi\\\"\",{\"k\":1}]", "[\"x\"]", "[\"say \\\"hi\\\"\"]" });
+    REQUIRE(list.has_value(r));
+
+    materialize_selection(sheet);
+    REQUIRE(sheet.cols[1].is_list());
+    REQUIRE(sheet.cols[1].size() == 3);
+    REQUIRE(sheet.cols[1].at(1) == "[\"x\"]");
+
+    sheet.cols[1].set(1, "plain");
+    REQUIRE_FALSE(sheet.cols[1].is_list());
+    REQUIRE(logical_vals(sheet, 1)[1] == "plain");
+    REQUIRE(logical_vals(sheet, 1)[2] == "[\"say \\\"hi\\\"\"]");
+}
+
+TEST_CASE("dictionary-encoded columns give the same results as plain ones", "[dict_encode]")
+{
+    std::vector<std::string> codes, sizes, nums;
+    for (int r = 0; r < 64; ++r)
+    {
+        codes.push_back(r % 3 == 0 ? "bn-xs-red" : r % 3 == 1 ? "gh-s-blue" : "vg--white");
+        sizes.push_back(r % 2 ? " s " : "xl");
+        nums.push_back(std::to_string((r * 7) % 5 * 10));
+    }
+
+    auto plain = make_sheet({ codes, sizes, nums });
+    auto dict = plain;
+    for (auto &col : dict.cols)
+        REQUIRE(col.dict_encode());
+    REQUIRE(dict.cols[0].dict().size() == 3);
+
+    for (auto *s : { &plain, &dict })
+    {
+        uppercase_column_nitro(*s, 2, 0);
+        replace_in_column_nitro(*s, 2, 1, "S", "small"); // first data row keeps its value
+        sort_rows_by_column_nitro(*s, 2, false, SortAs::Number);
+        split_column_nitro(*s, 1, 2, 0, '-', { 3, 4, 5 }, { "Code", "Size", "Color" }, {});
+        group_collect_nitro(*s, 3, { 5 }, { 5 }, true, { 2 }, { "sum" });
+    }
+
+    REQUIRE(dict.cols[3].is_dict());
+    REQUIRE(plain.row_count() == dict.row_count());
+    for (size_t c = 0; c < plain.cols.size(); ++c)
+    {
+        REQUIRE(plain.cols[c].header == dict.cols[c].header);
+        REQUIRE(logical_vals(plain, c) == logical_vals(dict, c));
+    }
+}
+
+TEST_CASE("fill_column_nitro evaluates ifcol conditions per column", "[fill_column_nitro]")
+{
+    std::vector<std::string> kind, qty;
+    for (int r = 0; r < 80; ++r)
+    {
+        kind.push_back(r % 4 == 0 ? "GH" : r % 4 == 1 ? "VG" : r % 4 == 2 ? "BN" : "gh");
+        qty.push_back(r % 5 == 0 ? "n/a" : std::to_string(r));
+    }
+
+    auto plain = make_sheet({ kind, qty });
+    auto dict = plain;
+    REQUIRE(dict.cols[0].dict_encode());
+
+    for (auto *s : { &plain, &dict })
+    {
+        fill_column_nitro(*s, 1, 2, 2, "${ifcol A == GH && B > 40 || A == 'VG' ? 'yes' : no}", "Flag");
+        fill_column_nitro(*s, 1, 2, 3, "#${ifcol B != 10 ? col A : 'ten'}-${ifcol B >= x}", "Mixed");
+    }
+
+    for (size_t r = 0; r < 80; ++r)
+    {
+        double q = 0;
+        const bool numeric = parse_number(qty[r], q);
+        const bool flag = (kind[r] == "GH" && numeric && q > 40) || kind[r] == "VG";
+        REQUIRE(plain.cols[2].at(r) == (flag ? "yes" : "no"));
+        REQUIRE(plain.cols[3].at(r) == "#" + (numeric && q == 10 ? std::string("ten") : kind[r]) + "-${ifcol B >= x}");
+    }
+    REQUIRE(plain.cols[2].is_dict()); // literal branches are filled as a dictionary
+    REQUIRE(plain.cols[2].header == "Flag");
+    for (size_t c = 2; c < 4; ++c)
+        REQUIRE(logical_vals(plain, c) == logical_vals(dict, c));
+}
+
+TEST_CASE("fill_column_nitro stores Firestore timestamps as epoch seconds", "[fill_column_nitro]")
+{
+    auto sheet = make_sheet({ { "a", "b", "c" } });
+
+    fill_column_nitro(sheet, 1, 2, 1, "firestore-random-past-date-n-year-2", "created_at");
+    fill_column_nitro(sheet, 1, 2, 2, "firestore-now", "updated_at");
+
+    const Column &created = sheet.cols[1];
+    REQUIRE(created.is_timestamp());
+    REQUIRE(created.header == "created_at");
+    const int64_t now = epoch_seconds_now();
+    for (int64_t t : created.timestamps())
+    {
+        REQUIRE(t <= now);
+        REQUIRE(t >= now - 2 * 365LL * 86400 - 5);
+    }
+
+    std::string expected;
+    append_firestore_timestamp(expected, created.timestamps()[1]);
+    REQUIRE(created.at(1) == expected);
+    REQUIRE(expected.rfind("{ \"__fire_ts_from_date__\": \"", 0) == 0);
+
+    REQUIRE(sheet.cols[2].is_timestamp());
+    REQUIRE(sheet.cols[2].at(0) == "__fire_ts_now__");
+    REQUIRE(sheet.cols[2].has_value(0));
+
+    Column copy = created;
+    copy.set(0, "x");
+    REQUIRE_FALSE(copy.is_timestamp());
+    REQUIRE(copy.at(1) == expected);
+    REQUIRE(created.is_timestamp());
+}
+
+TEST_CASE("seeded timestamp fills are reproducible", "[fill_column_nitro]")
+{
+    FillClock clock(1735689600, 42); // 2025-01-01T00:00:00Z
+
+    std::vector<std::string> keys(50000, "k");
+    auto a = make_sheet({ keys });
+    auto b = make_sheet({ keys });
+    fill_column_nitro(a, 1, 2, 1, "firestore-random-past-date-n-year-3", "At", clock);
+    fill_column_nitro(b, 1, 2, 1, "firestore-random-past-date-n-year-3", "At", clock);
+    fill_column_nitro(b, 1, 2, 2, "firestore-random-past-date-n-year-3", "Other", clock);
+
+    REQUIRE(a.cols[1].timestamps() == b.cols[1].timestamps());
+    REQUIRE(a.cols[1].timestamps() != b.cols[2].timestamps()); // each column has its own stream
+    auto [lo, hi] = std::minmax_element(a.cols[1].timestamps().begin(), a.cols[1].timestamps().end());
+    REQUIRE(*hi <= clock.now);
+    REQUIRE(*lo >= clock.now - 3 * 365LL * 86400);
+
+    clock.seed = 43;
+    fill_column_nitro(b, 1, 2, 1, "firestore-random-past-date-n-year-3", "At", clock);
+    REQUIRE(a.cols[1].timestamps() != b.cols[1].timestamps());
+}
+
+TEST_CASE("filter_rows_nitro keeps matching rows in the selection", "[filter_rows_nitro]")
+{
+    auto sheet = make_sheet({
+        { "1", "2", "3", "4", "5", "6" },
+        { "GH", "VG", "GH", "BN", "", "GH" },
+        { "700", "60", "n/a", "2000", "15", "300" },
+        { "G Handbag", "V Shirt", "G Hat", "B Necklace", " ", "G Shirt" },
+    });
+    auto dict = sheet;
+    for (auto &col : dict.cols) // too few rows for dict_encode; build the encoding directly
+    {
+        std::vector<std::string> entries;
+        std::vector<uint32_t> codes;
+        for (size_t r = 0; r < col.size(); ++r)
+        {
+            auto it = std::find(entries.begin(), entries.end(), col.at(r));
+            codes.push_back(static_cast<uint32_t>(it - entries.begin()));
+            if (it == entries.end()) entries.push_back(col.at(r));
+        }
+        col.assign_dict(std::move(codes), std::move(entries));
+    }
+
+    RowPredicate shirt_or_range;
+    shirt_or_range.kind = RowPredicate::Kind::Any;
+    shirt_or_range.children.resize(2);
+    shirt_or_range.children[0].kind = RowPredicate::Kind::Contains;
+    shirt_or_range.children[0].col_index = 3;
+    shirt_or_range.children[0].value = "Shirt";
+    shirt_or_range.children[1].kind = RowPredicate::Kind::Range;
+    shirt_or_range.children[1].col_index = 2;
+    shirt_or_range.children[1].min = 100;
+    shirt_or_range.children[1].max = 1000;
+
+    RowPredicate not_vg;
+    not_vg.kind = RowPredicate::Kind::NotEquals;
+    not_vg.col_index = 1;
+    not_vg.value = "VG";
+
+    RowPredicate where;
+    where.kind = RowPredicate::Kind::All;
+    where.children = { shirt_or_range, not_vg };
+
+    for (auto *s : { &sheet, &dict })
+    {
+        filter_rows_nitro(*s, where);
+        REQUIRE(s->num_rows == 6); // cells stay in place
+        REQUIRE(logical_vals(*s, 0) == std::vector<std::string>{ "1", "6" });
+    }
+
+    // filters compose with an existing selection
+    RowPredicate blank;
+    blank.kind = RowPredicate::Kind::IsEmpty;
+    blank.col_index = 3;
+    blank.empty = false;
+    sort_rows_by_column_nitro(sheet, 0, false);
+    filter_rows_nitro(sheet, blank);
+    REQUIRE(logical_vals(sheet, 0) == std::vector<std::string>{ "6", "1" });
+}
+
+TEST_CASE("lookup_column_nitro joins a reference sheet on a key column", "[lookup_column_nitro]")
+{
+    auto sheet = make_sheet({
+        { "1", "2", "3", "4" },
+        { "GH", "VG", "XX", "GH" },
+    });
+    auto ref = make_sheet({
+        { "VG", "GH", "GH", "" },
+        { "V Shirt", "G Handbag", "G Hat", "Blank" },
+    });
+    ref.cols[1].header = "Name";
+
+    lookup_column_nitro(sheet, ref, 1, 0, { 1 }, { 2 }, {}, OnDuplicate::First, "?");
+    REQUIRE(sheet.cols[2].header == "Name");
+    REQUIRE(logical_vals(sheet, 2) == std::vector<std::string>{ "G Handbag", "V Shirt", "?", "G Handbag" });
+
+    lookup_column_nitro(sheet, ref, 1, 0, { 1 }, { 3 }, { "Last" }, OnDuplicate::Last, "");
+    REQUIRE(sheet.cols[3].header == "Last");
+    REQUIRE(logical_vals(sheet, 3) == std::vector<std::string>{ "G Hat", "V Shirt", "", "G Hat" });
+
+    REQUIRE_THROWS_AS(lookup_column_nitro(sheet, ref, 1, 0, { 1 }, { 4 }, {}, OnDuplicate::Error, ""),
+                      std::runtime_error);
+
+    // short reference columns: missing keys never match, missing values miss
+    auto ragged = make_sheet({
+        { "VG", "GH", "XX" },
+        { "V Shirt", "G Handbag", "X" },
+    });
+    ragged.cols[0].vals_mut().resize(2);
+    ragged.cols[1].vals_mut().resize(1);
+    lookup_column_nitro(sheet, ragged, 1, 0, { 1 }, { 4 }, {}, OnDuplicate::First, "-");
+    REQUIRE(logical_vals(sheet, 4) == std::vector<std::string>{ "-", "V Shirt", "-", "-" });
+    ragged.cols[1].assign_dict({ 0 }, { "V Shirt" });
+    lookup_column_nitro(sheet, ragged, 1, 0, { 1 }, { 4 }, {}, OnDuplicate::First, "-");
+    REQUIRE(logical_vals(sheet, 4) == std::vector<std::string>{ "-", "V Shirt", "-", "-" });
+}
+
+TEST_CASE("concurrent lookups share a serialized reference loader", "[serialized_reference_loader]")
+{
+    std::vector<std::string> keys, names;
+    for (int i = 0; i < 4000; ++i)
+    {
+        keys.push_back(std::to_string(i % 50));
+        names.push_back("name " + std::to_string(i % 50));
+    }
+    const auto base = make_sheet({ keys, keys, {}, {}, {}, {}, {}, {} });
+
+    // a wide reference sheet: encoding it splits into many pool tasks
+    std::vector<std::vector<std::string>> ref_cols = { keys, names };
+    for (int c = 0; c < 14; ++c) ref_cols.push_back(names);
+    std::atomic<int> reading{ 0 }, overlapped{ 0 };
+    const ReferenceLoader loader = serialized_reference_loader(
+        [&](const std::string &, const std::string &, std::uint32_t, std::uint32_t) {
+            if (reading.fetch_add(1) != 0) ++overlapped;
+            std::this_thread::sleep_for(std::chrono::milliseconds(5));
+            NitroSheet ref = make_sheet(ref_cols);
+            reading.fetch_sub(1);
+            return ref;
+        });
+
+    // independent output columns: more lookups than threads run at the same time,
+    // so a thread waiting on its encoding picks up another lookup
+    std::vector<OperationPtr> ops;
+    for (const char *out : { "C", "D", "E", "F", "G", "H" })
+        ops.push_back(compile_operation(YAML::Load(
+            std::string("{ type: lookup-column, sheet: Ref, key-column: A, ref-key-column: A, ref-columns: [B], output-columns: [") + out + "] }")));
+
+    set_thread_count(4);
+    for (int run = 0; run < 20; ++run)
+    {
+        NitroSheet sheet = base;
+        OpContext ctx(sheet);
+        ctx.load_reference = loader;
+        run_operations(ops, ctx);
+        for (size_t c = 2; c < 8; ++c)
+            REQUIRE(logical_vals(sheet, c)[51] == "name 1");
+    }
+    set_thread_count(0);
+    REQUIRE(overlapped == 0);
+}
+
+TEST_CASE("dedupe_rows_nitro keeps the first of each duplicate row", "[dedupe_rows_nitro]")
+{
+    auto sheet = make_sheet({
+        { "1", "2", "3", "4", "5", "6" },
+        { "GH", "VG", "GH", "GH", "VG", "BN" },
+        { "blue", "white", "blue", "red", "white", "red" },
+    });
+
+    auto by_code = sheet;
+    dedupe_rows_nitro(by_code, { 1 });
+    REQUIRE(logical_vals(by_code, 0) == std::vector<std::string>{ "1", "2", "6" });
+
+    dedupe_rows_nitro(sheet, { 1, 2 });
+    REQUIRE(logical_vals(sheet, 0) == std::vector<std::string>{ "1", "2", "4", "6" });
+
+    dedupe_rows_nitro(sheet, {}); // all columns: "No" makes every row unique
+    REQUIRE(sheet.row_count() == 4);
+
+    // an unknown key column is an error, not "no keys" (which would keep one row)
+    REQUIRE_THROWS_AS(dedupe_rows_nitro(sheet, { 9 }), std::runtime_error);
+    REQUIRE(sheet.row_count() == 4);
+
+    // large enough to use partitioned tables; dictionary columns compare codes
+    std::vector<std::string> no, code;
+    for (int r = 0; r < 100000; ++r)
+    {
+        no.push_back(std::to_string(r % 1000));
+        code.push_back(r % 2 ? "odd" : "even");
+    }
+    auto big = make_sheet({ no, code });
+    REQUIRE(big.cols[1].dict_encode());
+    dedupe_rows_nitro(big, { 0, 1 });
+    REQUIRE(big.row_count() == 1000);
+    REQUIRE(big.row_at(0) == 0);
+    REQUIRE(big.row_at(999) == 999);
+}
+
+TEST_CASE("pivot_nitro aggregates into one column per pivot value", "[pivot_nitro]")
+{
+    auto sheet = make_sheet({
+        { "GH", "VG", "GH", "GH", "VG", "BN" },
+        { "s", "m", "m", "s", "s", "xl" },
+        { "2", "5", "1", "3", "n/a", "7" },
+    });
+    sheet.cols[0].header = "Code";
+
+    auto counts = sheet;
+    pivot_nitro(sheet, { 0 }, 1, 2, PivotAggregate::Sum, "0");
+    REQUIRE(sheet.num_rows == 3);
+    REQUIRE(sheet.cols.size() == 4);
+    REQUIRE(sheet.cols[0].header == "Code");
+    REQUIRE(sheet.cols[1].header == "s");
+    REQUIRE(logical_vals(sheet, 0) == std::vector<std::string>{ "GH", "VG", "BN" });
+    REQUIRE(logical_vals(sheet, 1) == std::vector<std::string>{ "5.0", "0", "0" }); // "n/a" is skipped
+    REQUIRE(logical_vals(sheet, 2) == std::vector<std::string>{ "1.0", "5.0", "0" });
+    REQUIRE(logical_vals(sheet, 3) == std::vector<std::string>{ "0", "0", "7.0" });
+
+    pivot_nitro(counts, { 0 }, 1, 2, PivotAggregate::Count, "");
+    REQUIRE(logical_vals(counts, 1) == std::vector<std::string>{ "2", "1", "" });
+
+    // blank pivot cells get a named column; a short key column reads as blank
+    auto ragged = make_sheet({
+        { "GH", "VG", "GH" },
+        { "s", "", "s" },
+        { "1", "2", "3" },
+    });
+    ragged.cols.emplace_back("Shop", std::vector<std::string>{ "north" });
+    ragged.cols[1].dict_encode();
+    pivot_nitro(ragged, { 3, 0 }, 1, 2, PivotAggregate::Count, "");
+    REQUIRE(ragged.cols.size() == 4);
+    REQUIRE(ragged.cols[3].header == "(blank)");
+    REQUIRE(logical_vals(ragged, 0) == std::vector<std::string>{ "north", "", "" });
+    REQUIRE(logical_vals(ragged, 1) == std::vector<std::string>{ "GH", "VG", "GH" });
+    REQUIRE(logical_vals(ragged, 3) == std::vector<std::string>{ "", "1", "" });
+
+    // a missing key cell groups with a blank one; First reads a missing value as blank
+    auto shorter = make_sheet({
+        { "a", "", "" },
+        { "p", "p", "p" },
+        { "1", "2", "3" },
+    });
+    shorter.cols[0].vals_mut().resize(2);
+    shorter.cols[2].vals_mut().resize(1);
+    pivot_nitro(shorter, { 0 }, 1, 2, PivotAggregate::First, "");
+    REQUIRE(logical_vals(shorter, 0) == std::vector<std::string>{ "a", "" });
+    REQUIRE(logical_vals(shorter, 1) == std::vector<std::string>{ "1", "" });
+}
+
+TEST_CASE("top_n_nitro matches sorting and keeping the first rows", "[top_n_nitro]")
+{
+    std::vector<std::string> price, code;
+    for (int r = 0; r < 200; ++r)
+    {
+        price.push_back(r % 13 == 0 ? "n/a" : std::to_string((r * 37) % 50));
+        code.push_back(r % 3 == 0 ? "GH" : r % 3 == 1 ? "VG" : "BN");
+    }
+
+    auto top = make_sheet({ price, code });
+    auto sorted = top;
+    top_n_nitro(top, 0, 7, false, SortAs::Number, {});
+    sort_rows_by_column_nitro(sorted, 0, false, SortAs::Number);
+
+    auto expected = logical_vals(sorted, 0);
+    expected.resize(7);
+    REQUIRE(logical_vals(top, 0) == expected);
+    for (size_t i = 0; i < 7; ++i)
+        REQUIRE(top.row_at(i) == sorted.row_at(i)); // same tie order
+
+    // per group: each code keeps its 2 lowest prices, groups in first-appearance order
+    auto grouped = make_sheet({ price, code });
+    REQUIRE(grouped.cols[1].dict_encode());
+    top_n_nitro(grouped, 0, 2, true, SortAs::Number, { 1 });
+    REQUIRE(logical_vals(grouped, 1) == std::vector<std::string>{ "GH", "GH", "VG", "VG", "BN", "BN" });
+    for (const char *g : { "GH", "VG", "BN" })
+    {
+        std::vector<double> prices;
+        for (size_t r = 0; r < price.size(); ++r)
+            if (code[r] == g && price[r] != "n/a") prices.push_back(std::stod(price[r]));
+        std::sort(prices.begin(), prices.end());
+
+        std::vector<double> kept;
+        for (size_t i = 0; i < grouped.row_count(); ++i)
+            if (grouped.cols[1].at(grouped.row_at(i)) == g)
+                kept.push_back(std::stod(grouped.cols[0].at(grouped.row_at(i))));
+        REQUIRE(kept == std::vector<double>{ prices[0], prices[1] });
+    }
+}
+
+TEST_CASE("regex_replace_in_column_nitro rewrites plain and dictionary columns alike", "[regex_replace_in_column_nitro]")
+{
+    std::vector<std::string> names;
+    for (int r = 0; r < 64; ++r)
+        names.push_back(r % 2 ? "G   Handbag-V2" : "V Shirt  -V10");
+
+    auto plain = make_sheet({ names });
+    auto dict = plain;
+    REQUIRE(dict.cols[0].dict_encode());
+
+    for (auto *s : { &plain, &dict })
+        regex_replace_in_column_nitro(*s, 1, 0, "\\s*-V\\d+$|(\\s)\\s+", "$1");
+
+    REQUIRE(logical_vals(plain, 0) == logical_vals(dict, 0));
+    REQUIRE(plain.cols[0].at(0) == "V Shirt");
+    REQUIRE(plain.cols[0].at(1) == "G Handbag");
+}
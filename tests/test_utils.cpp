@@ -1,6 +1,10 @@
 #define CATCH_CONFIG_MAIN
 #include <catch2/catch_all.hpp>
 #include "utils/utils.hpp"
+#include "utils/linear_regex.hpp"
+#include "thread_pool.hpp"
+#include <numeric>
+#include <ctime>
 
 
 TEST_CASE("str_slice_from returns correct substring", "[str_slice_from]")
@@ -17,4 +21,190 @@ TEST_CASE("str_starts_with detects prefixes correctly", "[str_starts_with]")
     REQUIRE(str_starts_with("Hello, World!", "World") == false);
     REQUIRE(str_starts_with("Hello, World!", "") == true);
     REQUIRE(str_starts_with("Short", "LongerPrefix") == false);
-}
\ No newline at end of file
+}
+
+TEST_CASE("parse_datetime_epoch reads ISO dates and Excel serials", "[parse_datetime_epoch]")
+{
+    int64_t t = 0;
+    REQUIRE(parse_datetime_epoch("1970-01-02", t));
+    REQUIRE(t == 86400);
+    REQUIRE(parse_datetime_epoch("2000-03-01T12:30:15Z", t));
+    REQUIRE(t == 951913815);
+    REQUIRE(parse_datetime_epoch("25570", t)); // Excel serial for 1970-01-02
+    REQUIRE(t == 86400);
+    REQUIRE_FALSE(parse_datetime_epoch("2024-13-01", t));
+    REQUIRE_FALSE(parse_datetime_epoch("2024-02-31", t));
+    REQUIRE_FALSE(parse_datetime_epoch("2023-02-29", t));
+    REQUIRE_FALSE(parse_datetime_epoch("1900-02-29", t));
+    REQUIRE(parse_datetime_epoch("2000-02-29", t));
+    REQUIRE(parse_datetime_epoch("2024-02-29", t));
+    REQUIRE_FALSE(parse_datetime_epoch("2024-04-31", t));
+    REQUIRE_FALSE(parse_datetime_epoch("2024-01-01T25:00:00Z", t));
+    REQUIRE_FALSE(parse_datetime_epoch("2024-01-01T12:60", t));
+    REQUIRE_FALSE(parse_datetime_epoch("2024-01-01T12:00:61", t));
+    REQUIRE(parse_datetime_epoch("2016-12-31T23:59:60Z", t)); // leap second
+    REQUIRE_FALSE(parse_datetime_epoch("not a date", t));
+}
+
+TEST_CASE("numeric layer parses and formats without surprises", "[numeric]")
+{
+    double x = 0;
+    REQUIRE(parse_number("42", x));
+    REQUIRE(x == 42);
+    REQUIRE(parse_number(" -3.25e2 ", x));
+    REQUIRE(x == -325);
+    REQUIRE(parse_number("+7", x));
+    REQUIRE(x == 7);
+    REQUIRE(parse_number("12345678901234567890", x));
+    REQUIRE(x == 12345678901234567890.0);
+    REQUIRE_FALSE(parse_number("", x));
+    REQUIRE_FALSE(parse_number("12 kg", x));
+    REQUIRE_FALSE(parse_number("-", x));
+
+    int64_t i = 0;
+    REQUIRE(parse_plain_integer("-900", i));
+    REQUIRE(i == -900);
+    REQUIRE_FALSE(parse_plain_integer("1.0", i));
+    REQUIRE_FALSE(parse_plain_integer("1234567890123456789", i)); // 19 digits
+
+    REQUIRE(is_json_number("-0.5e+3"));
+    REQUIRE_FALSE(is_json_number("007"));
+    REQUIRE_FALSE(is_json_number(".5"));
+    REQUIRE_FALSE(is_json_number("1."));
+    REQUIRE_FALSE(is_json_number("inf"));
+
+    REQUIRE(format_number(6000) == "6000.0");
+    REQUIRE(format_number(0.1 + 0.2) == "0.30000000000000004");
+    REQUIRE(format_number(-2.5) == "-2.5");
+    REQUIRE(format_number(1e-7) == "0.0000001");
+
+    REQUIRE(to_clean_number("1.50") == "1.5");
+    REQUIRE(to_clean_number("2.000") == "2.0");
+    REQUIRE(to_clean_number("3.") == "3");
+    REQUIRE(to_clean_number("1.5e10") == "1.5e10");
+    REQUIRE(to_clean_number("v1.10") == "v1.10");
+    REQUIRE(to_clean_number("0") == "0");
+    REQUIRE(to_clean_number(".") == ".");
+    REQUIRE(to_clean_number("") == "");
+}
+
+TEST_CASE("case kernels reuse the output buffer", "[case_kernel_for]")
+{
+    std::string out;
+    case_kernel_for(CaseStyle::Camel, '-')("Image-url-ID", '-', out);
+    REQUIRE(out == "imageUrlID");
+    case_kernel_for(CaseStyle::Pascal, '.')("order.line.total", '.', out);
+    REQUIRE(out == "OrderLineTotal");
+    case_kernel_for(CaseStyle::Camel, ' ')(" lead", ' ', out);
+    REQUIRE(out == "lead");
+    case_kernel_for(CaseStyle::Snake, 0)("Hello, World-wideWeb  ", 0, out);
+    REQUIRE(out == "hello_world_wide_web");
+    case_kernel_for(CaseStyle::Upper, 0)("caf\xc3\xa9 1a", 0, out);
+    REQUIRE(out == "CAF\xc3\xa9 1A");
+
+    const size_t cap = out.capacity();
+    case_kernel_for(CaseStyle::Lower, 0)("ABC", 0, out);
+    REQUIRE(out == "abc");
+    REQUIRE(out.capacity() == cap);
+
+    REQUIRE(case_style_from_string("snake_case") == CaseStyle::Snake);
+    REQUIRE_THROWS_AS(case_style_from_string("kebab"), std::runtime_error);
+}
+
+TEST_CASE("append_iso8601_utc matches strftime", "[append_iso8601_utc]")
+{
+    for (int64_t t : { 0LL, 86399LL, 951782400LL, 951913815LL, 1735689599LL, 4102444800LL, -1LL, -86401LL })
+    {
+        std::time_t tt = static_cast<std::time_t>(t);
+        std::tm tm_utc;
+        gmtime_r(&tt, &tm_utc);
+        char expected[32];
+        std::strftime(expected, sizeof(expected), "%Y-%m-%dT%H:%M:%SZ", &tm_utc);
+
+        std::string out;
+        append_iso8601_utc(out, t);
+        REQUIRE(out == expected);
+    }
+
+    // years past four digits keep the full time and the Z
+    std::string wide;
+    append_iso8601_utc(wide, 253402300800LL);
+    REQUIRE(wide == "10000-01-01T00:00:00Z");
+    wide.clear();
+    append_iso8601_utc(wide, -62167219201LL);
+    REQUIRE(wide == "-1-12-31T23:59:59Z");
+
+    std::string cell;
+    append_firestore_timestamp(cell, 951913815);
+    REQUIRE(cell == "{ \"__fire_ts_from_date__\": \"2000-03-01T12:30:15Z\" }");
+    cell.clear();
+    append_firestore_timestamp(cell, kFirestoreNow);
+    REQUIRE(cell == "\"__fire_ts_now__\"");
+}
+
+TEST_CASE("ThreadPool runs chunks, groups and graphs", "[ThreadPool]")
+{
+    for (std::size_t threads : { 1, 4 })
+    {
+        ThreadPool pool(threads);
+        REQUIRE(pool.threads() == threads);
+
+        // every index visited exactly once
+        std::vector<int> hits(100000, 0);
+        pool.parallel_for(hits.size(), [&](std::size_t b, std::size_t e) {
+            for (std::size_t i = b; i < e; ++i) hits[i]++;
+        }, 1000);
+        REQUIRE(std::accumulate(hits.begin(), hits.end(), 0) == 100000);
+        REQUIRE(*std::min_element(hits.begin(), hits.end()) == 1);
+
+        // the first exception reaches the waiter
+        REQUIRE_THROWS_AS(pool.parallel_for(64, [](std::size_t, std::size_t e) {
+            if (e == 64) throw std::runtime_error("last chunk failed");
+        }, 1), std::runtime_error);
+
+        // a task runs after everything it depends on
+        std::mutex m;
+        std::vector<int> order;
+        auto note = [&](int id) { return [&, id] { std::lock_guard<std::mutex> lock(m); order.push_back(id); }; };
+        TaskGraph g;
+        auto a = g.add(note(0));
+        auto b = g.add(note(1));
+        auto c = g.add(note(2), { a, b });
+        g.add(note(3), { c });
+        g.run(pool);
+        REQUIRE(order.size() == 4);
+        REQUIRE(order[2] == 2);
+        REQUIRE(order[3] == 3);
+    }
+}
+
+TEST_CASE("LinearRegex replaces like a backtracking engine", "[LinearRegex]")
+{
+    RegexScratch scratch;
+    auto replace = [&](const std::string &pattern, const std::string &s, const std::string &repl) {
+        std::string out = s;
+        LinearRegex(pattern).replace_all(s, repl, out, scratch);
+        return out;
+    };
+
+    REQUIRE(replace("\\s+", "  B   Necklace ", " ") == " B Necklace ");
+    REQUIRE(replace("-(XS|S|M|L|XL)$", "GH-BLUE-XL", "") == "GH-BLUE");
+    REQUIRE(replace("([A-Z]+)-(\\d+)", "sku AB-12, CD-345", "$2/$1") == "sku 12/AB, 345/CD");
+    REQUIRE(replace("a*?b", "aab ab b", "[$0]") == "[aab] [ab] [b]");
+    REQUIRE(replace("x*", "abc", "-") == "-a-b-c-");
+    REQUIRE(replace("^\\d{2,3}", "12345", "#") == "#45");
+    REQUIRE(replace("[^a-c.]", "a.bXc", "_") == "a.b_c");
+    REQUIRE(replace("(?:ab)+|a", "ababa", "<$0>") == "<abab><a>");
+    REQUIRE(replace("$$", "cost", "$$") == "cost$");
+
+    // no catastrophic backtracking (no required literal, so the matcher runs)
+    const std::string as(5000, 'a');
+    REQUIRE(LinearRegex("(a*)*[bc]").required_literal().empty());
+    REQUIRE(replace("(a*)*[bc]", as, "") == as);
+
+    REQUIRE(LinearRegex("SKU-\\d+-(old|new)").required_literal() == "SKU-");
+    REQUIRE(LinearRegex("(ab){2}c").required_literal() == "ababc");
+    REQUIRE_THROWS_AS(LinearRegex("(ab"), std::runtime_error);
+    REQUIRE_THROWS_AS(LinearRegex("+a"), std::runtime_error);
+    REQUIRE_THROWS_AS(LinearRegex("(a)\\1"), std::runtime_error);
+}